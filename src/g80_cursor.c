@@ -33,7 +33,70 @@
 #include "g80_cursor.h"
 #include "g80_display.h"
 
-#define CURSOR_PTR ((CARD32*)pNv->mem + pNv->videoRam * 256 - 0x1000)
+/*
+ * Cursor image cache.  Toolkits keep switching between a handful of
+ * shapes, so every image loaded stays in one of G80_CURSOR_SLOTS slots,
+ * keyed by a hash of its pixels.  Showing a cached image only changes the
+ * head's cursor address.
+ *
+ * Animated cursors are loaded one frame at a time by the server.  Any
+ * image that arrives within ANIM_INTERVAL of the previous load is taken
+ * to be a frame, including a toolkit switching shapes quickly, and goes
+ * round G80_CURSOR_FRAMES slots of their own, so after the first round a
+ * spinner only changes the cursor address and doesn't push the everyday
+ * shapes out.  A shape mistaken for a frame merely gets a frame slot.
+ * Slots a head is showing are skipped, as the head reads them while they
+ * would be written.
+ *
+ * An animation longer than G80_CURSOR_FRAMES would miss on every frame if
+ * the ring kept turning over.  Once more frames than that have missed in
+ * a row, the ring stops turning: the frames already in it stay, and the
+ * rest stream through its last ANIM_STREAM slots until the next pause.
+ * That is still more slots than heads.
+ */
+#define ANIM_INTERVAL 250  /* milliseconds */
+#define ANIM_STREAM   3
+
+static CARD64
+hashCursor(const CARD32 *src, int dwords)
+{
+    CARD64 h = 0;
+
+    while(dwords--) {
+        h = (h + *src++) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+
+    return h ? h : 1;
+}
+
+static Bool
+slotShown(ScrnInfoPtr pScrn, int slot)
+{
+    xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(pScrn);
+    int i;
+
+    for(i = 0; i < xf86_config->num_crtc; i++) {
+        if(G80CrtcGetCursorSlot(xf86_config->crtc[i]) == slot)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Slot 0 is the cursor's usual place at the very top of video memory, the
+ * others and the frames are stacked right below the reserved area.
+ */
+CARD32
+G80CursorSlotOffset(G80Ptr pNv, int slot)
+{
+    const CARD32 top = pNv->videoRam << 10;
+
+    if(slot == 0)
+        return top - G80_CURSOR_SLOT_SIZE;
+    return top - G80_RESERVED_VIDMEM - slot * G80_CURSOR_SLOT_SIZE;
+}
 
 void G80SetCursorPosition(xf86CrtcPtr crtc, int x, int y)
 {
@@ -49,10 +112,55 @@ void G80SetCursorPosition(xf86CrtcPtr crtc, int x, int y)
 void G80LoadCursorARGB(xf86CrtcPtr crtc, CARD32 *src)
 {
     G80Ptr pNv = G80PTR(crtc->scrn);
-    CARD32 *dst = CURSOR_PTR;
-
     /* Assume cursor is 64x64 */
-    memcpy(dst, src, 64 * 64 * 4);
+    const CARD64 key = hashCursor(src, 64 * 64);
+    const CARD32 now = GetTimeInMillis();
+    const Bool frame = (now - pNv->cursorLoadTime) < ANIM_INTERVAL;
+    int i, slot = 0;
+
+    if(!frame)
+        pNv->cursorFrameMisses = 0;
+
+    for(i = 0; i < G80_CURSOR_SLOTS + G80_CURSOR_FRAMES; i++) {
+        if(pNv->cursorKey[i] == key)
+            break;
+    }
+
+    if(i < G80_CURSOR_SLOTS + G80_CURSOR_FRAMES) {
+        slot = i;
+        pNv->statCursorHits++;
+    } else {
+        if(frame) {
+            int first = 0;
+
+            if(++pNv->cursorFrameMisses > G80_CURSOR_FRAMES)
+                first = G80_CURSOR_FRAMES - ANIM_STREAM;
+            if(pNv->cursorFrameNext < first)
+                pNv->cursorFrameNext = first;
+            /* there are more frame slots than heads, so this ends */
+            do {
+                slot = G80_CURSOR_SLOTS + pNv->cursorFrameNext;
+                if(++pNv->cursorFrameNext == G80_CURSOR_FRAMES)
+                    pNv->cursorFrameNext = first;
+            } while(slotShown(crtc->scrn, slot));
+            pNv->statCursorFrames++;
+        } else {
+            /* Both heads get the same images, and the ones they show were
+               stamped last, so the least recently used slot is never on
+               screen. */
+            for(i = 1; i < G80_CURSOR_SLOTS; i++) {
+                if(pNv->cursorStamp[i] < pNv->cursorStamp[slot])
+                    slot = i;
+            }
+        }
+        memcpy(pNv->mem + G80CursorSlotOffset(pNv, slot), src, 64 * 64 * 4);
+        pNv->cursorKey[slot] = key;
+        pNv->statCursorMisses++;
+    }
+
+    pNv->cursorStamp[slot] = ++pNv->cursorClock;
+    pNv->cursorLoadTime = now;
+    G80CrtcSetCursorSlot(crtc, slot);
 }
 
 Bool G80CursorAcquire(ScrnInfoPtr pScrn)
@@ -63,6 +171,9 @@ Bool G80CursorAcquire(ScrnInfoPtr pScrn)
 
     if(!pNv->HWCursor) return TRUE;
 
+    /* the images may have been overwritten while we were away */
+    memset(pNv->cursorKey, 0, sizeof(pNv->cursorKey));
+
     /* Initialize the cursor on each head */
     for(i = 0; i < xf86_config->num_crtc; i++) {
         const int headOff = 0x10 * G80CrtcGetHead(xf86_config->crtc[i]);
@@ -1,6 +1,7 @@
 Bool G80CursorInit(ScreenPtr);
 Bool G80CursorAcquire(ScrnInfoPtr);
 void G80CursorRelease(ScrnInfoPtr);
+CARD32 G80CursorSlotOffset(G80Ptr, int slot);
 
 /* CRTC cursor functions */
 void G80SetCursorPosition(xf86CrtcPtr crtc, int x, int y);
@@ -26,8 +26,6 @@
 #include "config.h"
 #endif
 
-#include <float.h>
-#include <math.h>
 #include <strings.h>
 #include <unistd.h>
 
@@ -35,11 +33,13 @@
 #include "g80_cursor.h"
 #include "g80_display.h"
 #include "g80_output.h"
+#include "nv_pll.h"
 
 typedef struct G80CrtcPrivRec {
     Head head;
     int pclk; /* Target pixel clock in kHz */
     Bool cursorVisible;
+    int cursorSlot;
     Bool skipModeFixup;
     Bool dither;
     /* Look-up table values to be set when the CRTC is enabled */
@@ -52,149 +52,82 @@ static void G80CrtcShowHideCursor(xf86CrtcPtr crtc, Bool show, Bool update);
  * PLL calculation.  pclk is in kHz.
  */
 static void
-G80CalcPLL(float pclk, int *pNA, int *pMA, int *pNB, int *pMB, int *pP)
+G80CalcPLL(int pclk, int *pNA, int *pMA, int *pNB, int *pMB, int *pP)
 {
-    const float refclk = 27000.0f;
-    const float minVcoA = 100000;
-    const float maxVcoA = 400000;
-    const float minVcoB = 600000;
-    float maxVcoB = 1400000;
-    const float minUA = 2000;
-    const float maxUA = 400000;
-    const float minUB = 50000;
-    const float maxUB = 200000;
-    const int minNA = 1, maxNA = 255;
-    const int minNB = 1, maxNB = 31;
-    const int minMA = 1, maxMA = 255;
-    const int minMB = 1, maxMB = 31;
-    const int minP = 0, maxP = 6;
-    int lowP, highP;
-    float vcoB;
-
-    int na, ma, nb, mb, p;
-    float bestError = FLT_MAX;
+    NVPllLimits limits = { 0 };
+    NVPllCoeffs pll;
 
     *pNA = *pMA = *pNB = *pMB = *pP = 0;
 
-    if(maxVcoB < pclk + pclk / 200)
-        maxVcoB = pclk + pclk / 200;
-    if(minVcoB / (1 << maxP) > pclk)
-        pclk = minVcoB / (1 << maxP);
-
-    vcoB = maxVcoB - maxVcoB / 200;
-    lowP = minP;
-    vcoB /= 1 << (lowP + 1);
-
-    while(pclk <= vcoB && lowP < maxP)
-    {
-        vcoB /= 2;
-        lowP++;
-    }
-
-    vcoB = maxVcoB + maxVcoB / 200;
-    highP = lowP;
-    vcoB /= 1 << (highP + 1);
-
-    while(pclk <= vcoB && highP < maxP)
-    {
-        vcoB /= 2;
-        highP++;
-    }
-
-    for(p = lowP; p <= highP; p++)
-    {
-        for(ma = minMA; ma <= maxMA; ma++)
-        {
-            if(refclk / ma < minUA)
-                break;
-            else if(refclk / ma > maxUA)
-                continue;
-
-            for(na = minNA; na <= maxNA; na++)
-            {
-                if(refclk * na / ma < minVcoA || refclk * na / ma > maxVcoA)
-                    continue;
-
-                for(mb = minMB; mb <= maxMB; mb++)
-                {
-                    if(refclk * na / ma / mb < minUB)
-                        break;
-                    else if(refclk * na / ma / mb > maxUB)
-                        continue;
-
-                    nb = rint(pclk * (1 << p) * (ma / (float)na) * mb / refclk);
-
-                    if(nb > maxNB)
-                        break;
-                    else if(nb < minNB)
-                        continue;
-                    else
-                    {
-                        float freq = refclk * (na / (float)ma) * (nb / (float)mb) / (1 << p);
-                        float error = fabsf(pclk - freq);
-                        if(error < bestError) {
-                            *pNA = na;
-                            *pMA = ma;
-                            *pNB = nb;
-                            *pMB = mb;
-                            *pP = p;
-                            bestError = error;
-                        }
-                    }
-                }
-            }
-        }
+    limits.refclk = 27000;
+    limits.minM1 = 1;
+    limits.maxM1 = 255;
+    limits.minN1 = 1;
+    limits.maxN1 = 255;
+    limits.minU1 = 2000;
+    limits.maxU1 = 400000;
+    limits.minVco1 = 100000;
+    limits.maxVco1 = 400000;
+    limits.minM2 = 1;
+    limits.maxM2 = 31;
+    limits.minN2 = 1;
+    limits.maxN2 = 31;
+    limits.minU2 = 50000;
+    limits.maxU2 = 200000;
+    limits.log2P = 1;
+
+    /*
+     * Keep the second VCO within half a percent of 700 MHz to 1.4 GHz.
+     * Clocks that can't get there use the outermost divider, and those
+     * below the 600 MHz VCO minimum divided by 64 are raised to that.
+     */
+    if(pclk < 600000 >> 6)
+        pclk = 600000 >> 6;
+    NVPllPostRange(pclk, 696501, 1407000, 0, 6, &limits.lowP, &limits.highP);
+
+    if(NVPllSolve(&limits, pclk, &pll)) {
+        *pNA = pll.n1;
+        *pMA = pll.m1;
+        *pNB = pll.n2;
+        *pMB = pll.m2;
+        *pP = pll.p;
     }
 }
 
 static void
-G80CalcPLL2(float pclk, int *pN, int *pM, int *pPL)
+G80CalcPLL2(int pclk, int *pN, int *pM, int *pPL)
 {
-    const float refclk = 27000.0f;
-    const int minN = 8, maxN = 255;
-    const int minM = 1, maxM = 255;
     const int minPL = 1, maxPL = 63;
-    const int minU = 25000, maxU = 50000;
     const int minVco = 500000;
     int maxVco = 1000000;
-    int lowPL, highPL, pl;
-    float vco, bestError = FLT_MAX;
-
-    vco = pclk + pclk / 50;
-
-    if(maxVco < vco) maxVco = vco;
+    NVPllLimits limits = { 0 };
+    NVPllCoeffs pll;
+    float vco;
 
-    highPL = (maxVco + vco - 1) / pclk;
-    if(highPL > maxPL) highPL = maxPL;
-    if(highPL < minPL) highPL = minPL;
+    limits.refclk = 27000;
+    limits.minM1 = 1;
+    limits.maxM1 = 255;
+    limits.minN1 = 8;
+    limits.maxN1 = 255;
+    limits.minU1 = 25000;
+    limits.maxU1 = 50000;
 
-    lowPL = minVco / vco;
-    if(lowPL > maxPL) lowPL = maxPL;
-    if(lowPL < minPL) lowPL = minPL;
+    vco = pclk + pclk / 50.0f;
 
-    for(pl = highPL; pl >= lowPL; pl--) {
-        int m;
-
-        for(m = minM; m <= maxM; m++) {
-            int n;
-            float freq, error;
+    if(maxVco < vco) maxVco = vco;
 
-            if(refclk / m < minU) break;
-            if(refclk / m > maxU) continue;
+    limits.highP = (maxVco + vco - 1) / pclk;
+    if(limits.highP > maxPL) limits.highP = maxPL;
+    if(limits.highP < minPL) limits.highP = minPL;
 
-            n = rint(pclk * pl * m / refclk);
-            if(n > maxN) break;
-            if(n < minN) continue;
+    limits.lowP = minVco / vco;
+    if(limits.lowP > maxPL) limits.lowP = maxPL;
+    if(limits.lowP < minPL) limits.lowP = minPL;
 
-            freq = refclk * (n / (float)m) / pl;
-            error = fabsf(pclk - freq);
-            if(error < bestError) {
-                *pN = n;
-                *pM = m;
-                *pPL = pl;
-                bestError = error;
-            }
-        }
+    if(NVPllSolve(&limits, pclk, &pll)) {
+        *pN = pll.n1;
+        *pM = pll.m1;
+        *pPL = pll.p;
     }
 }
 
@@ -289,6 +222,13 @@ G80CrtcGetHead(xf86CrtcPtr crtc)
     return pPriv->head;
 }
 
+int
+G80CrtcGetCursorSlot(xf86CrtcPtr crtc)
+{
+    G80CrtcPrivPtr pPriv = crtc->driver_private;
+    return pPriv->cursorSlot;
+}
+
 Bool
 G80DispPreInit(ScrnInfoPtr pScrn)
 {
@@ -484,7 +424,7 @@ G80CrtcBlankScreen(xf86CrtcPtr crtc, Bool blank)
         pNv->reg[0x00610384/4] = pNv->videoRam * 1024 - 1;
         pNv->reg[0x00610388/4] = 0x150000;
         pNv->reg[0x0061038C/4] = 0;
-        C(0x00000884 + headOff, (pNv->videoRam << 2) - 0x40);
+        C(0x00000884 + headOff, G80CursorSlotOffset(pNv, pPriv->cursorSlot) >> 8);
         if(pNv->architecture != 0x50)
             C(0x0000089C + headOff, 1);
         if(pPriv->cursorVisible)
@@ -516,6 +456,22 @@ static void G80CrtcShowHideCursor(xf86CrtcPtr crtc, Bool show, Bool update)
     }
 }
 
+/* Show another image out of the cursor cache */
+void G80CrtcSetCursorSlot(xf86CrtcPtr crtc, int slot)
+{
+    ScrnInfoPtr pScrn = crtc->scrn;
+    G80Ptr pNv = G80PTR(pScrn);
+    G80CrtcPrivPtr pPriv = crtc->driver_private;
+    const int headOff = 0x400 * pPriv->head;
+
+    if(pPriv->cursorSlot == slot)
+        return;
+
+    pPriv->cursorSlot = slot;
+    C(0x00000884 + headOff, G80CursorSlotOffset(pNv, slot) >> 8);
+    C(0x00000080, 0);
+}
+
 static void G80CrtcShowCursor(xf86CrtcPtr crtc)
 {
     G80CrtcShowHideCursor(crtc, TRUE, TRUE);
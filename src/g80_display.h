@@ -19,6 +19,8 @@ void G80CrtcBlankScreen(xf86CrtcPtr, Bool blank);
 void G80CrtcEnableCursor(xf86CrtcPtr, Bool update);
 void G80CrtcDisableCursor(xf86CrtcPtr, Bool update);
 void G80CrtcSetCursorPosition(xf86CrtcPtr, int x, int y);
+int G80CrtcGetCursorSlot(xf86CrtcPtr);
+void G80CrtcSetCursorSlot(xf86CrtcPtr, int slot);
 void G80CrtcSkipModeFixup(xf86CrtcPtr);
 void G80CrtcSetDither(xf86CrtcPtr, Bool dither, Bool update);
 void G80CrtcSetScale(xf86CrtcPtr, DisplayModePtr, enum G80ScaleMode);
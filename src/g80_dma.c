@@ -25,15 +25,57 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include "g80_type.h"
 #include "g80_dma.h"
 
+/* Budgets for G80DmaAutoKickoff */
+#define KICKOFF_DWORDS      512
+#define KICKOFF_PIXELS      (128 * 128)
+#define KICKOFF_IDLE_DWORDS 32
+
 void G80DmaKickoff(G80Ptr pNv)
 {
     if(pNv->dmaCurrent != pNv->dmaPut) {
+        pNv->statKickoffs++;
+        pNv->statDwords += pNv->dmaCurrent - pNv->dmaPut;
         pNv->dmaPut = pNv->dmaCurrent;
         pNv->reg[0x00c02040/4] = pNv->dmaPut << 2;
     }
+    pNv->dmaOpenTag = 0;
+    pNv->dmaPixels = 0;
+    pNv->dmaIdleCheck = pNv->dmaPut + KICKOFF_IDLE_DWORDS;
+}
+
+/*
+ * Called after queueing an operation touching "pixels" pixels.  The
+ * commands are submitted once enough pushbuffer space or pixel work has
+ * piled up, or early if the FIFO has already drained so the engine is not
+ * left idle while we batch.  GET is only polled every KICKOFF_IDLE_DWORDS
+ * since the MMIO read is not free.  Whatever is left goes out from the
+ * BlockHandler through DMAKickoffCallback.
+ */
+void G80DmaAutoKickoff(G80Ptr pNv, int pixels)
+{
+    const CARD32 queued = pNv->dmaCurrent - pNv->dmaPut;
+
+    pNv->dmaPixels += pixels;
+
+    if(queued >= KICKOFF_DWORDS) {
+        pNv->statKickoffDwords++;
+    } else if(pNv->dmaPixels >= KICKOFF_PIXELS) {
+        pNv->statKickoffPixels++;
+    } else if(pNv->dmaCurrent >= pNv->dmaIdleCheck) {
+        pNv->dmaIdleCheck = pNv->dmaCurrent + KICKOFF_IDLE_DWORDS;
+        if((pNv->reg[0x00c02044/4] >> 2) != pNv->dmaPut)
+            return;
+        pNv->statKickoffIdle++;
+    } else {
+        return;
+    }
+
+    G80DmaKickoff(pNv);
 }
 
 void G80DmaWait(G80Ptr pNv, int size)
@@ -57,9 +99,88 @@ void G80DmaWait(G80Ptr pNv, int size)
                 }
                 pNv->reg[0x00c02040/4] = SKIPS << 2;
                 pNv->dmaCurrent = pNv->dmaPut = SKIPS;
+                pNv->dmaIdleCheck = SKIPS + KICKOFF_IDLE_DWORDS;
+                pNv->dmaOpenTag = 0;
                 pNv->dmaFree = dmaGet - (SKIPS + 1);
             }
         } else
             pNv->dmaFree = dmaGet - pNv->dmaCurrent - 1;
     }
 }
+
+/*
+ * Runs of the same method are merged into one packet: if the last thing
+ * in the pushbuffer is a packet for "tag" that hasn't been submitted yet,
+ * its header is patched to take "size" more dwords of data, up to "max"
+ * in total.  Any other method, a kickoff or a wrap of the buffer ends the
+ * packet.  Returns FALSE if a new one has to be started with G80DmaOpen.
+ */
+Bool G80DmaExtend(G80Ptr pNv, CARD32 tag, int size, int max)
+{
+    if(pNv->dmaOpenTag != tag ||
+       pNv->dmaCurrent != pNv->dmaOpenEnd ||
+       pNv->dmaOpenSize + size > max ||
+       pNv->dmaFree <= size)
+        return FALSE;
+
+    pNv->dmaOpenSize += size;
+    pNv->dmaOpenEnd += size;
+    pNv->dmaBase[pNv->dmaOpenHeader] = (pNv->dmaOpenSize << 18) | tag;
+    pNv->dmaFree -= size;
+    return TRUE;
+}
+
+void G80DmaOpen(G80Ptr pNv, CARD32 tag, int size)
+{
+    G80DmaStart(pNv, tag, size);
+    pNv->dmaOpenTag = tag;
+    pNv->dmaOpenHeader = pNv->dmaCurrent - 1;
+    pNv->dmaOpenSize = size;
+    pNv->dmaOpenEnd = pNv->dmaCurrent + size;
+}
+
+/*
+ * The 2D setup methods are sent through here so that state the engine
+ * already has is not sent again.  pNv->state shadows the last value put
+ * in the pushbuffer for each method, and only the span between the first
+ * and the last method that actually changed gets emitted.
+ */
+#define STATE_VALID(pNv, i) ((pNv)->stateValid[(i) >> 5] & (1 << ((i) & 31)))
+
+void G80DmaState(G80Ptr pNv, CARD32 mthd, const CARD32 *data, int count)
+{
+    const int base = mthd / 4;
+    int first, last, i;
+
+    for(first = 0; first < count; first++)
+        if(!STATE_VALID(pNv, base + first) ||
+           pNv->state[base + first] != data[first])
+            break;
+    if(first == count)
+        return;
+
+    for(last = count - 1; last > first; last--)
+        if(!STATE_VALID(pNv, base + last) ||
+           pNv->state[base + last] != data[last])
+            break;
+
+    G80DmaStart(pNv, mthd + first * 4, last - first + 1);
+    for(i = first; i <= last; i++) {
+        G80DmaNext(pNv, data[i]);
+        pNv->state[base + i] = data[i];
+        pNv->stateValid[(base + i) >> 5] |= 1 << ((base + i) & 31);
+    }
+}
+
+void G80DmaState1(G80Ptr pNv, CARD32 mthd, CARD32 data)
+{
+    G80DmaState(pNv, mthd, &data, 1);
+}
+
+/* Forget the shadowed state, for when the engine has been reinitialized
+   or someone else may have used it. */
+void G80DmaInvalidateState(G80Ptr pNv)
+{
+    memset(pNv->stateValid, 0, sizeof(pNv->stateValid));
+    pNv->currentRop = ~0; /* Set to something invalid */
+}
@@ -11,4 +11,10 @@
 }
 
 void G80DmaKickoff(G80Ptr pNv);
+void G80DmaAutoKickoff(G80Ptr pNv, int pixels);
 void G80DmaWait(G80Ptr pNv, int size);
+Bool G80DmaExtend(G80Ptr pNv, CARD32 tag, int size, int max);
+void G80DmaOpen(G80Ptr pNv, CARD32 tag, int size);
+void G80DmaState(G80Ptr pNv, CARD32 mthd, const CARD32 *data, int count);
+void G80DmaState1(G80Ptr pNv, CARD32 mthd, CARD32 data);
+void G80DmaInvalidateState(G80Ptr pNv);
@@ -53,10 +53,10 @@
 #include "g80_dma.h"
 #include "g80_output.h"
 #include "g80_exa.h"
+#include "g80_video.h"
 #include "g80_xaa.h"
 
 #define G80_REG_SIZE (1024 * 1024 * 16)
-#define G80_RESERVED_VIDMEM 0xe000
 
 typedef enum {
     OPTION_HW_CURSOR,
@@ -127,6 +127,13 @@ G80ResizeScreen(ScrnInfoPtr pScrn, int width, int height)
      * for the screen.
      */
     if(pNv->exa) {
+        /* neither the video buffers nor the download staging area may get
+           in the screen's way */
+        G80VideoFreeBuffers(pScrn);
+        if(pNv->exaStagingArea) {
+            exaOffscreenFree(pScreen, pNv->exaStagingArea);
+            pNv->exaStagingArea = NULL;
+        }
         if(pNv->exaScreenArea)
             exaOffscreenFree(pScreen, pNv->exaScreenArea);
         pNv->exaScreenArea = exaOffscreenAlloc(pScreen, pitch * pScrn->virtualY,
@@ -137,6 +144,7 @@ G80ResizeScreen(ScrnInfoPtr pScrn, int width, int height)
                        "returned an area with a nonzero offset.  Don't be "
                        "surprised if your screen is corrupt.\n");
         }
+        G80ExaAllocStaging(pScreen);
     }
 
     return TRUE;
@@ -506,11 +514,33 @@ G80CloseScreen(CLOSE_SCREEN_ARGS_DECL)
     if(pScrn->vtSema)
         ReleaseDisplay(pScrn);
 
+    if(!pNv->NoAccel)
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                       "Pushbuffer: %u kickoffs, %lu dwords; %u over the dword "
+                       "budget, %u over the pixel budget, %u on idle\n",
+                       (unsigned)pNv->statKickoffs, pNv->statDwords,
+                       (unsigned)pNv->statKickoffDwords,
+                       (unsigned)pNv->statKickoffPixels,
+                       (unsigned)pNv->statKickoffIdle);
+    if(pNv->exa)
+        G80ExaLogStatistics(pScrn);
+    if(pNv->HWCursor)
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                       "Cursor images: %lu cached, %lu loaded, "
+                       "%lu as animation frames\n",
+                       pNv->statCursorHits, pNv->statCursorMisses,
+                       pNv->statCursorFrames);
+
 #ifdef HAVE_XAA_H
     if(pNv->xaa)
         XAADestroyInfoRec(pNv->xaa);
 #endif
     if(pNv->exa) {
+        G80VideoFreeBuffers(pScrn);
+        if(pNv->exaStagingArea) {
+            exaOffscreenFree(pScreen, pNv->exaStagingArea);
+            pNv->exaStagingArea = NULL;
+        }
         if(pNv->exaScreenArea) {
             exaOffscreenFree(pScreen, pNv->exaScreenArea);
             pNv->exaScreenArea = NULL;
@@ -519,6 +549,11 @@ G80CloseScreen(CLOSE_SCREEN_ARGS_DECL)
     }
     xf86_cursors_fini(pScreen);
 
+    if(pNv->blitAdaptor) {
+        free(pNv->blitAdaptor);
+        pNv->blitAdaptor = NULL;
+    }
+
     if(xf86ServerIsExiting()) {
         if(pNv->int10) xf86FreeInt10(pNv->int10);
 #if XSERVER_LIBPCIACCESS
@@ -548,6 +583,9 @@ G80BlockHandler(BLOCKHANDLER_ARGS_DECL)
     if(pNv->DMAKickoffCallback)
         (*pNv->DMAKickoffCallback)(pScrnInfo);
 
+    if(pNv->VideoTimerCallback)
+        (*pNv->VideoTimerCallback)(pScrnInfo, currentTime.milliseconds);
+
     G80OutputResetCachedStatus(pScrnInfo);
 
     pScreen->BlockHandler = pNv->BlockHandler;
@@ -670,6 +708,7 @@ G80InitHW(ScrnInfoPtr pScrn)
     memset(pNv->dmaBase, 0, SKIPS*4);
 
     pNv->dmaPut = 0;
+    pNv->dmaOpenTag = 0;
     pNv->dmaCurrent = SKIPS;
     pNv->dmaMax = (G80_RESERVED_VIDMEM - 0x6000) / 4 - 2;
     pNv->dmaFree = pNv->dmaMax - pNv->dmaCurrent;
@@ -739,7 +778,7 @@ G80InitHW(ScrnInfoPtr pScrn)
         case 24: G80DmaNext (pNv, 0xe6); break;
     }
 
-    pNv->currentRop = ~0; /* Set to something invalid */
+    G80DmaInvalidateState(pNv);
 }
 
 static Bool
@@ -796,7 +835,9 @@ G80ScreenInit(SCREEN_INIT_ARGS_DECL)
 
     xf86SetBlackWhitePixels(pScreen);
 
-    pNv->offscreenHeight = ((pNv->videoRam << 10) - G80_RESERVED_VIDMEM) / pitch;
+    pNv->offscreenHeight = ((pNv->videoRam << 10) - G80_RESERVED_VIDMEM -
+        (G80_CURSOR_SLOTS - 1 + G80_CURSOR_FRAMES) * G80_CURSOR_SLOT_SIZE) /
+        pitch;
     if(pNv->offscreenHeight > 32767) pNv->offscreenHeight = 32767;
     xf86DrvMsg(pScrn->scrnIndex, X_PROBED,
         "%.2f MB available for offscreen pixmaps\n",
@@ -880,6 +921,9 @@ G80ScreenInit(SCREEN_INIT_ARGS_DECL)
         pNv->HWCursor = FALSE;
     }
 
+    if(pNv->exa)
+        G80InitVideo(pScreen);
+
     pScreen->SaveScreen = G80SaveScreen;
 
     pNv->CloseScreen = pScreen->CloseScreen;
@@ -921,6 +965,10 @@ G80EnterVT(VT_FUNC_ARGS_DECL)
     if(pNv->xaa)
         G80InitHW(pScrn);
 #endif
+    if(pNv->exa) {
+        G80DmaInvalidateState(pNv);
+        G80ExaResetFence(pScrn);
+    }
 
     if(!AcquireDisplay(pScrn))
         return FALSE;
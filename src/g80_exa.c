@@ -29,17 +29,12 @@
 #include "g80_type.h"
 #include "g80_dma.h"
 #include "g80_xaa.h"
-
-static void
-waitMarker(ScreenPtr pScreen, int marker)
-{
-    G80Sync(xf86ScreenToScrn(pScreen));
-}
+#include "g80_read.h"
 
 static Bool
 setSrc(G80Ptr pNv, PixmapPtr pSrc)
 {
-    CARD32 depth;
+    CARD32 depth, format[2], surface[5];
 
     switch(pSrc->drawable.depth) {
         case  8: depth = 0x000000f3; break;
@@ -50,25 +45,27 @@ setSrc(G80Ptr pNv, PixmapPtr pSrc)
         default: return FALSE;
     }
 
-    G80DmaStart(pNv, 0x230, 2);
-    G80DmaNext (pNv, depth);
-    G80DmaNext (pNv, 0x00000001);
-    G80DmaStart(pNv, 0x244, 5);
-    G80DmaNext (pNv, exaGetPixmapPitch(pSrc));
-    G80DmaNext (pNv, pSrc->drawable.width);
-    G80DmaNext (pNv, pSrc->drawable.height);
-    G80DmaNext (pNv, 0x00000000);
-    G80DmaNext (pNv, exaGetPixmapOffset(pSrc));
+    format[0] = depth;
+    format[1] = 0x00000001;
+    surface[0] = exaGetPixmapPitch(pSrc);
+    surface[1] = pSrc->drawable.width;
+    surface[2] = pSrc->drawable.height;
+    surface[3] = 0x00000000;
+    surface[4] = exaGetPixmapOffset(pSrc);
+
+    G80DmaState(pNv, 0x230, format, 2);
+    G80DmaState(pNv, 0x244, surface, 5);
 
     return TRUE;
 }
 
 static Bool
-setDst(G80Ptr pNv, PixmapPtr pDst)
+setDstSurface(G80Ptr pNv, int bitDepth, CARD32 pitch, int width, int height,
+              CARD32 offset)
 {
-    CARD32 depth, depth2;
+    CARD32 depth, depth2, format[2], surface[5];
 
-    switch(pDst->drawable.depth) {
+    switch(bitDepth) {
         case  8: depth = 0x000000f3; depth2 = 3; break;
         case 15: depth = 0x000000f8; depth2 = 1; break;
         case 16: depth = 0x000000e8; depth2 = 0; break;
@@ -77,24 +74,131 @@ setDst(G80Ptr pNv, PixmapPtr pDst)
         default: return FALSE;
     }
 
-    G80DmaStart(pNv, 0x200, 2);
-    G80DmaNext (pNv, depth);
-    G80DmaNext (pNv, 0x00000001);
-    G80DmaStart(pNv, 0x214, 5);
-    G80DmaNext (pNv, exaGetPixmapPitch(pDst));
-    G80DmaNext (pNv, pDst->drawable.width);
-    G80DmaNext (pNv, pDst->drawable.height);
-    G80DmaNext (pNv, 0x00000000);
-    G80DmaNext (pNv, exaGetPixmapOffset(pDst));
-    G80DmaStart(pNv, 0x2e8, 1);
-    G80DmaNext (pNv, depth2);
-    G80DmaStart(pNv, 0x584, 1);
-    G80DmaNext (pNv, depth);
-    G80SetClip(pNv, 0, 0, pDst->drawable.width, pDst->drawable.height);
+    format[0] = depth;
+    format[1] = 0x00000001;
+    surface[0] = pitch;
+    surface[1] = width;
+    surface[2] = height;
+    surface[3] = 0x00000000;
+    surface[4] = offset;
+
+    G80DmaState(pNv, 0x200, format, 2);
+    G80DmaState(pNv, 0x214, surface, 5);
+    G80DmaState1(pNv, 0x2e8, depth2);
+    G80DmaState1(pNv, 0x584, depth);
+    G80SetClip(pNv, 0, 0, width, height);
 
     return TRUE;
 }
 
+static Bool
+setDst(G80Ptr pNv, PixmapPtr pDst)
+{
+    if(pDst->drawable.width == 1 && pDst->drawable.height == 1)
+        pNv->exaSolidBusy = TRUE;
+    return setDstSurface(pNv, pDst->drawable.depth, exaGetPixmapPitch(pDst),
+                         pDst->drawable.width, pDst->drawable.height,
+                         exaGetPixmapOffset(pDst));
+}
+
+/* fences */
+
+/*
+ * A fence is a one pixel fill that writes an increasing sequence number
+ * into a dword reserved at the end of the EXA heap.  The 2D engine runs
+ * its commands in order, so once the value has landed everything emitted
+ * before it is done, and waiting for it doesn't require draining the
+ * whole channel the way G80Sync does.
+ */
+static CARD32
+readFence(G80Ptr pNv)
+{
+    return *(volatile CARD32*)(pNv->mem + pNv->fenceOffset);
+}
+
+static CARD32
+emitFence(G80Ptr pNv)
+{
+    const CARD32 fence = ++pNv->fenceSeq;
+
+    setDstSurface(pNv, 32, 256, 1, 1, pNv->fenceOffset);
+    G80DmaState1(pNv, 0x2ac, 4);
+    G80SetRopSolid(pNv, GXcopy, ~0);
+    G80DmaState1(pNv, 0x580, 4);
+    G80DmaState1(pNv, 0x588, fence);
+    G80DmaStart(pNv, 0x600, 4);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, 1);
+    G80DmaNext (pNv, 1);
+
+    pNv->DMAKickoffCallback = G80DMAKickoffCallback;
+    return fence;
+}
+
+static Bool
+fencePassed(G80Ptr pNv, CARD32 fence)
+{
+    return (INT32)(readFence(pNv) - fence) >= 0;
+}
+
+static void
+waitFence(ScrnInfoPtr pScrn, CARD32 fence)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+
+    if(fencePassed(pNv, fence))
+        return;
+
+    if(pNv->DMAKickoffCallback)
+        (*pNv->DMAKickoffCallback)(pScrn);
+    G80DmaKickoff(pNv);
+
+    while(!fencePassed(pNv, fence));
+}
+
+/* Xv blits out of its own buffers and shares the fence with EXA. */
+CARD32
+G80ExaEmitFence(ScrnInfoPtr pScrn)
+{
+    return emitFence(G80PTR(pScrn));
+}
+
+void
+G80ExaWaitFence(ScrnInfoPtr pScrn, CARD32 fence)
+{
+    waitFence(pScrn, fence);
+}
+
+Bool
+G80ExaSetDstSurface(G80Ptr pNv, int bitDepth, CARD32 pitch, int width,
+                    int height, CARD32 offset)
+{
+    return setDstSurface(pNv, bitDepth, pitch, width, height, offset);
+}
+
+/* Everything emitted before a reset has been waited for, so treat the
+   current sequence number as passed. */
+void
+G80ExaResetFence(ScrnInfoPtr pScrn)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+
+    *(volatile CARD32*)(pNv->mem + pNv->fenceOffset) = pNv->fenceSeq;
+}
+
+static int
+markSync(ScreenPtr pScreen)
+{
+    return emitFence(G80PTR(xf86ScreenToScrn(pScreen)));
+}
+
+static void
+waitMarker(ScreenPtr pScreen, int marker)
+{
+    waitFence(xf86ScreenToScrn(pScreen), marker);
+}
+
 /* solid fills */
 
 static Bool
@@ -108,13 +212,10 @@ prepareSolid(PixmapPtr      pPixmap,
 
     if(pPixmap->drawable.depth > 24) return FALSE;
     if(!setDst(pNv, pPixmap)) return FALSE;
-    G80DmaStart(pNv, 0x2ac, 1);
-    G80DmaNext (pNv, 4);
+    G80DmaState1(pNv, 0x2ac, 4);
     G80SetRopSolid(pNv, alu, planemask);
-    G80DmaStart(pNv, 0x580, 1);
-    G80DmaNext (pNv, 4);
-    G80DmaStart(pNv, 0x588, 1);
-    G80DmaNext (pNv, fg);
+    G80DmaState1(pNv, 0x580, 4);
+    G80DmaState1(pNv, 0x588, fg);
 
     pNv->DMAKickoffCallback = G80DMAKickoffCallback;
     return TRUE;
@@ -132,8 +233,7 @@ solid(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
     G80DmaNext (pNv, x2);
     G80DmaNext (pNv, y2);
 
-    if((x2 - x1) * (y2 - y1) >= 512)
-        G80DmaKickoff(pNv);
+    G80DmaAutoKickoff(pNv, (x2 - x1) * (y2 - y1));
 }
 
 static void
@@ -156,11 +256,10 @@ prepareCopy(PixmapPtr       pSrcPixmap,
 
     if(!setSrc(pNv, pSrcPixmap)) return FALSE;
     if(!setDst(pNv, pDstPixmap)) return FALSE;
-    G80DmaStart(pNv, 0x2ac, 1);
     if(alu == GXcopy && planemask == ~0) {
-        G80DmaNext (pNv, 3);
+        G80DmaState1(pNv, 0x2ac, 3);
     } else {
-        G80DmaNext (pNv, 4);
+        G80DmaState1(pNv, 0x2ac, 4);
         G80SetRopSolid(pNv, alu, planemask);
     }
     pNv->DMAKickoffCallback = G80DMAKickoffCallback;
@@ -195,8 +294,7 @@ copy(PixmapPtr pDstPixmap,
     G80DmaNext (pNv, 0);
     G80DmaNext (pNv, srcY);
 
-    if(width * height >= 512)
-        G80DmaKickoff(pNv);
+    G80DmaAutoKickoff(pNv, width * height);
 }
 
 static void
@@ -206,13 +304,271 @@ doneCopy(PixmapPtr pDstPixmap)
 
 /* composite */
 
+/*
+ * The 2D engine can only scale its source by a constant (BETA4) and blend
+ * it over the destination with the source alpha, so this covers Src and
+ * Over with an optional solid mask.  Anything needing a per-pixel mask is
+ * left to the software fallback.
+ */
+
+static struct {
+    int width, height;
+    Bool repeat;
+} compositeSrc;
+
+/* Rejections are only counted, this is called far too often to log.
+   The counts are broken down by operator and by reason so the log at
+   CloseScreen shows what is worth accelerating next. */
+static Bool
+fallback(int op, PicturePtr pDst, G80FallbackReason why)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->pDrawable->pScreen);
+    G80Ptr pNv = G80PTR(pScrn);
+
+    pNv->statCompositeOps[min(op, G80_COMPOSITE_OPS - 1)]++;
+    pNv->statCompositeWhy[why]++;
+    return FALSE;
+}
+
 static Bool
 checkComposite(int          op,
                PicturePtr   pSrc,
                PicturePtr   pMask,
                PicturePtr   pDst)
 {
-    return FALSE;
+    if(op != PictOpSrc && op != PictOpOver)
+        return fallback(op, pDst, G80_FALLBACK_OP);
+    if(pDst->alphaMap)
+        return fallback(op, pDst, G80_FALLBACK_ALPHA_MAP);
+
+    switch(pDst->format) {
+        case PICT_a8r8g8b8:
+        case PICT_x8r8g8b8:
+        case PICT_r5g6b5:
+            break;
+        case PICT_a8:
+            /* a plain copy is all we can do without color channels */
+            if(pSrc->format == PICT_a8 && op == PictOpSrc && !pMask)
+                break;
+            return fallback(op, pDst, G80_FALLBACK_DST_FORMAT);
+        default:
+            return fallback(op, pDst, G80_FALLBACK_DST_FORMAT);
+    }
+
+    if(!pSrc->pDrawable)
+        return fallback(op, pDst, G80_FALLBACK_NO_DRAWABLE);
+    if(pSrc->alphaMap)
+        return fallback(op, pDst, G80_FALLBACK_ALPHA_MAP);
+    if(pSrc->transform)
+        return fallback(op, pDst, G80_FALLBACK_TRANSFORM);
+    if(pSrc->repeat && pSrc->repeatType != RepeatNormal)
+        return fallback(op, pDst, G80_FALLBACK_TRANSFORM);
+
+    switch(pSrc->format) {
+        case PICT_a8r8g8b8:
+        case PICT_x8r8g8b8:
+            break;
+        case PICT_a8:
+            if(pDst->format == PICT_a8)
+                break;
+            /* fall through */
+        default:
+            return fallback(op, pDst, G80_FALLBACK_SRC_FORMAT);
+    }
+
+    /* Both SRCCOPY and SRCCOPY_PREMULT would copy the undefined X byte of
+       the source into the destination alpha. */
+    if(PICT_FORMAT_A(pDst->format) && !PICT_FORMAT_A(pSrc->format))
+        return fallback(op, pDst, G80_FALLBACK_SRC_ALPHA);
+
+    if(pMask) {
+        if(!pMask->pDrawable)
+            return fallback(op, pDst, G80_FALLBACK_NO_DRAWABLE);
+        if(pMask->pDrawable->width != 1 || pMask->pDrawable->height != 1 ||
+           !pMask->repeat)
+            return fallback(op, pDst, G80_FALLBACK_MASK);
+        if(pMask->componentAlpha)
+            return fallback(op, pDst, G80_FALLBACK_MASK);
+        if(pMask->alphaMap)
+            return fallback(op, pDst, G80_FALLBACK_ALPHA_MAP);
+        if(pMask->format != PICT_a8 && pMask->format != PICT_a8r8g8b8 &&
+           pMask->format != PICT_x8r8g8b8)
+            return fallback(op, pDst, G80_FALLBACK_MASK);
+    }
+
+    return TRUE;
+}
+
+void
+G80ExaLogStatistics(ScrnInfoPtr pScrn)
+{
+    static const char *const whyNames[G80_FALLBACK_REASONS] = {
+        "operator", "destination format", "source format",
+        "x8 source alpha", "mask", "transform or repeat", "alpha map",
+        "source or mask without a drawable",
+    };
+    G80Ptr pNv = G80PTR(pScrn);
+    unsigned long total = 0;
+    int i;
+
+    for(i = 0; i < G80_FALLBACK_REASONS; i++)
+        total += pNv->statCompositeWhy[i];
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                   "Composite: %lu operations left to software\n", total);
+    for(i = 0; i < G80_COMPOSITE_OPS; i++)
+        if(pNv->statCompositeOps[i])
+            xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                           "Composite: %lu with operator %d%s\n",
+                           pNv->statCompositeOps[i], i,
+                           (i == G80_COMPOSITE_OPS - 1) ? " or above" : "");
+    for(i = 0; i < G80_FALLBACK_REASONS; i++)
+        if(pNv->statCompositeWhy[i])
+            xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                           "Composite: %lu for the %s\n",
+                           pNv->statCompositeWhy[i], whyNames[i]);
+}
+
+/* Read the alpha of a 1x1 mask.  It has been migrated by now, but the
+   engine may still be drawing into it if setDst has pointed it at a 1x1
+   pixmap since the last time we looked. */
+static CARD32
+maskAlpha(ScrnInfoPtr pScrn, PicturePtr pMask, PixmapPtr pMaskPix)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+    unsigned char *p = pNv->mem + exaGetPixmapOffset(pMaskPix);
+
+    if(pMask->format == PICT_x8r8g8b8)
+        return 0xff;
+
+    if(pNv->exaSolidBusy) {
+        waitFence(pScrn, emitFence(pNv));
+        pNv->exaSolidBusy = FALSE;
+    }
+
+    switch(pMask->format) {
+        case PICT_a8:
+            return *p;
+        case PICT_a8r8g8b8:
+            return *(CARD32*)p >> 24;
+        default:
+            return 0xff;
+    }
+}
+
+static Bool
+prepareComposite(int          op,
+                 PicturePtr   pSrcPicture,
+                 PicturePtr   pMaskPicture,
+                 PicturePtr   pDstPicture,
+                 PixmapPtr    pSrc,
+                 PixmapPtr    pMask,
+                 PixmapPtr    pDst)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    G80Ptr pNv = G80PTR(pScrn);
+    CARD32 alpha = 0xff;
+
+    if(pMask)
+        alpha = maskAlpha(pScrn, pMaskPicture, pMask);
+
+    /* BLEND_PREMULT would scale by the undefined alpha byte of an x8
+       source, and SRCCOPY_PREMULT drops the destination term of Over. */
+    if(alpha != 0xff && op == PictOpOver &&
+       !PICT_FORMAT_A(pSrcPicture->format))
+        return fallback(op, pDstPicture, G80_FALLBACK_SRC_ALPHA);
+
+    if(!setSrc(pNv, pSrc)) return FALSE;
+    if(!setDst(pNv, pDst)) return FALSE;
+
+    if(alpha == 0xff) {
+        if(op == PictOpOver && PICT_FORMAT_A(pSrcPicture->format))
+            G80DmaState1(pNv, 0x2ac, 6); /* BLEND_PREMULT */
+        else
+            G80DmaState1(pNv, 0x2ac, 3); /* SRCCOPY */
+    } else {
+        if(op == PictOpOver)
+            G80DmaState1(pNv, 0x2ac, 6); /* BLEND_PREMULT */
+        else
+            G80DmaState1(pNv, 0x2ac, 5); /* SRCCOPY_PREMULT */
+    }
+    G80DmaState1(pNv, 0x2a8,
+                 (alpha << 24) | (alpha << 16) | (alpha << 8) | alpha);
+
+    compositeSrc.width = pSrc->drawable.width;
+    compositeSrc.height = pSrc->drawable.height;
+    compositeSrc.repeat = pSrcPicture->repeat;
+
+    pNv->DMAKickoffCallback = G80DMAKickoffCallback;
+    return TRUE;
+}
+
+/*
+ * A zero step keeps sampling the same source column or row, which
+ * stretches one pixel wide repeating sources in a single blit.
+ */
+static void
+compositeBlit(G80Ptr pNv, int srcX, int srcY, int dstX, int dstY,
+              int width, int height, int dudx, int dvdy)
+{
+    G80DmaStart(pNv, 0x110, 1);
+    G80DmaNext (pNv, 0);
+    G80DmaStart(pNv, 0x8b0, 12);
+    G80DmaNext (pNv, dstX);
+    G80DmaNext (pNv, dstY);
+    G80DmaNext (pNv, width);
+    G80DmaNext (pNv, height);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, dudx);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, dvdy);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, srcX);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, srcY);
+}
+
+static void
+composite(PixmapPtr pDst,
+          int       srcX,
+          int       srcY,
+          int       maskX,
+          int       maskY,
+          int       dstX,
+          int       dstY,
+          int       width,
+          int       height)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    G80Ptr pNv = G80PTR(pScrn);
+    const int sw = compositeSrc.width, sh = compositeSrc.height;
+    const int dudx = (compositeSrc.repeat && sw == 1) ? 0 : 1;
+    const int dvdy = (compositeSrc.repeat && sh == 1) ? 0 : 1;
+    int x, y, w, h, tx, ty;
+
+    if(!compositeSrc.repeat) {
+        compositeBlit(pNv, srcX, srcY, dstX, dstY, width, height, 1, 1);
+    } else {
+        /* tile the source over the destination */
+        ty = srcY % sh;
+        if(ty < 0) ty += sh;
+        for(y = dstY; y < dstY + height; y += h, ty = 0) {
+            h = dvdy ? min(dstY + height - y, sh - ty) : height;
+            tx = srcX % sw;
+            if(tx < 0) tx += sw;
+            for(x = dstX; x < dstX + width; x += w, tx = 0) {
+                w = dudx ? min(dstX + width - x, sw - tx) : width;
+                compositeBlit(pNv, tx, ty, x, y, w, h, dudx, dvdy);
+            }
+        }
+    }
+
+    G80DmaAutoKickoff(pNv, width * height);
+}
+
+static void
+doneComposite(PixmapPtr pDst)
+{
 }
 
 /* upload to screen */
@@ -230,7 +586,7 @@ upload(PixmapPtr pDst,
     G80Ptr pNv = G80PTR(pScrn);
     const int Bpp = pDst->drawable.bitsPerPixel >> 3;
     int line_dwords = (w * Bpp + 3) / 4;
-    const Bool kickoff = w * h >= 512;
+    const int pixels = w * h;
     CARD32 depth;
 
     if(!setDst(pNv, pDst)) return FALSE;
@@ -244,8 +600,7 @@ upload(PixmapPtr pDst,
     }
 
     G80SetClip(pNv, x, y, w, h);
-    G80DmaStart(pNv, 0x2ac, 1);
-    G80DmaNext (pNv, 3);
+    G80DmaState1(pNv, 0x2ac, 3);
     G80DmaStart(pNv, 0x800, 2);
     G80DmaNext (pNv, 0);
     G80DmaNext (pNv, depth);
@@ -280,10 +635,130 @@ upload(PixmapPtr pDst,
         src += src_pitch;
     }
 
-    if(kickoff)
-        G80DmaKickoff(pNv);
-    else
-        pNv->DMAKickoffCallback = G80DMAKickoffCallback;
+    pNv->DMAKickoffCallback = G80DMAKickoffCallback;
+    G80DmaAutoKickoff(pNv, pixels);
+
+    return TRUE;
+}
+
+/* download from screen */
+
+static G80ReadLinesProc readLinesProc = G80ReadLines;
+
+#define STAGING_SIZE (1024 * 1024)
+
+/*
+ * Called right after the screen area is carved out, both when the screen
+ * resources are created and on every resize.  Allocating from inside
+ * DownloadFromScreen instead could evict pixmaps, including the one being
+ * read.  download() reads directly if this failed.
+ */
+void
+G80ExaAllocStaging(ScreenPtr pScreen)
+{
+    G80Ptr pNv = G80PTR(xf86ScreenToScrn(pScreen));
+
+    if(!pNv->exaStagingArea)
+        pNv->exaStagingArea = exaOffscreenAlloc(pScreen, STAGING_SIZE, 256,
+                                                TRUE, NULL, NULL);
+}
+
+static Bool
+stagingBlit(G80Ptr pNv, PixmapPtr pSrc, int x, int y, int w, int h,
+            int pitch, CARD32 offset)
+{
+    if(!setSrc(pNv, pSrc)) return FALSE;
+    if(!setDstSurface(pNv, pSrc->drawable.depth, pitch, w, h, offset))
+        return FALSE;
+    G80DmaState1(pNv, 0x2ac, 3);
+    G80DmaStart(pNv, 0x110, 1);
+    G80DmaNext (pNv, 0);
+    G80DmaStart(pNv, 0x8b0, 12);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, w);
+    G80DmaNext (pNv, h);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, 1);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, 1);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, x);
+    G80DmaNext (pNv, 0);
+    G80DmaNext (pNv, y);
+
+    return TRUE;
+}
+
+/*
+ * Blit the rectangle into a packed staging area with the 2D engine and
+ * stream it back from there, so the CPU reads long sequential runs
+ * instead of scattered pieces of the source pixmap's rows.  The staging
+ * area is split in two halves so the engine fills one while the CPU
+ * reads the other.
+ */
+static Bool
+download(PixmapPtr pSrc,
+         int       x,
+         int       y,
+         int       w,
+         int       h,
+         char      *dst,
+         int       dst_pitch)
+{
+    ScreenPtr pScreen = pSrc->drawable.pScreen;
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    G80Ptr pNv = G80PTR(pScrn);
+    const int Bpp = pSrc->drawable.bitsPerPixel >> 3;
+    const int line_len = w * Bpp;
+    const int pitch = (line_len + 255) & ~255;
+    ExaOffscreenArea *area = pNv->exaStagingArea;
+    CARD32 fence[2];
+    int lines, half, n[2];
+
+    if(!area || pitch > (area->size >> 1)) {
+        const int src_pitch = exaGetPixmapPitch(pSrc);
+
+        G80Sync(pScrn);
+        readLinesProc(dst, dst_pitch, pNv->mem + exaGetPixmapOffset(pSrc) +
+                      (y * src_pitch) + (x * Bpp), src_pitch, line_len, h);
+        return TRUE;
+    }
+
+    lines = (area->size >> 1) / pitch;
+
+    /* prime both halves */
+    for(half = 0; half < 2; half++) {
+        n[half] = min(h, lines);
+        if(n[half] == 0)
+            continue;
+        if(!stagingBlit(pNv, pSrc, x, y, w, n[half], pitch,
+                        area->offset + (half * lines * pitch)))
+            return FALSE;
+        fence[half] = emitFence(pNv);
+        y += n[half];
+        h -= n[half];
+    }
+    G80DmaKickoff(pNv);
+
+    for(half = 0; n[half] > 0; half ^= 1) {
+        waitFence(pScrn, fence[half]);
+        readLinesProc(dst, dst_pitch,
+                      pNv->mem + area->offset + (half * lines * pitch),
+                      pitch, line_len, n[half]);
+        dst += n[half] * dst_pitch;
+
+        /* refill the half we just drained */
+        n[half] = min(h, lines);
+        if(n[half] > 0) {
+            stagingBlit(pNv, pSrc, x, y, w, n[half], pitch,
+                        area->offset + (half * lines * pitch));
+            fence[half] = emitFence(pNv);
+            G80DmaKickoff(pNv);
+            y += n[half];
+            h -= n[half];
+        }
+    }
 
     return TRUE;
 }
@@ -299,11 +774,17 @@ Bool G80ExaInit(ScreenPtr pScreen, ScrnInfoPtr pScrn)
     exa = pNv->exa = exaDriverAlloc();
     if(!exa) return FALSE;
 
+    readLinesProc = G80PickReadLines();
+
+    /* the last 256 bytes of the heap hold the fence */
+    pNv->fenceOffset = pitch * pNv->offscreenHeight - 256;
+    G80ExaResetFence(pScrn);
+
     exa->exa_major         = EXA_VERSION_MAJOR;
     exa->exa_minor         = EXA_VERSION_MINOR;
     exa->memoryBase        = pNv->mem;
     exa->offScreenBase     = 0;
-    exa->memorySize        = pitch * pNv->offscreenHeight;
+    exa->memorySize        = pNv->fenceOffset;
     exa->pixmapOffsetAlign = 256;
     exa->pixmapPitchAlign  = 256;
     exa->flags             = EXA_OFFSCREEN_PIXMAPS;
@@ -311,19 +792,21 @@ Bool G80ExaInit(ScreenPtr pScreen, ScrnInfoPtr pScrn)
     exa->maxY              = 8192;
 
     /**** Rendering ops ****/
-    exa->PrepareSolid     = prepareSolid;
-    exa->Solid            = solid;
-    exa->DoneSolid        = doneSolid;
-    exa->PrepareCopy      = prepareCopy;
-    exa->Copy             = copy;
-    exa->DoneCopy         = doneCopy;
-    exa->CheckComposite   = checkComposite;
-    //exa->PrepareComposite = prepareComposite;
-    //exa->Composite        = composite;
-    //exa->DoneComposite    = doneComposite;
-    exa->UploadToScreen   = upload;
-
-    exa->WaitMarker       = waitMarker;
+    exa->PrepareSolid       = prepareSolid;
+    exa->Solid              = solid;
+    exa->DoneSolid          = doneSolid;
+    exa->PrepareCopy        = prepareCopy;
+    exa->Copy               = copy;
+    exa->DoneCopy           = doneCopy;
+    exa->CheckComposite     = checkComposite;
+    exa->PrepareComposite   = prepareComposite;
+    exa->Composite          = composite;
+    exa->DoneComposite      = doneComposite;
+    exa->UploadToScreen     = upload;
+    exa->DownloadFromScreen = download;
+
+    exa->MarkSync           = markSync;
+    exa->WaitMarker         = waitMarker;
 
     return exaDriverInit(pScreen, exa);
 }
@@ -1 +1,8 @@
 Bool G80ExaInit(ScreenPtr pScreen, ScrnInfoPtr pScrn);
+void G80ExaLogStatistics(ScrnInfoPtr pScrn);
+void G80ExaAllocStaging(ScreenPtr pScreen);
+void G80ExaResetFence(ScrnInfoPtr pScrn);
+CARD32 G80ExaEmitFence(ScrnInfoPtr pScrn);
+void G80ExaWaitFence(ScrnInfoPtr pScrn, CARD32 fence);
+Bool G80ExaSetDstSurface(G80Ptr pNv, int bitDepth, CARD32 pitch, int width,
+                         int height, CARD32 offset);
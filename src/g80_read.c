@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2007 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#ifdef HAVE_SSE41
+#include <smmintrin.h>
+#endif
+
+#include "g80_read.h"
+
+/*
+ * BAR1 is mapped write-combined, so plain loads from it are uncached and
+ * go out one at a time.  MOVNTDQA instead pulls a whole 64 byte line into
+ * a streaming buffer per transaction.  These only deal with plain
+ * pointers so they work the same on any memory standing in for the
+ * aperture.
+ */
+
+void
+G80ReadLines(char *dst, int dst_pitch, const unsigned char *src,
+             int src_pitch, int len, int h)
+{
+    while(h--) {
+        memcpy(dst, src, len);
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+}
+
+#ifdef HAVE_SSE41
+/* Loads may touch up to 15 bytes on either side of a line.  That is
+   harmless since lines start and end within 256 byte aligned rows. */
+__attribute__((target("sse4.1"))) void
+G80ReadLinesSSE41(char *dst, int dst_pitch, const unsigned char *src,
+                  int src_pitch, int len, int h)
+{
+    while(h--) {
+        const int skip = (unsigned long)src & 15;
+        __m128i *s = (__m128i*)(src - skip);
+        __m128i tmp;
+        char *d = dst;
+        int n = len;
+
+        if(skip) {
+            int count = 16 - skip < n ? 16 - skip : n;
+
+            tmp = _mm_stream_load_si128(s++);
+            memcpy(d, (char*)&tmp + skip, count);
+            d += count;
+            n -= count;
+        }
+        while(n >= 64) {
+            __m128i a = _mm_stream_load_si128(s + 0);
+            __m128i b = _mm_stream_load_si128(s + 1);
+            __m128i c = _mm_stream_load_si128(s + 2);
+            __m128i e = _mm_stream_load_si128(s + 3);
+
+            _mm_storeu_si128((__m128i*)(d +  0), a);
+            _mm_storeu_si128((__m128i*)(d + 16), b);
+            _mm_storeu_si128((__m128i*)(d + 32), c);
+            _mm_storeu_si128((__m128i*)(d + 48), e);
+            s += 4;
+            d += 64;
+            n -= 64;
+        }
+        while(n >= 16) {
+            _mm_storeu_si128((__m128i*)d, _mm_stream_load_si128(s++));
+            d += 16;
+            n -= 16;
+        }
+        if(n > 0) {
+            tmp = _mm_stream_load_si128(s);
+            memcpy(d, &tmp, n);
+        }
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+}
+#endif
+
+G80ReadLinesProc
+G80PickReadLines(void)
+{
+#ifdef HAVE_SSE41
+    if(__builtin_cpu_supports("sse4.1"))
+        return G80ReadLinesSSE41;
+#endif
+    return G80ReadLines;
+}
@@ -0,0 +1,20 @@
+#ifndef __G80_READ_H__
+#define __G80_READ_H__
+
+/*
+ * Line copies out of the framebuffer aperture for DownloadFromScreen, in
+ * g80_read.c.  Copies h lines of len bytes each.
+ */
+typedef void (*G80ReadLinesProc)(char *dst, int dst_pitch,
+                                 const unsigned char *src, int src_pitch,
+                                 int len, int h);
+
+void G80ReadLines(char *dst, int dst_pitch, const unsigned char *src,
+                  int src_pitch, int len, int h);
+#ifdef HAVE_SSE41
+void G80ReadLinesSSE41(char *dst, int dst_pitch, const unsigned char *src,
+                       int src_pitch, int len, int h);
+#endif
+G80ReadLinesProc G80PickReadLines(void);
+
+#endif /* __G80_READ_H__ */
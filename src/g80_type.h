@@ -9,6 +9,7 @@
 #include <xaa.h>
 #endif
 #include <xf86fbman.h>
+#include <xf86xv.h>
 #include "compat-api.h"
 #define G80_NUM_I2C_PORTS 10
 
@@ -35,11 +36,37 @@ typedef enum PanelType {
     LVDS,
 } PanelType;
 
+#define G80_STATE_METHODS 0x600
+
+/* Pushbuffer, LUTs and cursor at the top of video memory */
+#define G80_RESERVED_VIDMEM 0xe000
+
+/* Cursor image cache, see g80_cursor.c */
+#define G80_CURSOR_SLOTS 4
+#define G80_CURSOR_FRAMES 16
+#define G80_CURSOR_SLOT_SIZE (64 * 64 * 4)
+
 typedef enum AccelMethod {
     XAA,
     EXA,
 } AccelMethod;
 
+/* Why a Render Composite was left to software */
+typedef enum G80FallbackReason {
+    G80_FALLBACK_OP,
+    G80_FALLBACK_DST_FORMAT,
+    G80_FALLBACK_SRC_FORMAT,
+    G80_FALLBACK_SRC_ALPHA,
+    G80_FALLBACK_MASK,
+    G80_FALLBACK_TRANSFORM,
+    G80_FALLBACK_ALPHA_MAP,
+    G80_FALLBACK_NO_DRAWABLE,
+    G80_FALLBACK_REASONS
+} G80FallbackReason;
+
+/* Render operators are below 64, the last slot counts anything above */
+#define G80_COMPOSITE_OPS 64
+
 typedef struct G80Rec {
 #if XSERVER_LIBPCIACCESS
     struct pci_device  *pPci;
@@ -84,6 +111,18 @@ typedef struct G80Rec {
     /* EXA */
     ExaDriverPtr        exa;
     ExaOffscreenArea   *exaScreenArea;
+    ExaOffscreenArea   *exaStagingArea;
+    CARD32              fenceOffset;
+    CARD32              fenceSeq;
+    Bool                exaSolidBusy;   /* 1x1 pixmap drawn since last read */
+
+    /* Composite fallbacks, logged at CloseScreen */
+    unsigned long       statCompositeOps[G80_COMPOSITE_OPS];
+    unsigned long       statCompositeWhy[G80_FALLBACK_REASONS];
+
+    /* Xv */
+    XF86VideoAdaptorPtr blitAdaptor;
+    void              (*VideoTimerCallback)(ScrnInfoPtr, Time);
 
     /* DMA command buffer */
     CARD32              dmaPut;
@@ -91,8 +130,36 @@ typedef struct G80Rec {
     CARD32              dmaFree;
     CARD32              dmaMax;
     CARD32 *            dmaBase;
+    CARD32              dmaPixels;
+    CARD32              dmaIdleCheck;
+    CARD32              dmaOpenTag;
+    CARD32              dmaOpenHeader;
+    CARD32              dmaOpenEnd;
+    int                 dmaOpenSize;
     void              (*DMAKickoffCallback)(ScrnInfoPtr);
 
+    /* Shadow of the 2D methods below G80_STATE_METHODS, see G80DmaState */
+    CARD32              state[G80_STATE_METHODS / 4];
+    CARD32              stateValid[G80_STATE_METHODS / 128];
+
+    /* Cursor image cache */
+    CARD64              cursorKey[G80_CURSOR_SLOTS + G80_CURSOR_FRAMES];
+    CARD32              cursorStamp[G80_CURSOR_SLOTS + G80_CURSOR_FRAMES];
+    CARD32              cursorClock;
+    CARD32              cursorLoadTime;
+    int                 cursorFrameNext;
+    int                 cursorFrameMisses;
+    unsigned long       statCursorHits;
+    unsigned long       statCursorMisses;
+    unsigned long       statCursorFrames;
+
+    /* kickoff statistics, logged at CloseScreen */
+    CARD32              statKickoffs;
+    CARD32              statKickoffDwords;
+    CARD32              statKickoffPixels;
+    CARD32              statKickoffIdle;
+    unsigned long       statDwords;
+
     CloseScreenProcPtr           CloseScreen;
     ScreenBlockHandlerProcPtr    BlockHandler;
 } G80Rec, *G80Ptr;
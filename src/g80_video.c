@@ -0,0 +1,754 @@
+/*
+ * Copyright (c) 2007 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "g80_type.h"
+#include <xf86xv.h>
+#include <X11/extensions/Xv.h>
+#include <dixstruct.h>
+#include <fourcc.h>
+
+#include "g80_display.h"
+#include "g80_dma.h"
+#include "g80_exa.h"
+#include "g80_video.h"
+
+/*
+ * Blit adaptor.  The 2D engine has no YUV surface formats, so each frame
+ * is converted to X8R8G8B8 at its source size while it is copied into
+ * video memory, and the engine then scales it onto the screen with its
+ * filtered blit, converting to the screen's format on the way.  Each port
+ * has two buffers carved out of the EXA heap, each guarded by a fence, so
+ * the copy of one frame overlaps the blit of the previous one.
+ */
+
+#define FREE_DELAY      5000  /* milliseconds */
+
+#define FREE_TIMER      0x02
+
+#define NUM_PORTS       32
+#define NUM_BUFFERS     2
+
+typedef struct _G80PortPrivRec {
+    CARD32              videoStatus;
+    Time                videoTime;
+    Bool                SyncToVBlank;
+    ExaOffscreenArea   *area;
+    int                 bufferSize;
+    int                 currentBuffer;
+    CARD32              fence[NUM_BUFFERS];
+    CARD32              fenced;
+} G80PortPrivRec, *G80PortPrivPtr;
+
+#define GET_PORT_PRIVATE(pNv, i) \
+    ((G80PortPrivPtr)((pNv)->blitAdaptor->pPortPrivates[i].ptr))
+
+#define MAKE_ATOM(a) MakeAtom(a, sizeof(a) - 1, TRUE)
+
+static Atom xvSetDefaults, xvSyncToVBlank;
+
+/* client libraries expect an encoding */
+static XF86VideoEncodingRec DummyEncoding =
+{
+    0,
+    "XV_IMAGE",
+    4096, 4096,
+    {1, 1}
+};
+
+#define NUM_FORMATS 6
+
+static XF86VideoFormatRec G80Formats[NUM_FORMATS] =
+{
+    {15, TrueColor}, {16, TrueColor}, {24, TrueColor},
+    {15, DirectColor}, {16, DirectColor}, {24, DirectColor}
+};
+
+#define NUM_ATTRIBUTES 2
+
+static XF86AttributeRec G80Attributes[NUM_ATTRIBUTES] =
+{
+    {XvSettable             , 0, 0, "XV_SET_DEFAULTS"},
+    {XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"}
+};
+
+#define NUM_IMAGES 5
+
+#define FOURCC_RGB 0x0000003
+#define XVIMAGE_RGB \
+   { \
+        FOURCC_RGB, \
+        XvRGB, \
+        LSBFirst, \
+        { 0x03, 0x00, 0x00, 0x00, \
+          0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+        32, \
+        XvPacked, \
+        1, \
+        24, 0x00ff0000, 0x0000ff00, 0x000000ff, \
+        0, 0, 0, \
+        0, 0, 0, \
+        0, 0, 0, \
+        {'B','G','R','X',\
+          0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+        XvTopToBottom \
+   }
+
+static XF86ImageRec G80Images[NUM_IMAGES] =
+{
+    XVIMAGE_YUY2,
+    XVIMAGE_YV12,
+    XVIMAGE_UYVY,
+    XVIMAGE_I420,
+    XVIMAGE_RGB
+};
+
+/* color conversion */
+
+/*
+ * ITU-R BT.601 with the usual 16-235 luma range, in 8 bit fixed point.
+ * Red lands within [-223, 481], green within [-171, 432] and blue within
+ * [-277, 534]; the bias and table size cover [-384, 639].
+ */
+#define CLAMP_BIAS 384
+
+static CARD8 clampTab[1024];
+
+static void
+initClampTab(void)
+{
+    int i;
+
+    for(i = 0; i < 1024; i++)
+        clampTab[i] = (i < CLAMP_BIAS) ? 0 :
+                      (i > CLAMP_BIAS + 255) ? 255 : (i - CLAMP_BIAS);
+}
+
+static inline CARD32
+yuvPixel(int y, int u, int v)
+{
+    const int c = 298 * (y - 16) + 128;
+    const int d = u - 128;
+    const int e = v - 128;
+    const CARD8 *clamp = clampTab + CLAMP_BIAS;
+
+    return (clamp[(c + 409 * e) >> 8] << 16) |
+           (clamp[(c - 100 * d - 208 * e) >> 8] << 8) |
+            clamp[(c + 516 * d) >> 8];
+}
+
+static void
+convert420(CARD32 *dst, int dstPitch, const CARD8 *srcY, const CARD8 *srcU,
+           const CARD8 *srcV, int pitchY, int pitchUV, int top, int w, int h)
+{
+    int i, j;
+
+    for(j = top; j < top + h; j++) {
+        const CARD8 *y = srcY + (j * pitchY);
+        const CARD8 *u = srcU + ((j >> 1) * pitchUV);
+        const CARD8 *v = srcV + ((j >> 1) * pitchUV);
+        CARD32 *d = dst;
+
+        for(i = 0; i < w; i += 2) {
+            d[0] = yuvPixel(y[0], *u, *v);
+            d[1] = yuvPixel(y[1], *u, *v);
+            d += 2; y += 2; u++; v++;
+        }
+
+        dst = (CARD32*)((CARD8*)dst + dstPitch);
+    }
+}
+
+/* yOff is 0 for YUY2 and 1 for UYVY */
+static void
+convert422(CARD32 *dst, int dstPitch, const CARD8 *src, int srcPitch,
+           int yOff, int w, int h)
+{
+    const int uOff = yOff ^ 1;
+    int i;
+
+    while(h--) {
+        const CARD8 *s = src;
+        CARD32 *d = dst;
+
+        for(i = 0; i < w; i += 2) {
+            d[0] = yuvPixel(s[yOff], s[uOff], s[uOff + 2]);
+            d[1] = yuvPixel(s[yOff + 2], s[uOff], s[uOff + 2]);
+            d += 2; s += 4;
+        }
+
+        src += srcPitch;
+        dst = (CARD32*)((CARD8*)dst + dstPitch);
+    }
+}
+
+static void
+copyRGB(CARD32 *dst, int dstPitch, const CARD8 *src, int srcPitch,
+        int w, int h)
+{
+    while(h--) {
+        memcpy(dst, src, w * 4);
+        src += srcPitch;
+        dst = (CARD32*)((CARD8*)dst + dstPitch);
+    }
+}
+
+/* vblank */
+
+/* The CRTC showing most of the box, if any. */
+static xf86CrtcPtr
+videoCrtc(ScrnInfoPtr pScrn, BoxPtr box)
+{
+    xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(pScrn);
+    xf86CrtcPtr best = NULL;
+    int bestArea = 0, i;
+
+    for(i = 0; i < xf86_config->num_crtc; i++) {
+        xf86CrtcPtr crtc = xf86_config->crtc[i];
+        int x1, y1, x2, y2;
+
+        if(!crtc->enabled)
+            continue;
+
+        x1 = max(box->x1, crtc->x);
+        y1 = max(box->y1, crtc->y);
+        x2 = min(box->x2, crtc->x + crtc->mode.HDisplay);
+        y2 = min(box->y2, crtc->y + crtc->mode.VDisplay);
+
+        if(x2 > x1 && y2 > y1 && (x2 - x1) * (y2 - y1) > bestArea) {
+            bestArea = (x2 - x1) * (y2 - y1);
+            best = crtc;
+        }
+    }
+
+    return best;
+}
+
+/*
+ * The head's current line counts from the start of sync, with the blank
+ * start and end given in the same terms.
+ */
+static Bool
+inVBlank(G80Ptr pNv, Head head)
+{
+    const int blanke = pNv->reg[(0x00610AEC + 0x540 * head)/4] >> 16;
+    const int blanks = pNv->reg[(0x00610AF4 + 0x540 * head)/4] >> 16;
+    const int total  = pNv->reg[(0x00610AFC + 0x540 * head)/4] >> 16;
+    int line = pNv->reg[(0x00616344 + 0x800 * head)/4] & 0xffff;
+
+    if(line >= blanks)
+        line -= total;
+    if(blanke < blanks)
+        line -= blanke + 1;
+
+    return line < 0;
+}
+
+/*
+ * The 2D engine can't be told to wait for the blank, so spin until the
+ * head showing the video is in it.  A blank comes around at least once a
+ * frame, so give up after one in case the head isn't scanning out.
+ */
+static void
+waitVBlank(ScrnInfoPtr pScrn, BoxPtr box)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+    xf86CrtcPtr crtc = videoCrtc(pScrn, box);
+    CARD32 start, period = 17;
+    Head head;
+
+    if(!crtc)
+        return;
+    head = G80CrtcGetHead(crtc);
+    if(crtc->mode.Clock > 0)
+        period = (crtc->mode.HTotal * crtc->mode.VTotal +
+                  crtc->mode.Clock - 1) / crtc->mode.Clock;
+
+    /* get everything queued so far out of the way first */
+    G80DmaKickoff(pNv);
+
+    start = GetTimeInMillis();
+    while(!inVBlank(pNv, head) && (GetTimeInMillis() - start) <= period);
+}
+
+/* buffers */
+
+static void
+idleBuffers(ScrnInfoPtr pScrn, G80PortPrivPtr pPriv)
+{
+    int i;
+
+    for(i = 0; i < NUM_BUFFERS; i++) {
+        if(pPriv->fenced & (1 << i))
+            G80ExaWaitFence(pScrn, pPriv->fence[i]);
+    }
+
+    pPriv->currentBuffer = 0;
+    pPriv->fenced = 0;
+}
+
+static void
+freeBuffers(ScrnInfoPtr pScrn, G80PortPrivPtr pPriv)
+{
+    idleBuffers(pScrn, pPriv);
+
+    if(pPriv->area) {
+        exaOffscreenFree(pScrn->pScreen, pPriv->area);
+        pPriv->area = NULL;
+    }
+    pPriv->bufferSize = 0;
+    pPriv->videoStatus = 0;
+}
+
+void
+G80VideoFreeBuffers(ScrnInfoPtr pScrn)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+    int i;
+
+    if(!pNv->blitAdaptor)
+        return;
+
+    for(i = 0; i < NUM_PORTS; i++)
+        freeBuffers(pScrn, GET_PORT_PRIVATE(pNv, i));
+}
+
+static void
+G80VideoTimerCallback(ScrnInfoPtr pScrn, Time now)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+    Bool needCallback = FALSE;
+    int i;
+
+    if(!pScrn->vtSema) return;
+
+    for(i = 0; i < NUM_PORTS; i++) {
+        G80PortPrivPtr pPriv = GET_PORT_PRIVATE(pNv, i);
+
+        if(!pPriv->videoStatus)
+            continue;
+
+        if(pPriv->videoTime < now)
+            freeBuffers(pScrn, pPriv);
+        else
+            needCallback = TRUE;
+    }
+
+    pNv->VideoTimerCallback = needCallback ? G80VideoTimerCallback : NULL;
+}
+
+/* blit */
+
+static void
+blitImage(ScrnInfoPtr pScrn, G80PortPrivPtr pPriv, CARD32 offset, int pitch,
+          int width, int height, int left, int top, BoxPtr dstBox,
+          INT32 xa, INT32 ya, INT32 xb, INT32 yb, RegionPtr clipBoxes)
+{
+    G80Ptr pNv = G80PTR(pScrn);
+    BoxPtr pbox = REGION_RECTS(clipBoxes);
+    int nbox = REGION_NUM_RECTS(clipBoxes);
+    const int screenPitch = pScrn->displayWidth * (pScrn->bitsPerPixel >> 3);
+    CARD32 format[2], surface[5];
+    CARD64 dudx, dvdy;
+
+    /* source pixels per destination pixel in 32.32 fixed point */
+    dudx = ((CARD64)(xb - xa) << 16) / (dstBox->x2 - dstBox->x1);
+    dvdy = ((CARD64)(yb - ya) << 16) / (dstBox->y2 - dstBox->y1);
+
+    G80ExaSetDstSurface(pNv, pScrn->depth, screenPitch, pScrn->virtualX,
+                        pScrn->virtualY, 0);
+
+    format[0] = 0x000000e6; /* X8R8G8B8 */
+    format[1] = 0x00000001;
+    surface[0] = pitch;
+    surface[1] = width;
+    surface[2] = height;
+    surface[3] = 0x00000000;
+    surface[4] = offset;
+    G80DmaState(pNv, 0x230, format, 2);
+    G80DmaState(pNv, 0x244, surface, 5);
+    G80DmaState1(pNv, 0x2ac, 3); /* SRCCOPY */
+
+    if(pPriv->SyncToVBlank)
+        waitVBlank(pScrn, dstBox);
+
+    /* bilinear filtering */
+    G80DmaStart(pNv, 0x888, 1);
+    G80DmaNext (pNv, 0x10);
+
+    while(nbox--) {
+        CARD64 sx = ((CARD64)(xa - (left << 16)) << 16) +
+                    (pbox->x1 - dstBox->x1) * dudx;
+        CARD64 sy = ((CARD64)(ya - (top << 16)) << 16) +
+                    (pbox->y1 - dstBox->y1) * dvdy;
+
+        G80DmaStart(pNv, 0x110, 1);
+        G80DmaNext (pNv, 0);
+        G80DmaStart(pNv, 0x8b0, 12);
+        G80DmaNext (pNv, pbox->x1);
+        G80DmaNext (pNv, pbox->y1);
+        G80DmaNext (pNv, pbox->x2 - pbox->x1);
+        G80DmaNext (pNv, pbox->y2 - pbox->y1);
+        G80DmaNext (pNv, dudx);
+        G80DmaNext (pNv, dudx >> 32);
+        G80DmaNext (pNv, dvdy);
+        G80DmaNext (pNv, dvdy >> 32);
+        G80DmaNext (pNv, sx);
+        G80DmaNext (pNv, sx >> 32);
+        G80DmaNext (pNv, sy);
+        G80DmaNext (pNv, sy >> 32);
+        pbox++;
+    }
+
+    /* back to point sampling for EXA */
+    G80DmaStart(pNv, 0x888, 1);
+    G80DmaNext (pNv, 0);
+}
+
+static int
+G80PutImage(ScrnInfoPtr pScrn,
+            short src_x, short src_y,
+            short drw_x, short drw_y,
+            short src_w, short src_h,
+            short drw_w, short drw_h,
+            int id, unsigned char *buf,
+            short width, short height,
+            Bool Sync, RegionPtr clipBoxes,
+            pointer data, DrawablePtr pDraw)
+{
+    G80PortPrivPtr pPriv = (G80PortPrivPtr)data;
+    G80Ptr pNv = G80PTR(pScrn);
+    ScreenPtr pScreen = pScrn->pScreen;
+    INT32 xa, xb, ya, yb;
+    BoxRec dstBox;
+    int left, top, right, bottom, w, h, pitch, size, buffer;
+    int pitchY, pitchUV, offsetU, offsetV;
+    CARD32 offset;
+    CARD32 *dst;
+
+    xa = src_x << 16;
+    xb = (src_x + src_w) << 16;
+    ya = src_y << 16;
+    yb = (src_y + src_h) << 16;
+
+    dstBox.x1 = drw_x;
+    dstBox.x2 = drw_x + drw_w;
+    dstBox.y1 = drw_y;
+    dstBox.y2 = drw_y + drw_h;
+
+    if(!xf86XVClipVideoHelper(&dstBox, &xa, &xb, &ya, &yb, clipBoxes,
+                              width, height))
+        return Success;
+
+    /* Convert an extra pixel around the visible part so the filter
+       doesn't pick up junk from outside of it.  Chroma is shared by
+       pairs of pixels, so keep to even columns. */
+    left = (xa - 0x00010000) >> 16;
+    if(left < 0) left = 0;
+    top = (ya - 0x00010000) >> 16;
+    if(top < 0) top = 0;
+    right = (xb + 0x0001ffff) >> 16;
+    if(right > width) right = width;
+    bottom = (yb + 0x0001ffff) >> 16;
+    if(bottom > height) bottom = height;
+
+    if(id != FOURCC_RGB) {
+        left &= ~1;
+        right = min((right + 1) & ~1, width & ~1);
+    }
+
+    w = right - left;
+    h = bottom - top;
+    if(w <= 0 || h <= 0)
+        return Success;
+
+    pitch = (w * 4 + 255) & ~255;
+    size = pitch * h;
+
+    /* the buffers move when their size changes */
+    if(size != pPriv->bufferSize) {
+        idleBuffers(pScrn, pPriv);
+        pPriv->bufferSize = size;
+    }
+
+    if(!pPriv->area || pPriv->area->size < size * NUM_BUFFERS) {
+        if(pPriv->area)
+            exaOffscreenFree(pScreen, pPriv->area);
+        pPriv->area = exaOffscreenAlloc(pScreen, size * NUM_BUFFERS, 256,
+                                        TRUE, NULL, NULL);
+        if(!pPriv->area) {
+            pPriv->bufferSize = 0;
+            return BadAlloc;
+        }
+    }
+
+    buffer = pPriv->currentBuffer;
+    if(pPriv->fenced & (1 << buffer))
+        G80ExaWaitFence(pScrn, pPriv->fence[buffer]);
+
+    offset = pPriv->area->offset + (buffer * size);
+    dst = (CARD32*)(pNv->mem + offset);
+
+    switch(id) {
+    case FOURCC_YV12:
+    case FOURCC_I420:
+        pitchY = (width + 3) & ~3;
+        pitchUV = ((width >> 1) + 3) & ~3;
+        offsetV = pitchY * height;
+        offsetU = offsetV + (pitchUV * (height >> 1));
+        if(id == FOURCC_I420) {
+            int tmp = offsetU;
+            offsetU = offsetV;
+            offsetV = tmp;
+        }
+        convert420(dst, pitch, buf + left, buf + offsetU + (left >> 1),
+                   buf + offsetV + (left >> 1), pitchY, pitchUV, top, w, h);
+        break;
+    case FOURCC_UYVY:
+    case FOURCC_YUY2:
+        pitchY = width << 1;
+        convert422(dst, pitch, buf + (top * pitchY) + (left << 1), pitchY,
+                   (id == FOURCC_UYVY) ? 1 : 0, w, h);
+        break;
+    case FOURCC_RGB:
+        pitchY = width << 2;
+        copyRGB(dst, pitch, buf + (top * pitchY) + (left << 2), pitchY,
+                w, h);
+        break;
+    default:
+        return BadImplementation;
+    }
+
+    blitImage(pScrn, pPriv, offset, pitch, w, h, left, top, &dstBox,
+              xa, ya, xb, yb, clipBoxes);
+
+    pPriv->fence[buffer] = G80ExaEmitFence(pScrn);
+    pPriv->fenced |= 1 << buffer;
+    pPriv->currentBuffer = (buffer + 1) % NUM_BUFFERS;
+
+    G80DmaKickoff(pNv);
+    exaMarkSync(pScreen);
+
+    pPriv->videoStatus = FREE_TIMER;
+    pPriv->videoTime = currentTime.milliseconds + FREE_DELAY;
+    pNv->VideoTimerCallback = G80VideoTimerCallback;
+
+    return Success;
+}
+
+static void
+G80StopVideo(ScrnInfoPtr pScrn, pointer data, Bool Exit)
+{
+}
+
+static int
+G80SetPortAttribute(ScrnInfoPtr pScrn, Atom attribute, INT32 value,
+                    pointer data)
+{
+    G80PortPrivPtr pPriv = (G80PortPrivPtr)data;
+
+    if(attribute == xvSyncToVBlank) {
+        if((value < 0) || (value > 1))
+            return BadValue;
+        pPriv->SyncToVBlank = value;
+    } else
+    if(attribute == xvSetDefaults) {
+        pPriv->SyncToVBlank = FALSE;
+    } else
+        return BadMatch;
+
+    return Success;
+}
+
+static int
+G80GetPortAttribute(ScrnInfoPtr pScrn, Atom attribute, INT32 *value,
+                    pointer data)
+{
+    G80PortPrivPtr pPriv = (G80PortPrivPtr)data;
+
+    if(attribute == xvSyncToVBlank)
+        *value = pPriv->SyncToVBlank ? 1 : 0;
+    else
+        return BadMatch;
+
+    return Success;
+}
+
+static void
+G80QueryBestSize(ScrnInfoPtr pScrn, Bool motion,
+                 short vid_w, short vid_h, short drw_w, short drw_h,
+                 unsigned int *p_w, unsigned int *p_h, pointer data)
+{
+    if(vid_w > (drw_w << 3))
+        drw_w = vid_w >> 3;
+    if(vid_h > (drw_h << 3))
+        drw_h = vid_h >> 3;
+
+    *p_w = drw_w;
+    *p_h = drw_h;
+}
+
+static int
+G80QueryImageAttributes(ScrnInfoPtr pScrn, int id,
+                        unsigned short *w, unsigned short *h,
+                        int *pitches, int *offsets)
+{
+    int size, tmp;
+
+    if(*w > 4096)
+        *w = 4096;
+    if(*h > 4096)
+        *h = 4096;
+
+    *w = (*w + 1) & ~1;
+    if(offsets)
+        offsets[0] = 0;
+
+    switch(id) {
+    case FOURCC_YV12:
+    case FOURCC_I420:
+        *h = (*h + 1) & ~1;
+        size = (*w + 3) & ~3;
+        if(pitches)
+            pitches[0] = size;
+        size *= *h;
+        if(offsets)
+            offsets[1] = size;
+        tmp = ((*w >> 1) + 3) & ~3;
+        if(pitches)
+            pitches[1] = pitches[2] = tmp;
+        tmp *= (*h >> 1);
+        size += tmp;
+        if(offsets)
+            offsets[2] = size;
+        size += tmp;
+        break;
+    case FOURCC_UYVY:
+    case FOURCC_YUY2:
+        size = *w << 1;
+        if(pitches)
+            pitches[0] = size;
+        size *= *h;
+        break;
+    case FOURCC_RGB:
+        size = *w << 2;
+        if(pitches)
+            pitches[0] = size;
+        size *= *h;
+        break;
+    default:
+        *w = *h = size = 0;
+        break;
+    }
+
+    return size;
+}
+
+static XF86VideoAdaptorPtr
+G80SetupBlitVideo(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    G80Ptr pNv = G80PTR(pScrn);
+    XF86VideoAdaptorPtr adapt;
+    G80PortPrivPtr pPriv;
+    int i;
+
+    if(!(adapt = calloc(1, sizeof(XF86VideoAdaptorRec) +
+                           (sizeof(G80PortPrivRec) * NUM_PORTS) +
+                           (sizeof(DevUnion) * NUM_PORTS))))
+        return NULL;
+
+    adapt->type                 = XvWindowMask | XvInputMask | XvImageMask;
+    adapt->flags                = 0;
+    adapt->name                 = "G80 Video Blitter";
+    adapt->nEncodings           = 1;
+    adapt->pEncodings           = &DummyEncoding;
+    adapt->nFormats             = NUM_FORMATS;
+    adapt->pFormats             = G80Formats;
+    adapt->nPorts               = NUM_PORTS;
+    adapt->pPortPrivates        = (DevUnion*)(&adapt[1]);
+
+    pPriv = (G80PortPrivPtr)(&adapt->pPortPrivates[NUM_PORTS]);
+    for(i = 0; i < NUM_PORTS; i++)
+        adapt->pPortPrivates[i].ptr = (pointer)(&pPriv[i]);
+
+    adapt->pAttributes          = G80Attributes;
+    adapt->nAttributes          = NUM_ATTRIBUTES;
+    adapt->pImages              = G80Images;
+    adapt->nImages              = NUM_IMAGES;
+    adapt->PutVideo             = NULL;
+    adapt->PutStill             = NULL;
+    adapt->GetVideo             = NULL;
+    adapt->GetStill             = NULL;
+    adapt->StopVideo            = G80StopVideo;
+    adapt->SetPortAttribute     = G80SetPortAttribute;
+    adapt->GetPortAttribute     = G80GetPortAttribute;
+    adapt->QueryBestSize        = G80QueryBestSize;
+    adapt->PutImage             = G80PutImage;
+    adapt->QueryImageAttributes = G80QueryImageAttributes;
+
+    pNv->blitAdaptor            = adapt;
+
+    xvSetDefaults               = MAKE_ATOM("XV_SET_DEFAULTS");
+    xvSyncToVBlank              = MAKE_ATOM("XV_SYNC_TO_VBLANK");
+
+    return adapt;
+}
+
+void
+G80InitVideo(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    G80Ptr pNv = G80PTR(pScrn);
+    XF86VideoAdaptorPtr *adaptors, *newAdaptors = NULL;
+    XF86VideoAdaptorPtr blitAdaptor = NULL;
+    int num_adaptors;
+
+    if(pScrn->bitsPerPixel != 8 && pNv->exa)
+        blitAdaptor = G80SetupBlitVideo(pScreen);
+
+    initClampTab();
+
+    num_adaptors = xf86XVListGenericAdaptors(pScrn, &adaptors);
+
+    if(blitAdaptor) {
+        newAdaptors = malloc((num_adaptors + 1) * sizeof(XF86VideoAdaptorPtr));
+        if(newAdaptors) {
+            if(num_adaptors)
+                memcpy(newAdaptors, adaptors,
+                       num_adaptors * sizeof(XF86VideoAdaptorPtr));
+            newAdaptors[num_adaptors++] = blitAdaptor;
+            adaptors = newAdaptors;
+        }
+    }
+
+    if(num_adaptors)
+        xf86XVScreenInit(pScreen, adaptors, num_adaptors);
+
+    free(newAdaptors);
+}
@@ -0,0 +1,2 @@
+void G80InitVideo(ScreenPtr);
+void G80VideoFreeBuffers(ScrnInfoPtr);
@@ -59,11 +59,9 @@ G80DMAKickoffCallback(ScrnInfoPtr pScrn)
 void
 G80SetPattern(G80Ptr pNv, int bg, int fg, int pat0, int pat1)
 {
-    G80DmaStart(pNv, 0x2f0, 4);
-    G80DmaNext (pNv, bg);
-    G80DmaNext (pNv, fg);
-    G80DmaNext (pNv, pat0);
-    G80DmaNext (pNv, pat1);
+    const CARD32 pattern[4] = { bg, fg, pat0, pat1 };
+
+    G80DmaState(pNv, 0x2f0, pattern, 4);
 }
 
 void
@@ -95,14 +93,12 @@ G80SetRopSolid(G80Ptr pNv, CARD32 rop, CARD32 planemask)
     }
 }
 
-inline void
+void
 G80SetClip(G80Ptr pNv, int x, int y, int w, int h)
 {
-    G80DmaStart(pNv, 0x280, 4);
-    G80DmaNext (pNv, x);
-    G80DmaNext (pNv, y);
-    G80DmaNext (pNv, w);
-    G80DmaNext (pNv, h);
+    const CARD32 clip[4] = { x, y, w, h };
+
+    G80DmaState(pNv, 0x280, clip, 4);
 }
 
 #ifdef HAVE_XAA_H
@@ -122,11 +118,10 @@ G80SetupForScreenToScreenCopy(
     planemask |= ~0 << pScrn->depth;
 
     G80SetClip(pNv, 0, 0, 0x7fff, 0x7fff);
-    G80DmaStart(pNv, 0x2ac, 1);
     if(rop == GXcopy && planemask == ~0) {
-        G80DmaNext (pNv, 3);
+        G80DmaState1(pNv, 0x2ac, 3);
     } else {
-        G80DmaNext (pNv, 4);
+        G80DmaState1(pNv, 0x2ac, 4);
         G80SetRopSolid(pNv, rop, planemask);
     }
     pNv->DMAKickoffCallback = G80DMAKickoffCallback;
@@ -158,8 +153,7 @@ G80SubsequentScreenToScreenCopy(
     G80DmaNext (pNv, 0);
     G80DmaNext (pNv, y1);
 
-    if(w * h >= 512)
-        G80DmaKickoff(pNv);
+    G80DmaAutoKickoff(pNv, w * h);
 }
 
 /* Solid fills */
@@ -177,13 +171,10 @@ G80SetupForSolidFill(
     planemask |= ~0 << pScrn->depth;
 
     G80SetClip(pNv, 0, 0, 0x7fff, 0x7fff);
-    G80DmaStart(pNv, 0x2ac, 1);
-    G80DmaNext (pNv, 4);
+    G80DmaState1(pNv, 0x2ac, 4);
     G80SetRopSolid(pNv, rop, planemask);
-    G80DmaStart(pNv, 0x580, 1);
-    G80DmaNext (pNv, 4);
-    G80DmaStart(pNv, 0x588, 1);
-    G80DmaNext (pNv, color);
+    G80DmaState1(pNv, 0x580, 4);
+    G80DmaState1(pNv, 0x588, color);
 
     pNv->DMAKickoffCallback = G80DMAKickoffCallback;
 }
@@ -199,8 +190,7 @@ G80SubsequentFillRect(ScrnInfoPtr pScrn, int x, int y, int w, int h)
     G80DmaNext (pNv, x + w);
     G80DmaNext (pNv, y + h);
 
-    if(w * h >= 512)
-        G80DmaKickoff(pNv);
+    G80DmaAutoKickoff(pNv, w * h);
 }
 
 /* 8x8 pattern fills */
@@ -235,12 +225,9 @@ G80SetupForMono8x8PatternFill(
     G80SetClip(pNv, 0, 0, 0x7fff, 0x7fff);
     G80SetPattern(pNv, bg, fg, patternx, patterny);
 
-    G80DmaStart(pNv, 0x2ac, 1);
-    G80DmaNext (pNv, 4);
-    G80DmaStart(pNv, 0x580, 1);
-    G80DmaNext (pNv, 4);
-    G80DmaStart(pNv, 0x588, 1);
-    G80DmaNext (pNv, fg);
+    G80DmaState1(pNv, 0x2ac, 4);
+    G80DmaState1(pNv, 0x580, 4);
+    G80DmaState1(pNv, 0x588, fg);
 
     pNv->DMAKickoffCallback = G80DMAKickoffCallback;
 }
@@ -275,8 +262,7 @@ G80SetupForScanlineCPUToScreenColorExpandFill(
 
     planemask |= mask;
 
-    G80DmaStart(pNv, 0x2ac, 1);
-    G80DmaNext (pNv, 1);
+    G80DmaState1(pNv, 0x2ac, 1);
     G80SetRopSolid(pNv, rop, planemask);
     G80DmaStart(pNv, 0x800, 1);
     G80DmaNext (pNv, 1);
@@ -350,11 +336,10 @@ G80SetupForScanlineImageWrite(
 
     planemask |= ~0 << pScrn->depth;
 
-    G80DmaStart(pNv, 0x2ac, 1);
     if(rop == GXcopy && planemask == ~0) {
-        G80DmaNext (pNv, 3);
+        G80DmaState1(pNv, 0x2ac, 3);
     } else {
-        G80DmaNext (pNv, 4);
+        G80DmaState1(pNv, 0x2ac, 4);
         G80SetRopSolid(pNv, rop, planemask);
     }
 
@@ -412,6 +397,14 @@ static void G80SubsequentImageWriteScanline(ScrnInfoPtr pScrn, int bufno)
 
 /* Solid lines */
 
+/* Queue lines with the current state, up to 16 to a packet */
+static void
+G80DmaLines(G80Ptr pNv, int size)
+{
+    if(!G80DmaExtend(pNv, 0x400005e0, size, 16 * 2))
+        G80DmaOpen(pNv, 0x400005e0, size);
+}
+
 static void
 G80SetupForSolidLine(ScrnInfoPtr pScrn, int color, int rop, unsigned planemask)
 {
@@ -420,13 +413,10 @@ G80SetupForSolidLine(ScrnInfoPtr pScrn, int color, int rop, unsigned planemask)
     planemask |= ~0 << pScrn->depth;
 
     G80SetClip(pNv, 0, 0, 0x7fff, 0x7fff);
-    G80DmaStart(pNv, 0x2ac, 1);
-    G80DmaNext (pNv, 4);
+    G80DmaState1(pNv, 0x2ac, 4);
     G80SetRopSolid(pNv, rop, planemask);
-    G80DmaStart(pNv, 0x580, 1);
-    G80DmaNext (pNv, 1);
-    G80DmaStart(pNv, 0x588, 1);
-    G80DmaNext (pNv, color);
+    G80DmaState1(pNv, 0x580, 1);
+    G80DmaState1(pNv, 0x588, color);
 
     pNv->DMAKickoffCallback = G80DMAKickoffCallback;
 }
@@ -436,7 +426,7 @@ G80SubsequentSolidHorVertLine(ScrnInfoPtr pScrn, int x, int y, int len, int dir)
 {
     G80Ptr pNv = G80PTR(pScrn);
 
-    G80DmaStart(pNv, 0x400005e0, 2);
+    G80DmaLines(pNv, 2);
     G80DmaNext (pNv, (y << 16) | (x & 0xffff));
     if(dir == DEGREES_0) {
        G80DmaNext (pNv, (y << 16) | ((x + len) & 0xffff));
@@ -456,7 +446,7 @@ G80SubsequentSolidTwoPointLine(
     G80Ptr pNv = G80PTR(pScrn);
     Bool drawLast = !(flags & OMIT_LAST);
 
-    G80DmaStart(pNv, 0x400005e0, drawLast ? 4 : 2);
+    G80DmaLines(pNv, drawLast ? 4 : 2);
     G80DmaNext (pNv, (y1 << 16) | (x1 & 0xffff));
     G80DmaNext (pNv, (y2 << 16) | (x2 & 0xffff));
     if(drawLast) {
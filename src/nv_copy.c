@@ -0,0 +1,624 @@
+/*
+   Copyright (c) 1999,  The XFree86 Project Inc. 
+   Written by Mark Vojkovich <markv@valinux.com>
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "nv_copy.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/*
+ * Line copies.  The framebuffer is mapped write-combined, which only gets
+ * full bus bursts out of whole NV_COPY_BURST byte lines written front to
+ * back, so each line is copied with plain stores up to the first burst
+ * boundary and streamed from there on.
+ */
+
+#define BURST NV_COPY_BURST
+
+typedef void (*CopyLineProc)(uint8_t *dst, const uint8_t *src, int len);
+
+static void
+copyLine(uint8_t *dst, const uint8_t *src, int len)
+{
+    memcpy(dst, src, len);
+}
+
+#ifdef HAVE_SSE2
+__attribute__((target("sse2"))) static void
+copyLineSSE2(uint8_t *dst, const uint8_t *src, int len)
+{
+    int head = -(unsigned long)dst & (BURST - 1);
+
+    if(head >= len) {
+        memcpy(dst, src, len);
+        return;
+    }
+
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+
+    while(len >= BURST) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src +  0));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+
+        _mm_stream_si128((__m128i*)(dst +  0), a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+        dst += BURST;
+        src += BURST;
+        len -= BURST;
+    }
+
+    memcpy(dst, src, len);
+}
+
+__attribute__((target("sse2"))) static void
+copyFenceSSE2(void)
+{
+    _mm_sfence();
+}
+#endif
+
+static CopyLineProc copyLineProc = copyLine;
+
+void
+NVCopyLines(void *dstPtr, int dstPitch, const void *srcPtr, int srcPitch,
+            int len, int h)
+{
+    uint8_t *dst = dstPtr;
+    const uint8_t *src = srcPtr;
+
+    while(h--) {
+        (*copyLineProc)(dst, src, len);
+        dst += dstPitch;
+        src += srcPitch;
+    }
+}
+
+/* Orders the streaming stores of NVCopyLines before anything after it */
+void
+NVCopyFlush(void)
+{
+#ifdef HAVE_SSE2
+    if(copyLineProc == copyLineSSE2)
+        copyFenceSSE2();
+#endif
+}
+
+/*
+ * Xv image uploads.  Planar 4:2:0 is interleaved into packed 4:2:2 on
+ * the way, packed 4:2:2 and RGB are plain dword copies.
+ */
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define NV_COPY_BIG_ENDIAN 1
+#else
+#define NV_COPY_BIG_ENDIAN 0
+#endif
+
+static void copyData420
+(
+    unsigned char *src1,
+    unsigned char *src2,
+    unsigned char *src3,
+    unsigned char *dst1,
+    int            srcPitch,
+    int            srcPitch2,
+    int            dstPitch,
+    int            h,
+    int            w
+)
+{
+   uint32_t *dst;
+   uint8_t *s1, *s2, *s3;
+   int i, j;
+
+   w >>= 1;
+
+   for(j = 0; j < h; j++) {
+        dst = (uint32_t*)dst1;
+        s1 = src1;  s2 = src2;  s3 = src3;
+        i = w;
+        while(i > 4) {
+#if NV_COPY_BIG_ENDIAN
+           dst[0] = (s1[0] << 24) | (s1[1] << 8) | (s3[0] << 16) | s2[0];
+           dst[1] = (s1[2] << 24) | (s1[3] << 8) | (s3[1] << 16) | s2[1];
+           dst[2] = (s1[4] << 24) | (s1[5] << 8) | (s3[2] << 16) | s2[2];
+           dst[3] = (s1[6] << 24) | (s1[7] << 8) | (s3[3] << 16) | s2[3];
+#else
+           dst[0] = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
+           dst[1] = s1[2] | (s1[3] << 16) | (s3[1] << 8) | (s2[1] << 24);
+           dst[2] = s1[4] | (s1[5] << 16) | (s3[2] << 8) | (s2[2] << 24);
+           dst[3] = s1[6] | (s1[7] << 16) | (s3[3] << 8) | (s2[3] << 24);
+#endif
+           dst += 4; s2 += 4; s3 += 4; s1 += 8;
+           i -= 4;
+        }
+
+        while(i--) {
+#if NV_COPY_BIG_ENDIAN
+           dst[0] = (s1[0] << 24) | (s1[1] << 8) | (s3[0] << 16) | s2[0];
+#else
+           dst[0] = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
+#endif
+           dst++; s2++; s3++;
+           s1 += 2;
+        }
+
+        dst1 += dstPitch;
+        src1 += srcPitch;
+        if(j & 1) {
+            src2 += srcPitch2;
+            src3 += srcPitch2;
+        }
+   }
+}
+
+
+static void moveDWORDS(
+   uint32_t* dest,
+   uint32_t* src,
+   int dwords )
+{
+     while(dwords & ~0x03) {
+        *dest = *src;
+        *(dest + 1) = *(src + 1);
+        *(dest + 2) = *(src + 2);
+        *(dest + 3) = *(src + 3);
+        src += 4;
+        dest += 4;
+        dwords -= 4;
+     }
+     if(!dwords) return;
+     *dest = *src;
+     if(dwords == 1) return;
+     *(dest + 1) = *(src + 1);
+     if(dwords == 2) return;
+     *(dest + 2) = *(src + 2);
+}
+
+#if NV_COPY_BIG_ENDIAN
+static void moveDWORDSSwapped(
+   uint32_t* dest,
+   uint8_t* src,
+   int dwords )
+{
+     while(dwords--) {
+        *dest++ = (src[3] << 24) | (src[2] << 16) | (src[1] << 8) | src[0];
+        src += 4;
+     }
+}
+#endif
+
+/*
+ * SSE2 versions of the above.  The destination is the video memory
+ * aperture, so the stores are lined up on 16 bytes and kept in address
+ * order for the write-combining buffers.  The sources are plain client
+ * memory with no particular alignment.
+ */
+#ifdef HAVE_SSE2
+__attribute__((target("sse2"))) static void copyData420SSE2
+(
+    unsigned char *src1,
+    unsigned char *src2,
+    unsigned char *src3,
+    unsigned char *dst1,
+    int            srcPitch,
+    int            srcPitch2,
+    int            dstPitch,
+    int            h,
+    int            w
+)
+{
+   uint32_t *dst;
+   uint8_t *s1, *s2, *s3;
+   int i, j;
+
+   w >>= 1;
+
+   for(j = 0; j < h; j++) {
+        dst = (uint32_t*)dst1;
+        s1 = src1;  s2 = src2;  s3 = src3;
+        i = w;
+
+        while(i && ((unsigned long)dst & 15)) {
+           *dst++ = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
+           s2++; s3++;
+           s1 += 2;
+           i--;
+        }
+
+        while(i >= 16) {
+           __m128i y0 = _mm_loadu_si128((__m128i*)s1);
+           __m128i y1 = _mm_loadu_si128((__m128i*)(s1 + 16));
+           __m128i u = _mm_loadu_si128((__m128i*)s2);
+           __m128i v = _mm_loadu_si128((__m128i*)s3);
+           __m128i c0 = _mm_unpacklo_epi8(v, u);
+           __m128i c1 = _mm_unpackhi_epi8(v, u);
+
+           _mm_store_si128((__m128i*)dst,       _mm_unpacklo_epi8(y0, c0));
+           _mm_store_si128((__m128i*)(dst + 4), _mm_unpackhi_epi8(y0, c0));
+           _mm_store_si128((__m128i*)(dst + 8), _mm_unpacklo_epi8(y1, c1));
+           _mm_store_si128((__m128i*)(dst + 12), _mm_unpackhi_epi8(y1, c1));
+           dst += 16; s2 += 16; s3 += 16; s1 += 32;
+           i -= 16;
+        }
+
+        while(i--) {
+           *dst++ = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
+           s2++; s3++;
+           s1 += 2;
+        }
+
+        dst1 += dstPitch;
+        src1 += srcPitch;
+        if(j & 1) {
+            src2 += srcPitch2;
+            src3 += srcPitch2;
+        }
+   }
+}
+
+__attribute__((target("sse2"))) static void moveDWORDSSSE2(
+   uint32_t* dest,
+   uint32_t* src,
+   int dwords )
+{
+     while(dwords && ((unsigned long)dest & 15)) {
+        *dest++ = *src++;
+        dwords--;
+     }
+     while(dwords >= 16) {
+        __m128i a = _mm_loadu_si128((__m128i*)src);
+        __m128i b = _mm_loadu_si128((__m128i*)(src + 4));
+        __m128i c = _mm_loadu_si128((__m128i*)(src + 8));
+        __m128i d = _mm_loadu_si128((__m128i*)(src + 12));
+
+        _mm_store_si128((__m128i*)dest, a);
+        _mm_store_si128((__m128i*)(dest + 4), b);
+        _mm_store_si128((__m128i*)(dest + 8), c);
+        _mm_store_si128((__m128i*)(dest + 12), d);
+        src += 16;
+        dest += 16;
+        dwords -= 16;
+     }
+     while(dwords >= 4) {
+        _mm_store_si128((__m128i*)dest, _mm_loadu_si128((__m128i*)src));
+        src += 4;
+        dest += 4;
+        dwords -= 4;
+     }
+     while(dwords--)
+        *dest++ = *src++;
+}
+#endif
+
+typedef void (*CopyData420Proc)(unsigned char *, unsigned char *,
+                                unsigned char *, unsigned char *,
+                                int, int, int, int, int);
+typedef void (*MoveDWORDSProc)(uint32_t *, uint32_t *, int);
+
+static CopyData420Proc copyData420Proc = copyData420;
+static MoveDWORDSProc moveDWORDSProc = moveDWORDS;
+
+void NVCopyData420
+(
+    unsigned char *src1,
+    unsigned char *src2,
+    unsigned char *src3,
+    unsigned char *dst1,
+    int            srcPitch,
+    int            srcPitch2,
+    int            dstPitch,
+    int            h,
+    int            w
+)
+{
+    (*copyData420Proc)(src1, src2, src3, dst1, srcPitch, srcPitch2,
+                       dstPitch, h, w);
+}
+
+void NVCopyData422
+(
+  unsigned char *src,
+  unsigned char *dst,
+  int            srcPitch,
+  int            dstPitch,
+  int            h,
+  int            w
+)
+{
+    w >>= 1;  /* pixels to DWORDS */
+    while(h--) {
+        (*moveDWORDSProc)((uint32_t*)dst, (uint32_t*)src, w);
+        src += srcPitch;
+        dst += dstPitch;
+    }
+}
+
+void NVCopyDataRGB
+(
+  unsigned char *src,
+  unsigned char *dst,
+  int            srcPitch,
+  int            dstPitch,
+  int            h,
+  int            w
+)
+{
+    while(h--) {
+#if NV_COPY_BIG_ENDIAN
+        moveDWORDSSwapped((uint32_t*)dst, (uint8_t*)src, w);
+#else
+        (*moveDWORDSProc)((uint32_t*)dst, (uint32_t*)src, w);
+#endif
+        src += srcPitch;
+        dst += dstPitch;
+    }
+}
+
+/*
+ * Rotation.  Row r of the output is column r of the shadow, so walking a
+ * whole column per output row touches a new cache line, and often a new
+ * page, for every pixel.  The boxes are done in TILE x TILE blocks
+ * instead: the shadow lines of a block stay in cache while its output
+ * rows go out as contiguous runs.
+ *
+ * The kernels write "rows" output rows of "count" pixels, with row r
+ * taking its pixels from src + r * step, spaced srcPitch apart.  Pitches
+ * are in pixels.  The 8 and 16 bit ones write whole dwords, so count is a
+ * multiple of 4 or 2 pixels there.
+ */
+
+#define TILE NV_COPY_TILE
+
+typedef void (*RotateProc)(void *dst, int dstPitch, const void *src,
+                           int srcPitch, int step, int rows, int count);
+
+static void
+rotateBlock8(void *dst, int dstPitch, const void *src, int srcPitch,
+             int step, int rows, int count)
+{
+    int r, j;
+
+    for(r = 0; r < rows; r++) {
+        const uint8_t *s = (const uint8_t*)src + r * step;
+        uint32_t *d = (uint32_t*)((uint8_t*)dst + r * dstPitch);
+
+        for(j = 0; j < count; j += 4) {
+            *(d++) = s[0] | (s[srcPitch] << 8) |
+                     (s[srcPitch * 2] << 16) | (s[srcPitch * 3] << 24);
+            s += srcPitch * 4;
+        }
+    }
+}
+
+static void
+rotateBlock16(void *dst, int dstPitch, const void *src, int srcPitch,
+              int step, int rows, int count)
+{
+    int r, j;
+
+    for(r = 0; r < rows; r++) {
+        const uint16_t *s = (const uint16_t*)src + r * step;
+        uint32_t *d = (uint32_t*)((uint16_t*)dst + r * dstPitch);
+
+        for(j = 0; j < count; j += 2) {
+            *(d++) = s[0] | (s[srcPitch] << 16);
+            s += srcPitch * 2;
+        }
+    }
+}
+
+static void
+rotateBlock32(void *dst, int dstPitch, const void *src, int srcPitch,
+              int step, int rows, int count)
+{
+    int r, j;
+
+    for(r = 0; r < rows; r++) {
+        const uint32_t *s = (const uint32_t*)src + r * step;
+        uint32_t *d = (uint32_t*)dst + r * dstPitch;
+
+        for(j = 0; j < count; j++) {
+            *(d++) = *s;
+            s += srcPitch;
+        }
+    }
+}
+
+#ifdef HAVE_SSE2
+/*
+ * TILE x TILE transposes.  Each vector loaded holds the pixels of n
+ * consecutive output rows for one output column, and log2(n) rounds of
+ * interleaving the first half of the vectors with the second half turn
+ * those into n output rows.  With a negative step the pixels come out of
+ * memory in reverse and get swapped around first.  These always do a
+ * whole tile; rows and count are only there to match RotateProc.
+ */
+#define TRANSPOSE(a, n, lo, hi) {                       \
+    __m128i _t[n];                                      \
+    int _k, _m;                                         \
+    for(_m = n; _m > 1; _m >>= 1) {                     \
+        for(_k = 0; _k < (n) / 2; _k++) {               \
+            _t[2 * _k]     = lo(a[_k], a[_k + (n) / 2]); \
+            _t[2 * _k + 1] = hi(a[_k], a[_k + (n) / 2]); \
+        }                                               \
+        for(_k = 0; _k < (n); _k++)                     \
+            a[_k] = _t[_k];                             \
+    }                                                   \
+}
+
+__attribute__((target("sse2"))) static void
+rotateTile8SSE2(void *dst, int dstPitch, const void *src, int srcPitch,
+                int step, int rows, int count)
+{
+    const uint8_t *s = (const uint8_t*)src - ((step < 0) ? 15 : 0);
+    uint8_t *d = dst;
+    __m128i a[16];
+    int k;
+
+    (void)rows;
+    (void)count;
+
+    for(k = 0; k < 16; k++) {
+        a[k] = _mm_loadu_si128((const __m128i*)(s + k * srcPitch));
+        if(step < 0) {
+            a[k] = _mm_shuffle_epi32(a[k], _MM_SHUFFLE(0, 1, 2, 3));
+            a[k] = _mm_shufflelo_epi16(a[k], _MM_SHUFFLE(2, 3, 0, 1));
+            a[k] = _mm_shufflehi_epi16(a[k], _MM_SHUFFLE(2, 3, 0, 1));
+            a[k] = _mm_or_si128(_mm_slli_epi16(a[k], 8),
+                                _mm_srli_epi16(a[k], 8));
+        }
+    }
+    TRANSPOSE(a, 16, _mm_unpacklo_epi8, _mm_unpackhi_epi8);
+    for(k = 0; k < 16; k++)
+        _mm_storeu_si128((__m128i*)(d + k * dstPitch), a[k]);
+}
+
+__attribute__((target("sse2"))) static void
+rotateTile16SSE2(void *dst, int dstPitch, const void *src, int srcPitch,
+                 int step, int rows, int count)
+{
+    int r, j, k;
+
+    (void)rows;
+    (void)count;
+
+    for(r = 0; r < TILE; r += 8) {
+        for(j = 0; j < TILE; j += 8) {
+            const uint16_t *s = (const uint16_t*)src + (r * step) +
+                              (j * srcPitch) - ((step < 0) ? 7 : 0);
+            uint16_t *d = (uint16_t*)dst + (r * dstPitch) + j;
+            __m128i a[8];
+
+            for(k = 0; k < 8; k++) {
+                a[k] = _mm_loadu_si128((const __m128i*)(s + k * srcPitch));
+                if(step < 0) {
+                    a[k] = _mm_shuffle_epi32(a[k], _MM_SHUFFLE(1, 0, 3, 2));
+                    a[k] = _mm_shufflelo_epi16(a[k], _MM_SHUFFLE(0, 1, 2, 3));
+                    a[k] = _mm_shufflehi_epi16(a[k], _MM_SHUFFLE(0, 1, 2, 3));
+                }
+            }
+            TRANSPOSE(a, 8, _mm_unpacklo_epi16, _mm_unpackhi_epi16);
+            for(k = 0; k < 8; k++)
+                _mm_storeu_si128((__m128i*)(d + k * dstPitch), a[k]);
+        }
+    }
+}
+
+__attribute__((target("sse2"))) static void
+rotateTile32SSE2(void *dst, int dstPitch, const void *src, int srcPitch,
+                 int step, int rows, int count)
+{
+    int r, j, k;
+
+    (void)rows;
+    (void)count;
+
+    for(r = 0; r < TILE; r += 4) {
+        for(j = 0; j < TILE; j += 4) {
+            const uint32_t *s = (const uint32_t*)src + (r * step) +
+                              (j * srcPitch) - ((step < 0) ? 3 : 0);
+            uint32_t *d = (uint32_t*)dst + (r * dstPitch) + j;
+            __m128i a[4];
+
+            for(k = 0; k < 4; k++) {
+                a[k] = _mm_loadu_si128((const __m128i*)(s + k * srcPitch));
+                if(step < 0)
+                    a[k] = _mm_shuffle_epi32(a[k], _MM_SHUFFLE(0, 1, 2, 3));
+            }
+            TRANSPOSE(a, 4, _mm_unpacklo_epi32, _mm_unpackhi_epi32);
+            for(k = 0; k < 4; k++)
+                _mm_storeu_si128((__m128i*)(d + k * dstPitch), a[k]);
+        }
+    }
+}
+#endif
+
+static RotateProc rotateTile8 = rotateBlock8;
+static RotateProc rotateTile16 = rotateBlock16;
+static RotateProc rotateTile32 = rotateBlock32;
+
+/* Picks the kernels for this CPU, or the plain C ones if simd is 0 */
+void
+NVCopyInit(int simd)
+{
+    copyLineProc = copyLine;
+    copyData420Proc = copyData420;
+    moveDWORDSProc = moveDWORDS;
+    rotateTile8 = rotateBlock8;
+    rotateTile16 = rotateBlock16;
+    rotateTile32 = rotateBlock32;
+
+#ifdef HAVE_SSE2
+    if(simd && __builtin_cpu_supports("sse2")) {
+        copyLineProc = copyLineSSE2;
+        copyData420Proc = copyData420SSE2;
+        moveDWORDSProc = moveDWORDSSSE2;
+        rotateTile8 = rotateTile8SSE2;
+        rotateTile16 = rotateTile16SSE2;
+        rotateTile32 = rotateTile32SSE2;
+    }
+#endif
+}
+
+/*
+ * Rotates a whole box, see the top of this section.  Pitches and step are
+ * in pixels of Bpp bytes.
+ */
+void
+NVCopyRotate(int Bpp, void *dstPtr, int dstPitch, const void *srcPtr,
+             int srcPitch, int step, int rows, int count)
+{
+    uint8_t *dst = dstPtr;
+    const uint8_t *src = srcPtr;
+    RotateProc tile, block;
+    int i, j, h, w;
+
+    switch(Bpp) {
+    case 1:
+        tile = rotateTile8;
+        block = rotateBlock8;
+        break;
+    case 2:
+        tile = rotateTile16;
+        block = rotateBlock16;
+        break;
+    default:
+        tile = rotateTile32;
+        block = rotateBlock32;
+        break;
+    }
+
+    for(i = 0; i < rows; i += TILE) {
+        h = MIN(TILE, rows - i);
+        for(j = 0; j < count; j += TILE) {
+            uint8_t *d = dst + ((i * dstPitch) + j) * Bpp;
+            const uint8_t *s = src + ((i * step) + (j * srcPitch)) * Bpp;
+
+            w = MIN(TILE, count - j);
+            if((h == TILE) && (w == TILE))
+                (*tile)(d, dstPitch, s, srcPitch, step, TILE, TILE);
+            else
+                (*block)(d, dstPitch, s, srcPitch, step, h, w);
+        }
+    }
+}
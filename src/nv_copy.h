@@ -0,0 +1,32 @@
+#ifndef __NV_COPY_H__
+#define __NV_COPY_H__
+
+/*
+ * CPU copy loops in nv_copy.c for the shadow framebuffer refresh and Xv
+ * image uploads.  They only deal with plain pointers, so they work the
+ * same on any memory standing in for the framebuffer.
+ */
+
+/* line copies stream whole write-combining bursts of this many bytes */
+#define NV_COPY_BURST 64
+
+/* rotations are done in square tiles of this many pixels */
+#define NV_COPY_TILE 16
+
+void NVCopyInit(int simd);
+void NVCopyLines(void *dst, int dstPitch, const void *src, int srcPitch,
+                 int len, int h);
+void NVCopyFlush(void);
+void NVCopyRotate(int Bpp, void *dst, int dstPitch, const void *src,
+                  int srcPitch, int step, int rows, int count);
+
+/* w is in pixels, h in lines */
+void NVCopyData420(unsigned char *src1, unsigned char *src2,
+                   unsigned char *src3, unsigned char *dst1, int srcPitch,
+                   int srcPitch2, int dstPitch, int h, int w);
+void NVCopyData422(unsigned char *src, unsigned char *dst, int srcPitch,
+                   int dstPitch, int h, int w);
+void NVCopyDataRGB(unsigned char *src, unsigned char *dst, int srcPitch,
+                   int dstPitch, int h, int w);
+
+#endif /* __NV_COPY_H__ */
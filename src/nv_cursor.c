@@ -29,14 +29,14 @@
 
 #include "cursorstr.h"
 
+#include "nv_mono.h"
+
 /****************************************************************************\
 *                                                                            *
 *                          HW Cursor Entrypoints                             *
 *                                                                            *
 \****************************************************************************/
 
-#define TRANSPARENT_PIXEL   0
-
 #define ConvertToRGB555(c) \
 (((c & 0xf80000) >> 9 ) | ((c & 0xf800) >> 6 ) | ((c & 0xf8) >> 3 ) | 0x8000)
 
@@ -49,99 +49,188 @@
 
 
 static void 
-ConvertCursor1555(NVPtr pNv, CARD32 *src, CARD16 *dst)
+ConvertCursor1555(NVPtr pNv, CARD32 *src, volatile U032 *dst)
 {
-    CARD32 b, m;
+    union {
+        CARD16 pixels[32];
+        CARD32 dwords[16];
+    } line;
     int i, j;
     
     for ( i = 0; i < 32; i++ ) {
-        b = *src++;
-        m = *src++;
-        for ( j = 0; j < 32; j++ ) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-            if ( m & 0x80000000)
-                *dst = ( b & 0x80000000) ? pNv->curFg : pNv->curBg;
-            else
-                *dst = TRANSPARENT_PIXEL;
-            b <<= 1;
-            m <<= 1;
-#else
-            if ( m & 1 )
-                *dst = ( b & 1) ? pNv->curFg : pNv->curBg;
-            else
-                *dst = TRANSPARENT_PIXEL;
-            b >>= 1;
-            m >>= 1;
-#endif
-            dst++;
-        }
+        NVMonoExpand16(src[0], src[1], pNv->curFg, pNv->curBg, line.pixels);
+        src += 2;
+        for ( j = 0; j < 16; j++ )
+            *dst++ = line.dwords[j];
     }
 }
 
 
 static void
-ConvertCursor8888(NVPtr pNv, CARD32 *src, CARD32 *dst)
+ConvertCursor8888(NVPtr pNv, CARD32 *src, volatile U032 *dst)
 {
-    CARD32 b, m;
+    CARD32 line[32];
     int i, j;
    
     for ( i = 0; i < 128; i++ ) {
-        b = *src++;
-        m = *src++;
-        for ( j = 0; j < 32; j++ ) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-            if ( m & 0x80000000)
-                *dst = ( b & 0x80000000) ? pNv->curFg : pNv->curBg;
-            else
-                *dst = TRANSPARENT_PIXEL;
-            b <<= 1;
-            m <<= 1;
-#else
-            if ( m & 1 )
-                *dst = ( b & 1) ? pNv->curFg : pNv->curBg;
-            else
-                *dst = TRANSPARENT_PIXEL;
-            b >>= 1;
-            m >>= 1;
-#endif
-            dst++;
-        }
+        NVMonoExpand(src[0], src[1], pNv->curFg, pNv->curBg, line);
+        src += 2;
+        for ( j = 0; j < 32; j++ )
+            *dst++ = line[j];
     }
 }
 
 
-static void
-TransformCursor (NVPtr pNv)
+/*
+ * Cursor image cache.  Toolkits keep switching between a handful of
+ * shapes, so each image converted into video memory stays in one of
+ * curSlots slots, keyed by a hash of what it was made from.  Showing a
+ * cached image only moves the CRTC's cursor address.  Chips that keep
+ * the cursor in PRAMIN have a single slot.
+ *
+ * Animated cursors are loaded one frame at a time by the server.  Any
+ * image that arrives within ANIM_INTERVAL of the previous one is taken to
+ * be a frame, including a toolkit switching shapes quickly, and fills
+ * curFrames slots of their own in turn, skipping the one on screen.  So
+ * after the first round a spinner only moves the cursor address and can't
+ * push the everyday shapes out of the cache; a shape mistaken for a frame
+ * merely gets a frame slot.
+ *
+ * An animation longer than curFrames would miss on every frame if the
+ * ring kept turning over.  Once more frames than that have missed in a
+ * row, the ring stops turning: the frames already in it stay, and the
+ * rest stream through its last ANIM_STREAM slots until the next pause.
+ */
+#define ANIM_INTERVAL 250  /* milliseconds */
+#define ANIM_STREAM   3
+
+static CARD64
+hashCursor(const CARD32 *src, int dwords, CARD64 seed)
 {
-    CARD32 *tmp;
-    int i, dwords;
+    CARD64 h = seed;
 
-    /* convert to color cursor */
-    if(pNv->alphaCursor) {
-       dwords = 64 * 64;
-       if(!(tmp = calloc(1, dwords * 4))) return;
-       ConvertCursor8888(pNv, pNv->curImage, tmp);
-    } else {
-       dwords = (32 * 32) >> 1;
-       if(!(tmp = calloc(1, dwords * 4))) return;
-       ConvertCursor1555(pNv, pNv->curImage, (CARD16*)tmp);
+    while(dwords--) {
+        h = (h + *src++) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
     }
 
-    for(i = 0; i < dwords; i++)
-        pNv->CURSOR[i] = tmp[i];
+    return h ? h : 1;
+}
+
+/*
+ * Returns the slot holding the image for key, or FALSE and the slot to
+ * load it into.  That is the next frame slot for animations, and the
+ * least recently shown shape slot otherwise.  Neither is the one on
+ * screen.
+ */
+static Bool
+lookupCursor(NVPtr pNv, CARD64 key, int *slot)
+{
+    const CARD32 now = GetTimeInMillis();
+    const Bool frame = (now - pNv->curLoadTime) < ANIM_INTERVAL;
+    int i;
+
+    pNv->curLoadTime = now;
+    if(!frame)
+        pNv->curFrameMisses = 0;
+
+    for(i = 0; i < pNv->curSlots + pNv->curFrames; i++) {
+        if(pNv->curKey[i] == key) {
+            *slot = i;
+            pNv->statCursorHits++;
+            return TRUE;
+        }
+    }
+
+    pNv->statCursorMisses++;
+
+    if(frame && (pNv->curFrames > 1)) {
+        int first = 0;
+
+        if(++pNv->curFrameMisses > pNv->curFrames)
+            first = max(pNv->curFrames - ANIM_STREAM, 0);
+        if(pNv->curFrameNext < first)
+            pNv->curFrameNext = first;
+        do {
+            *slot = pNv->curSlots + pNv->curFrameNext;
+            if(++pNv->curFrameNext == pNv->curFrames)
+                pNv->curFrameNext = first;
+        } while(*slot == pNv->curSlot);
+        pNv->statCursorFrames++;
+        return FALSE;
+    }
+
+    *slot = 0;
+    for(i = 1; i < pNv->curSlots; i++) {
+        if(pNv->curStamp[i] < pNv->curStamp[*slot])
+            *slot = i;
+    }
 
-    free(tmp);
+    return FALSE;
+}
+
+/* Slot 0 is CursorStart, the others and the frames are below the fence. */
+static CARD32
+slotOffset(NVPtr pNv, int slot)
+{
+    if(slot == 0)
+        return pNv->CursorStart;
+    return pNv->CursorCacheStart + (slot - 1) * NV_CURSOR_SLOT_SIZE;
+}
+
+static volatile U032 *
+slotPtr(NVPtr pNv, int slot)
+{
+    if(slot == 0)
+        return pNv->CURSOR;
+    return (volatile U032 *)(pNv->FbStart + slotOffset(pNv, slot));
 }
 
 static void
-NVLoadCursorImage( ScrnInfoPtr pScrn, unsigned char *src )
+showCursorSlot(NVPtr pNv, int slot, CARD64 key)
+{
+    pNv->curKey[slot] = key;
+    pNv->curStamp[slot] = ++pNv->curClock;
+
+    if(slot == pNv->curSlot)
+        return;
+
+    pNv->curSlot = slot;
+    pNv->CursorOffset = slotOffset(pNv, slot);
+    NVSetCursorStart(pNv, pNv->CursorOffset);
+}
+
+/* The cursor memory may have been scribbled on while we were away. */
+void
+NVCursorInvalidate(ScrnInfoPtr pScrn)
 {
     NVPtr pNv = NVPTR(pScrn);
 
-    /* save copy of image for color changes */
-    memcpy(pNv->curImage, src, (pNv->alphaCursor) ? 1024 : 256);
+    memset(pNv->curKey, 0, sizeof(pNv->curKey));
+}
+
+static void
+TransformCursor (NVPtr pNv)
+{
+    volatile U032 *dst;
+    CARD64 key;
+    int slot;
+
+    key = hashCursor(pNv->curImage, pNv->alphaCursor ? 256 : 64,
+                     ((CARD64)pNv->curFg << 32) | pNv->curBg);
+    if(lookupCursor(pNv, key, &slot)) {
+        showCursorSlot(pNv, slot, key);
+        return;
+    }
+
+    /* convert to color cursor */
+    dst = slotPtr(pNv, slot);
+    if(pNv->alphaCursor)
+       ConvertCursor8888(pNv, pNv->curImage, dst);
+    else
+       ConvertCursor1555(pNv, pNv->curImage, dst);
 
-    TransformCursor(pNv);
+    showCursorSlot(pNv, slot, key);
 }
 
 static void
@@ -224,13 +313,22 @@ NVLoadCursorARGB(ScrnInfoPtr pScrn, CursorPtr pCurs)
 {
     NVPtr pNv = NVPTR(pScrn);
     CARD32 *image = pCurs->bits->argb;
-    CARD32 *dst = (CARD32*)pNv->CURSOR;
+    CARD32 *dst;
     CARD32 alpha, tmp;
-    int x, y, w, h;
+    CARD64 key;
+    int x, y, w, h, slot;
 
     w = pCurs->bits->width;
     h = pCurs->bits->height;
 
+    key = hashCursor(image, w * h, ~(((CARD64)w << 32) | h));
+    if(lookupCursor(pNv, key, &slot)) {
+        showCursorSlot(pNv, slot, key);
+        return;
+    }
+
+    dst = (CARD32*)slotPtr(pNv, slot);
+
     if((pNv->Chipset & 0x0ff0) == 0x0110) {  /* premultiply */
        for(y = 0; y < h; y++) {
           for(x = 0; x < w; x++) {
@@ -264,6 +362,8 @@ NVLoadCursorARGB(ScrnInfoPtr pScrn, CursorPtr pCurs)
 
     if(y < 64)
       memset(dst, 0, 64 * (64 - y) * 4);
+
+    showCursorSlot(pNv, slot, key);
 }
 #endif
 
@@ -279,6 +379,21 @@ NVCursorInit(ScreenPtr pScreen)
     
     pNv->CursorInfoRec = infoPtr;
 
+    NVMonoInit();
+
+    /* the extra slots need the cursor to be in the framebuffer */
+    if(pNv->Architecture >= NV_ARCH_10) {
+        pNv->curSlots = NV_CURSOR_SLOTS;
+        pNv->curFrames = NV_CURSOR_FRAMES;
+    } else {
+        pNv->curSlots = 1;
+        pNv->curFrames = 0;
+    }
+    pNv->curFrameNext = 0;
+    pNv->curFrameMisses = 0;
+    pNv->curSlot = 0;
+    NVCursorInvalidate(pScrn);
+
     if(pNv->alphaCursor)
        infoPtr->MaxWidth = infoPtr->MaxHeight = 64;
     else
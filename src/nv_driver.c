@@ -29,6 +29,7 @@
    <jpaana@s2.org> */
 
 #include "nv_include.h"
+#include "nv_shadow.h"
 
 #include "xf86int10.h"
 #include "vbeModes.h"
@@ -646,6 +647,11 @@ typedef enum {
     OPTION_FP_SCALE,
     OPTION_FP_TWEAK,
     OPTION_DUALHEAD,
+    OPTION_ACCEL_METHOD,
+    OPTION_SHADOW_PACING,
+    OPTION_SHADOW_THREADS,
+    OPTION_SHADOW_HASH,
+    OPTION_VIDEO_FREE_DELAY,
 } NVOpts;
 
 
@@ -663,6 +669,11 @@ static const OptionInfoRec NVOptions[] = {
     { OPTION_FP_SCALE,          "FPScale",      OPTV_BOOLEAN,   {0}, FALSE },
     { OPTION_FP_TWEAK,          "FPTweak",      OPTV_INTEGER,   {0}, FALSE },
     { OPTION_DUALHEAD,          "DualHead",     OPTV_BOOLEAN,   {0}, FALSE },
+    { OPTION_ACCEL_METHOD,      "AccelMethod",  OPTV_STRING,    {0}, FALSE },
+    { OPTION_SHADOW_PACING,     "ShadowPacing", OPTV_BOOLEAN,   {0}, FALSE },
+    { OPTION_SHADOW_THREADS,    "ShadowThreads", OPTV_INTEGER,  {0}, FALSE },
+    { OPTION_SHADOW_HASH,       "ShadowHash",   OPTV_BOOLEAN,   {0}, FALSE },
+    { OPTION_VIDEO_FREE_DELAY,  "VideoFreeDelay", OPTV_INTEGER, {0}, FALSE },
     { -1,                       NULL,           OPTV_NONE,      {0}, FALSE }
 };
 
@@ -1055,6 +1066,7 @@ NVSwitchMode(SWITCH_MODE_ARGS_DECL)
     SCRN_INFO_PTR(arg);
 
     NVSync(pScrn);
+    NVShadowHashInvalidate(pScrn);
     return NVModeInit(pScrn, mode);
 }
 
@@ -1069,6 +1081,7 @@ NVSwitchModeVBE(SWITCH_MODE_ARGS_DECL)
 	pScrn->EnableDisableFBAccess(XF86_SCRN_ARG(pScrn), FALSE);
 
     NVSync(pScrn);
+    NVShadowHashInvalidate(pScrn);
     if (!NVSetModeVBE(pScrn, mode))
         return FALSE;
     NVAdjustFrame(ADJUST_FRAME_ARGS(pScrn, pScrn->frameX0, pScrn->frameY0));
@@ -1111,6 +1124,8 @@ NVEnterVT(VT_FUNC_ARGS_DECL)
     SCRN_INFO_PTR(arg);
     NVPtr pNv = NVPTR(pScrn);
 
+    NVShadowHashInvalidate(pScrn);
+    NVCursorInvalidate(pScrn);
     if (!NVModeInit(pScrn, pScrn->currentMode))
         return FALSE;
     NVAdjustFrame(ADJUST_FRAME_ARGS(pScrn, pScrn->frameX0, pScrn->frameY0));
@@ -1133,6 +1148,8 @@ NVEnterVTVBE(VT_FUNC_ARGS_DECL)
 {
     SCRN_INFO_PTR(arg);
 
+    NVShadowHashInvalidate(pScrn);
+    NVCursorInvalidate(pScrn);
     if (!NVSetModeVBE(pScrn, pScrn->currentMode))
         return FALSE;
     NVAdjustFrame(ADJUST_FRAME_ARGS(pScrn, 0, 0));
@@ -1181,6 +1198,9 @@ NVBlockHandler (BLOCKHANDLER_ARGS_DECL)
     (*pScreen->BlockHandler) (BLOCKHANDLER_ARGS);
     pScreen->BlockHandler = NVBlockHandler;
 
+    if (pNv->ShadowPacing)
+        NVShadowFlush(pScrnInfo, pTimeout);
+
     if (pNv->VideoTimerCallback) 
         (*pNv->VideoTimerCallback)(pScrnInfo, currentTime.milliseconds);
 
@@ -1213,14 +1233,53 @@ NVCloseScreen(CLOSE_SCREEN_ARGS_DECL)
         }
     }
 
+    if (!pNv->NoAccel)
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                       "Pushbuffer: %u kickoffs, %lu dwords; %u over the dword "
+                       "budget, %u over the pixel budget, %u on idle\n",
+                       (unsigned)pNv->statKickoffs, pNv->statDwords,
+                       (unsigned)pNv->statKickoffDwords,
+                       (unsigned)pNv->statKickoffPixels,
+                       (unsigned)pNv->statKickoffIdle);
+    if (pNv->ShadowTileHash) {
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                       "Shadow tiles: %lu unchanged, %lu copied\n",
+                       pNv->statTileHits, pNv->statTileMisses);
+        NVShadowHashFini(pScrn);
+    }
+    if (pNv->overlayAdaptor || pNv->blitAdaptor)
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                       "Video memory: %lu allocations, %lu grown in place, "
+                       "%lu reused, %lu evictions, %lu released\n",
+                       pNv->statVideoAllocs, pNv->statVideoGrows,
+                       pNv->statVideoReuses, pNv->statVideoPurges,
+                       pNv->statVideoReleases);
+    if (pNv->CursorInfoRec)
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 5,
+                       "Cursor images: %lu cached, %lu loaded, "
+                       "%lu as animation frames\n",
+                       pNv->statCursorHits, pNv->statCursorMisses,
+                       pNv->statCursorFrames);
+
     NVUnmapMem(pScrn);
     vgaHWUnmapMem(pScrn);
 #ifdef HAVE_XAA_H
     if (pNv->AccelInfoRec)
         XAADestroyInfoRec(pNv->AccelInfoRec);
 #endif
+    if (pNv->exa) {
+        exaDriverFini(pScreen);
+        free(pNv->exa);
+        pNv->exa = NULL;
+    }
     if (pNv->CursorInfoRec)
         xf86DestroyCursorInfoRec(pNv->CursorInfoRec);
+    if (pNv->ShadowPacing)
+        REGION_UNINIT(pScreen, &pNv->ShadowDamage);
+    if (pNv->ShadowPool) {
+        NVShadowPoolDestroy(pNv->ShadowPool);
+        pNv->ShadowPool = NULL;
+    }
     if (pNv->ShadowPtr)
         free(pNv->ShadowPtr);
     if (pNv->DGAModes)
@@ -1587,6 +1646,20 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
 	pNv->NoAccel = TRUE;
 	xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "Acceleration disabled\n");
     }
+#ifdef HAVE_XAA_H
+    pNv->AccelMethod = XAA;
+#else
+    pNv->AccelMethod = EXA;
+#endif
+    if ((s = xf86GetOptValString(pNv->Options, OPTION_ACCEL_METHOD))) {
+	if (!xf86NameCmp(s, "XAA"))
+	    pNv->AccelMethod = XAA;
+	else if (!xf86NameCmp(s, "EXA"))
+	    pNv->AccelMethod = EXA;
+	else
+	    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+		"Unrecognized AccelMethod \"%s\"\n", s);
+    }
     if (xf86ReturnOptValBool(pNv->Options, OPTION_SHADOW_FB, FALSE)) {
 	pNv->ShadowFB = TRUE;
 	pNv->NoAccel = TRUE;
@@ -1656,6 +1729,38 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
       }
     }
 
+    if (xf86ReturnOptValBool(pNv->Options, OPTION_SHADOW_PACING, FALSE)) {
+	if (pNv->ShadowFB) {
+	    pNv->ShadowPacing = TRUE;
+	    xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+		"Shadow framebuffer updates paced to the refresh rate\n");
+	} else
+	    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+		"Option \"ShadowPacing\" requires the shadow framebuffer\n");
+    }
+
+    if (xf86GetOptValInteger(pNv->Options, OPTION_SHADOW_THREADS,
+                             &pNv->ShadowThreads)) {
+	if (pNv->ShadowThreads < 0)
+	    pNv->ShadowThreads = 0;
+	if (pNv->ShadowThreads > 16)
+	    pNv->ShadowThreads = 16;
+	xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+	    "Using %d worker threads for the rotated shadow framebuffer\n",
+	    pNv->ShadowThreads);
+    }
+
+    if (xf86ReturnOptValBool(pNv->Options, OPTION_SHADOW_HASH, FALSE)) {
+	if (pNv->ShadowFB && !pNv->FBDev && !pNv->Rotate) {
+	    pNv->ShadowHash = TRUE;
+	    xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+		"Skipping unchanged tiles of the shadow framebuffer\n");
+	} else
+	    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+		"Option \"ShadowHash\" requires the unrotated shadow "
+		"framebuffer without UseFBDev\n");
+    }
+
     if(xf86GetOptValInteger(pNv->Options, OPTION_VIDEO_KEY, &(pNv->videoKey))) {
         xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "video key set to 0x%x\n",
                                 pNv->videoKey);
@@ -1665,6 +1770,16 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
         (((pScrn->mask.blue >> pScrn->offset.blue) - 1) << pScrn->offset.blue); 
     }
 
+    pNv->videoFreeDelay = 5000; /* milliseconds */
+    if (xf86GetOptValInteger(pNv->Options, OPTION_VIDEO_FREE_DELAY,
+                             &pNv->videoFreeDelay)) {
+	if (pNv->videoFreeDelay < 0)
+	    pNv->videoFreeDelay = 0;
+	xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+	    "Releasing idle video memory after %d ms\n",
+	    pNv->videoFreeDelay);
+    }
+
     if (xf86GetOptValBool(pNv->Options, OPTION_FLAT_PANEL, &(pNv->FlatPanel))) {
         xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "forcing %s usage\n",
                    pNv->FlatPanel ? "DFP" : "CRTC");
@@ -1879,8 +1994,17 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
     else
        pNv->FbUsableSize = pNv->FbMapSize - (128 * 1024);
     pNv->ScratchBufferSize = (pNv->Architecture < NV_ARCH_10) ? 8192 : 16384;
-    pNv->ScratchBufferStart = pNv->FbUsableSize - pNv->ScratchBufferSize;
+    pNv->FenceStart = pNv->FbUsableSize - 256;
+    /* the cursor image cache goes below the fence, the space past
+       CursorStart belongs to PRAMIN */
+    pNv->CursorCacheStart = pNv->FenceStart;
+    if(pNv->Architecture >= NV_ARCH_10)
+       pNv->CursorCacheStart = (pNv->FenceStart -
+                  (NV_CURSOR_SLOTS - 1 + NV_CURSOR_FRAMES) *
+                  NV_CURSOR_SLOT_SIZE) & ~2047;
+    pNv->ScratchBufferStart = pNv->CursorCacheStart - pNv->ScratchBufferSize;
     pNv->CursorStart = pNv->FbUsableSize + (32 * 1024);
+    pNv->CursorOffset = pNv->CursorStart;
 
     /*
      * Setup the ClockRanges, which describe what clock ranges are available,
@@ -2046,9 +2170,10 @@ NVPreInit(ScrnInfoPtr pScrn, int flags)
 	return FALSE;
     }
 
-    /* Load XAA if needed */
+    /* Load XAA or EXA if needed */
     if (!pNv->NoAccel) {
-	if (!xf86LoadSubModule(pScrn, "xaa")) {
+	if (!xf86LoadSubModule(pScrn,
+			       (pNv->AccelMethod == EXA) ? "exa" : "xaa")) {
 	    xf86DrvMsg(pScrn->scrnIndex, X_INFO, "Falling back to shadwwfb\n");
 	    pNv->NoAccel = 1;
 	    pNv->ShadowFB = 1;
@@ -2269,6 +2394,9 @@ NVRestore(ScrnInfoPtr pScrn)
         VGA_WR08(pNv->PCIO, 0x03D5, nvReg->crtcOwner);
     }
     vgaHWProtect(pScrn, FALSE);
+
+    /* the console owns the hardware now; reload everything next time */
+    pNv->LoadedRegValid = FALSE;
 }
 
 static void NVBacklightEnable(NVPtr pNv,  Bool on)
@@ -2541,14 +2669,25 @@ NVScreenInit(SCREEN_INIT_ARGS_DECL)
     if(offscreenHeight > 32767)
         offscreenHeight = 32767;
 
-    AvailFBArea.x1 = 0;
-    AvailFBArea.y1 = 0;
-    AvailFBArea.x2 = pScrn->displayWidth;
-    AvailFBArea.y2 = offscreenHeight;
-    xf86InitFBManager(pScreen, &AvailFBArea);
+    /* EXA manages the offscreen memory itself */
+    if (pNv->NoAccel || (pNv->AccelMethod != EXA)) {
+	AvailFBArea.x1 = 0;
+	AvailFBArea.y1 = 0;
+	AvailFBArea.x2 = pScrn->displayWidth;
+	AvailFBArea.y2 = offscreenHeight;
+	xf86InitFBManager(pScreen, &AvailFBArea);
+    }
     
-    if (!pNv->NoAccel)
-	NVAccelInit(pScreen);
+    if (!pNv->NoAccel) {
+	if (pNv->AccelMethod == EXA) {
+	    if (!NVExaInit(pScreen)) {
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+		    "EXA hardware acceleration initialization failed\n");
+		return FALSE;
+	    }
+	} else
+	    NVAccelInit(pScreen);
+    }
     
     xf86SetBackingStore(pScreen);
     xf86SetSilkenMouse(pScreen);
@@ -2579,6 +2718,8 @@ NVScreenInit(SCREEN_INIT_ARGS_DECL)
     if(pNv->ShadowFB) {
 	RefreshAreaFuncPtr refreshArea = NVRefreshArea;
 
+	NVShadowInit();
+
 	if(pNv->Rotate || pNv->RandRRotation) {
 	   pNv->PointerMoved = pScrn->PointerMoved;
 	   if(pNv->Rotate)
@@ -2594,6 +2735,25 @@ NVScreenInit(SCREEN_INIT_ARGS_DECL)
                xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                           "Driver rotation enabled, RandR disabled\n");
            }
+
+	   if(pNv->ShadowThreads)
+	       pNv->ShadowPool = NVShadowPoolCreate(pNv->ShadowThreads);
+	   if(pNv->ShadowPool) {
+	       pNv->ShadowThreadedRefresh = refreshArea;
+	       refreshArea = NVRefreshThreaded;
+	   } else if(pNv->ShadowThreads)
+	       xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+	                  "Failed to start the shadow framebuffer threads\n");
+	}
+
+	if(pNv->ShadowHash && !NVShadowHashInit(pScrn))
+	    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+	               "Failed to allocate the shadow tile hashes\n");
+
+	if(pNv->ShadowPacing) {
+	    pNv->ShadowRefresh = refreshArea;
+	    REGION_NULL(pScreen, &pNv->ShadowDamage);
+	    refreshArea = NVRefreshAccumulate;
 	}
 
 	ShadowFBInit(pScreen, refreshArea);
@@ -2694,6 +2854,9 @@ NVRandRSetConfig(ScrnInfoPtr pScrn, xorgRRConfig *config)
 {
     NVPtr pNv = NVPTR(pScrn);
 
+    /* the rotated refresh doesn't keep the tile hashes */
+    NVShadowHashInvalidate(pScrn);
+
     switch(config->rotation) {
         case RR_Rotate_0:
             pNv->Rotate = 0;
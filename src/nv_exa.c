@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2003 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "nv_include.h"
+#include "nv_dma.h"
+
+/* Reuses a fence the caller has just emitted, if there is one */
+static int
+markSync(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+    CARD32 fence = pNv->markFence;
+
+    if(fence) {
+        pNv->markFence = 0;
+        return fence;
+    }
+
+    return NVEmitFence(pScrn);
+}
+
+static void
+waitMarker(ScreenPtr pScreen, int marker)
+{
+    NVWaitFence(xf86ScreenToScrn(pScreen), marker);
+}
+
+/* The 2D objects all render through the one context surface, which only
+   knows the screen's format, so we can only accelerate pixmaps that look
+   like the screen. */
+static Bool
+checkPixmap(NVPtr pNv, PixmapPtr pPix)
+{
+    if(pPix->drawable.bitsPerPixel != pNv->CurrentLayout.bitsPerPixel)
+        return FALSE;
+    if(pPix->drawable.depth != pNv->CurrentLayout.depth)
+        return FALSE;
+    return TRUE;
+}
+
+static void
+setSurfaces(NVPtr pNv,
+            CARD32 srcPitch, CARD32 srcOffset,
+            CARD32 dstPitch, CARD32 dstOffset)
+{
+    NVDmaStart(pNv, SURFACE_PITCH, 3);
+    NVDmaNext (pNv, (dstPitch << 16) | srcPitch);
+    NVDmaNext (pNv, srcOffset);
+    NVDmaNext (pNv, dstOffset);
+}
+
+/* solid fills */
+
+static Bool
+prepareSolid(PixmapPtr      pPixmap,
+             int            alu,
+             Pixel          planemask,
+             Pixel          fg)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+    CARD32 pitch, offset;
+
+    if(!checkPixmap(pNv, pPixmap)) return FALSE;
+
+    pitch = exaGetPixmapPitch(pPixmap);
+    offset = exaGetPixmapOffset(pPixmap);
+    setSurfaces(pNv, pitch, offset, pitch, offset);
+
+    planemask |= ~0 << pNv->CurrentLayout.depth;
+    NVSetRopSolid(pScrn, alu, planemask);
+    NVDmaStart(pNv, RECT_SOLID_COLOR, 1);
+    NVDmaNext (pNv, fg);
+
+    pNv->DMAKickoffCallback = NVDMAKickoffCallback;
+    return TRUE;
+}
+
+static void
+solid(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+    int w = x2 - x1, h = y2 - y1;
+
+    NVDmaSolidRect(pNv, x1, y1, w, h);
+
+    NVDmaAutoKickoff(pNv, w * h);
+}
+
+static void
+doneSolid(PixmapPtr pPixmap)
+{
+}
+
+/* screen to screen copies */
+
+static Bool
+prepareCopy(PixmapPtr       pSrcPixmap,
+            PixmapPtr       pDstPixmap,
+            int             dx,
+            int             dy,
+            int             alu,
+            Pixel           planemask)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDstPixmap->drawable.pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+
+    if(!checkPixmap(pNv, pSrcPixmap)) return FALSE;
+    if(!checkPixmap(pNv, pDstPixmap)) return FALSE;
+
+    setSurfaces(pNv,
+                exaGetPixmapPitch(pSrcPixmap), exaGetPixmapOffset(pSrcPixmap),
+                exaGetPixmapPitch(pDstPixmap), exaGetPixmapOffset(pDstPixmap));
+
+    planemask |= ~0 << pNv->CurrentLayout.depth;
+    NVSetRopSolid(pScrn, alu, planemask);
+
+    pNv->DMAKickoffCallback = NVDMAKickoffCallback;
+    return TRUE;
+}
+
+static void
+copy(PixmapPtr pDstPixmap,
+     int       srcX,
+     int       srcY,
+     int       dstX,
+     int       dstY,
+     int       width,
+     int       height)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDstPixmap->drawable.pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+
+    NVDmaStart(pNv, BLIT_POINT_SRC, 3);
+    NVDmaNext (pNv, (srcY << 16) | srcX);
+    NVDmaNext (pNv, (dstY << 16) | dstX);
+    NVDmaNext (pNv, (height << 16) | width);
+
+    NVDmaAutoKickoff(pNv, width * height);
+}
+
+static void
+doneCopy(PixmapPtr pDstPixmap)
+{
+}
+
+/* upload to screen */
+
+/*
+ * The data is staged in the scratch area and blitted into place.  The
+ * scratch area is split in two halves so the CPU can fill one of them
+ * while the engine is still copying out of the other.
+ */
+static Bool
+upload(PixmapPtr pDst,
+       int       x,
+       int       y,
+       int       w,
+       int       h,
+       char      *src,
+       int       src_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+    const int Bpp = pDst->drawable.bitsPerPixel >> 3;
+    const int line_len = w * Bpp;
+    const int pitch = (line_len + 63) & ~63;
+    const int lines = (pNv->ScratchBufferSize >> 1) / pitch;
+    CARD32 fence[2];
+    int half = 0, chunk = 0;
+
+    if(lines < 1) return FALSE;
+    if(!checkPixmap(pNv, pDst)) return FALSE;
+
+    /* an earlier upload may still be reading the scratch area */
+    NVWaitFence(pScrn, pNv->scratchFence);
+
+    NVSetRopSolid(pScrn, GXcopy, ~0);
+
+    while(h > 0) {
+        int n = (h > lines) ? lines : h;
+        unsigned char *dst = pNv->FbStart + pNv->ScratchBufferStart +
+                             (half * lines * pitch);
+        int i;
+
+        /* The FIFO having fetched the blit out of this half doesn't mean
+           the engine is done reading it, so wait for its fence. */
+        if(chunk >= 2)
+            NVWaitFence(pScrn, fence[half]);
+
+        for(i = 0; i < n; i++) {
+            memcpy(dst, src, line_len);
+            dst += pitch;
+            src += src_pitch;
+        }
+
+        /* the fence below points the surfaces back at the screen */
+        setSurfaces(pNv, pitch, pNv->ScratchBufferStart,
+                    exaGetPixmapPitch(pDst), exaGetPixmapOffset(pDst));
+        NVDmaStart(pNv, BLIT_POINT_SRC, 3);
+        NVDmaNext (pNv, (half * lines) << 16);
+        NVDmaNext (pNv, (y << 16) | x);
+        NVDmaNext (pNv, (n << 16) | w);
+        fence[half] = NVEmitFence(pScrn);
+        NVDmaKickoff(pNv);
+
+        pNv->scratchFence = fence[half];
+        y += n;
+        h -= n;
+        half ^= 1;
+        chunk++;
+    }
+
+    return TRUE;
+}
+
+/* download from screen */
+
+/*
+ * Staging through the scratch area would not buy anything here since it
+ * lives in the same uncached aperture as the pixmap, so just fence what
+ * has been queued so far and read the pixels directly once it lands.
+ */
+static Bool
+download(PixmapPtr pSrc,
+         int       x,
+         int       y,
+         int       w,
+         int       h,
+         char      *dst,
+         int       dst_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pSrc->drawable.pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+    const int Bpp = pSrc->drawable.bitsPerPixel >> 3;
+    const int pitch = exaGetPixmapPitch(pSrc);
+    unsigned char *src;
+
+    src = pNv->FbStart + exaGetPixmapOffset(pSrc) + (y * pitch) + (x * Bpp);
+
+    NVWaitFence(pScrn, NVEmitFence(pScrn));
+
+    while(h--) {
+        memcpy(dst, src, w * Bpp);
+        src += pitch;
+        dst += dst_pitch;
+    }
+
+    return TRUE;
+}
+
+/******************************************************************************/
+
+Bool
+NVExaInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    NVPtr pNv = NVPTR(pScrn);
+    ExaDriverPtr exa;
+    const int pitch = pScrn->displayWidth * (pScrn->bitsPerPixel >> 3);
+
+    exa = pNv->exa = exaDriverAlloc();
+    if(!exa) return FALSE;
+
+    exa->exa_major         = EXA_VERSION_MAJOR;
+    exa->exa_minor         = EXA_VERSION_MINOR;
+    exa->memoryBase        = pNv->FbStart;
+    exa->offScreenBase     = pitch * pScrn->virtualY;
+    exa->memorySize        = pNv->ScratchBufferStart;
+    exa->pixmapOffsetAlign = 256;
+    exa->pixmapPitchAlign  = 64;
+    exa->flags             = EXA_OFFSCREEN_PIXMAPS;
+    if(pNv->Architecture < NV_ARCH_10) {
+        exa->maxX          = 2048;
+        exa->maxY          = 2048;
+    } else {
+        exa->maxX          = 4096;
+        exa->maxY          = 4096;
+    }
+
+    /**** Rendering ops ****/
+    exa->PrepareSolid       = prepareSolid;
+    exa->Solid              = solid;
+    exa->DoneSolid          = doneSolid;
+    exa->PrepareCopy        = prepareCopy;
+    exa->Copy               = copy;
+    exa->DoneCopy           = doneCopy;
+    exa->UploadToScreen     = upload;
+    exa->DownloadFromScreen = download;
+
+    exa->MarkSync           = markSync;
+    exa->WaitMarker         = waitMarker;
+
+    return exaDriverInit(pScreen, exa);
+}
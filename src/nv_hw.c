@@ -28,6 +28,7 @@
 #include "nv_local.h"
 #include "compiler.h"
 #include "nv_include.h"
+#include "nv_pll.h"
 
 
 void NVLockUnlock (
@@ -67,6 +68,31 @@ int NVShowHideCursor (
     return (current & 0x01);
 }
 
+/* Point the CRTC at another cursor image in video memory. */
+void NVSetCursorStart (
+    NVPtr  pNv,
+    CARD32 offset
+)
+{
+    RIVA_HW_STATE *state = pNv->CurrentState;
+
+    state->cursor0 = 0x80 | (offset >> 17);
+    state->cursor1 = (state->cursor1 & 0x03) | ((offset >> 11) << 2);
+    state->cursor2 = offset >> 24;
+
+    VGA_WR08(pNv->PCIO, 0x3D4, 0x30);
+    VGA_WR08(pNv->PCIO, 0x3D5, state->cursor0);
+    VGA_WR08(pNv->PCIO, 0x3D4, 0x31);
+    VGA_WR08(pNv->PCIO, 0x3D5, state->cursor1);
+    VGA_WR08(pNv->PCIO, 0x3D4, 0x2F);
+    VGA_WR08(pNv->PCIO, 0x3D5, state->cursor2);
+
+    if(pNv->Architecture == NV_ARCH_40) {  /* HW bug */
+       volatile CARD32 curpos = pNv->PRAMDAC[0x0300/4];
+       pNv->PRAMDAC[0x0300/4] = curpos;
+    }
+}
+
 /****************************************************************************\
 *                                                                            *
 * The video arbitration routines calculate some "magic" numbers.  Fixes      *
@@ -753,42 +779,28 @@ static void CalcVClock (
     NVPtr        pNv
 )
 {
-    unsigned lowM, highM;
-    unsigned DeltaNew, DeltaOld;
-    unsigned VClk, Freq;
-    unsigned M, N, P;
-    
-    DeltaOld = 0xFFFFFFFF;
+    NVPllLimits limits = { 0 };
+    NVPllCoeffs pll;
 
-    VClk = (unsigned)clockIn;
-    
+    limits.refclk = pNv->CrystalFreqKHz;
     if (pNv->CrystalFreqKHz == 13500) {
-        lowM  = 7;
-        highM = 13;
+        limits.minM1 = 7;
+        limits.maxM1 = 13;
     } else {
-        lowM  = 8;
-        highM = 14;
+        limits.minM1 = 8;
+        limits.maxM1 = 14;
     }
+    limits.minN1 = 1;
+    limits.maxN1 = 255;
+    limits.log2P = 1;
 
-    for (P = 0; P <= 4; P++) {
-        Freq = VClk << P;
-        if ((Freq >= 128000) && (Freq <= 350000)) {
-            for (M = lowM; M <= highM; M++) {
-                N = ((VClk << P) * M) / pNv->CrystalFreqKHz;
-                if(N <= 255) {
-                    Freq = ((pNv->CrystalFreqKHz * N) / M) >> P;
-                    if (Freq > VClk)
-                        DeltaNew = Freq - VClk;
-                    else
-                        DeltaNew = VClk - Freq;
-                    if (DeltaNew < DeltaOld) {
-                        *pllOut   = (P << 16) | (N << 8) | M;
-                        *clockOut = Freq;
-                        DeltaOld  = DeltaNew;
-                    }
-                }
-            }
-        }
+    if (!NVPllPostRange(clockIn, 128000, 350000, 0, 4,
+                        &limits.lowP, &limits.highP))
+        return;
+
+    if (NVPllSolve(&limits, clockIn, &pll)) {
+        *pllOut   = (pll.p << 16) | (pll.n1 << 8) | pll.m1;
+        *clockOut = pll.clock;
     }
 }
 
@@ -800,35 +812,25 @@ static void CalcVClock2Stage (
     NVPtr        pNv
 )
 {
-    unsigned DeltaNew, DeltaOld;
-    unsigned VClk, Freq;
-    unsigned M, N, P;
-
-    DeltaOld = 0xFFFFFFFF;
+    NVPllLimits limits = { 0 };
+    NVPllCoeffs pll;
 
     *pllBOut = 0x80000401;  /* fixed at x4 for now */
 
-    VClk = (unsigned)clockIn;
-
-    for (P = 0; P <= 6; P++) {
-        Freq = VClk << P;
-        if ((Freq >= 400000) && (Freq <= 1000000)) {
-            for (M = 1; M <= 13; M++) {
-                N = ((VClk << P) * M) / (pNv->CrystalFreqKHz << 2);
-                if((N >= 5) && (N <= 255)) {
-                    Freq = (((pNv->CrystalFreqKHz << 2) * N) / M) >> P;
-                    if (Freq > VClk)
-                        DeltaNew = Freq - VClk;
-                    else
-                        DeltaNew = VClk - Freq;
-                    if (DeltaNew < DeltaOld) {
-                        *pllOut   = (P << 16) | (N << 8) | M;
-                        *clockOut = Freq;
-                        DeltaOld  = DeltaNew;
-                    }
-                }
-            }
-        }
+    limits.refclk = pNv->CrystalFreqKHz << 2;
+    limits.minM1 = 1;
+    limits.maxM1 = 13;
+    limits.minN1 = 5;
+    limits.maxN1 = 255;
+    limits.log2P = 1;
+
+    if (!NVPllPostRange(clockIn, 400000, 1000000, 0, 6,
+                        &limits.lowP, &limits.highP))
+        return;
+
+    if (NVPllSolve(&limits, clockIn, &pll)) {
+        *pllOut   = (pll.p << 16) | (pll.n1 << 8) | pll.m1;
+        *clockOut = pll.clock;
     }
 }
 
@@ -915,9 +917,9 @@ void NVCalcStateExt (
                                          &(state->arbitration0),
                                          &(state->arbitration1));
             }
-            state->cursor0  = 0x80 | (pNv->CursorStart >> 17);
-            state->cursor1  = (pNv->CursorStart >> 11) << 2;
-	    state->cursor2  = pNv->CursorStart >> 24;
+            state->cursor0  = 0x80 | (pNv->CursorOffset >> 17);
+            state->cursor1  = (pNv->CursorOffset >> 11) << 2;
+	    state->cursor2  = pNv->CursorOffset >> 24;
 	    if (flags & V_DBLSCAN) 
 		state->cursor1 |= 2;
             state->pllsel   = 0x10000700;
@@ -935,11 +937,44 @@ void NVCalcStateExt (
 }
 
 
+/* NVStateHW access to the mapped registers */
+static volatile U032 *
+stateAperture(NVPtr pNv, int aperture)
+{
+    switch(aperture) {
+    case NV_STATE_PCRTC:   return pNv->PCRTC;
+    case NV_STATE_PRAMDAC: return pNv->PRAMDAC;
+    default:               return pNv->PRAMDAC0;
+    }
+}
+
+static uint32_t
+stateRead(void *priv, int aperture, int offset)
+{
+    return stateAperture(priv, aperture)[offset/4];
+}
+
+static void
+stateWrite(void *priv, int aperture, int offset, uint32_t value)
+{
+    stateAperture(priv, aperture)[offset/4] = value;
+}
+
+static void
+stateWriteCR(void *priv, int index, uint8_t value)
+{
+    NVPtr pNv = priv;
+
+    VGA_WR08(pNv->PCIO, 0x03D4, index);
+    VGA_WR08(pNv->PCIO, 0x03D5, value);
+}
+
 void NVLoadStateExt (
     NVPtr pNv,
     RIVA_HW_STATE *state
 )
 {
+    NVStateHW hw;
     int i, j;
 
     pNv->PMC[0x0140/4] = 0x00000000;
@@ -1420,6 +1455,7 @@ void NVLoadStateExt (
 
     if(!state) {
         pNv->CurrentState = NULL;
+        pNv->LoadedRegValid = FALSE;
         return;
     }
 
@@ -1437,84 +1473,26 @@ void NVLoadStateExt (
         pNv->PMC[0x8908/4] = pNv->FbMapSize - 1;
         pNv->PMC[0x890C/4] = pNv->FbMapSize - 1;
         pNv->PMC[0x1588/4] = 0;
-
-        pNv->PCRTC[0x0810/4] = state->cursorConfig;
-        pNv->PCRTC[0x0830/4] = state->displayV - 3;
-        pNv->PCRTC[0x0834/4] = state->displayV - 1;
-    
-        if(pNv->FlatPanel) {
-           if((pNv->Chipset & 0x0ff0) == 0x0110) {
-               pNv->PRAMDAC[0x0528/4] = state->dither;
-           } else 
-           if(pNv->twoHeads) {
-               pNv->PRAMDAC[0x083C/4] = state->dither;
-           }
-    
-           VGA_WR08(pNv->PCIO, 0x03D4, 0x53);
-           VGA_WR08(pNv->PCIO, 0x03D5, state->timingH);
-           VGA_WR08(pNv->PCIO, 0x03D4, 0x54);
-           VGA_WR08(pNv->PCIO, 0x03D5, state->timingV);
-           VGA_WR08(pNv->PCIO, 0x03D4, 0x21);
-           VGA_WR08(pNv->PCIO, 0x03D5, 0xfa);
-        }
-
-        VGA_WR08(pNv->PCIO, 0x03D4, 0x41);
-        VGA_WR08(pNv->PCIO, 0x03D5, state->extra);
-    }
-
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x19);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->repaint0);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x1A);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->repaint1);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x25);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->screen);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x28);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->pixel);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x2D);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->horiz);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x1C);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->fifo);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x1B);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->arbitration0);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x20);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->arbitration1);
-    if(pNv->Architecture >= NV_ARCH_30) {
-      VGA_WR08(pNv->PCIO, 0x03D4, 0x47);
-      VGA_WR08(pNv->PCIO, 0x03D5, state->arbitration1 >> 8);
     }
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x30);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->cursor0);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x31);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->cursor1);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x2F);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->cursor2);
-    VGA_WR08(pNv->PCIO, 0x03D4, 0x39);
-    VGA_WR08(pNv->PCIO, 0x03D5, state->interlace);
-
-    if(!pNv->FlatPanel) {
-       if(pNv->Architecture >= NV_ARCH_40) {
-           pNv->PRAMDAC0[0x0580/4] = state->control;
-       }
 
-       pNv->PRAMDAC0[0x050C/4] = state->pllsel;
-       pNv->PRAMDAC0[0x0508/4] = state->vpll;
-       if(pNv->twoHeads)
-          pNv->PRAMDAC0[0x0520/4] = state->vpll2;
-       if(pNv->twoStagePLL) {
-          pNv->PRAMDAC0[0x0578/4] = state->vpllB;
-          pNv->PRAMDAC0[0x057C/4] = state->vpll2B;
-       }
-    } else {
-       pNv->PRAMDAC[0x0848/4] = state->scale;
-       pNv->PRAMDAC[0x0828/4] = state->crtcSync;
-       pNv->PRAMDAC[0x0808/4] = state->crtcVSync;
-    }
-    pNv->PRAMDAC[0x0600/4] = state->general;
+    /* the CRTC and RAMDAC registers only where they changed */
+    hw.architecture = pNv->Architecture;
+    hw.chipset = pNv->Chipset;
+    hw.flatPanel = pNv->FlatPanel;
+    hw.twoHeads = pNv->twoHeads;
+    hw.twoStagePLL = pNv->twoStagePLL;
+    hw.priv = pNv;
+    hw.read = stateRead;
+    hw.write = stateWrite;
+    hw.writeCR = stateWriteCR;
+    NVStateLoad(&hw, state, pNv->LoadedRegValid ? &pNv->LoadedReg : NULL);
 
     pNv->PCRTC[0x0140/4] = 0;
     pNv->PCRTC[0x0100/4] = 1;
 
     pNv->CurrentState = state;
+    pNv->LoadedReg = *state;
+    pNv->LoadedRegValid = TRUE;
 }
 
 void NVUnloadStateExt
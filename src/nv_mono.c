@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2003 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+
+#include "nv_mono.h"
+
+/*
+ * The 1 bpp source and mask are expanded 8 pixels at a time.
+ * expandTab[i] has all bits set in the lanes of the pixels whose bits are
+ * set in the byte i, with the pixels in the order they appear on screen.
+ * Pixels get the foreground color where both source and mask are set,
+ * the background color where only the mask is, and are transparent
+ * everywhere else.
+ */
+static uint32_t expandTab[256][8];
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define SRC_BYTE(w, n)  (((w) >> (24 - ((n) << 3))) & 0xff)
+#define SRC_BIT(k)      (0x80 >> (k))
+#else
+#define SRC_BYTE(w, n)  (((w) >> ((n) << 3)) & 0xff)
+#define SRC_BIT(k)      (1 << (k))
+#endif
+
+void
+NVMonoInit(void)
+{
+    int i, k;
+
+    for(i = 0; i < 256; i++)
+        for(k = 0; k < 8; k++)
+            expandTab[i][k] = (i & SRC_BIT(k)) ? ~0 : 0;
+}
+
+void
+NVMonoExpand(uint32_t b, uint32_t m, uint32_t fg, uint32_t bg, uint32_t *dst)
+{
+    const uint32_t fgBits = b & m;
+    const uint32_t bgBits = ~b & m;
+    int n, k;
+
+    for(n = 0; n < 4; n++) {
+        const uint32_t *f = expandTab[SRC_BYTE(fgBits, n)];
+        const uint32_t *g = expandTab[SRC_BYTE(bgBits, n)];
+
+        for(k = 0; k < 8; k++)
+            dst[k] = (f[k] & fg) | (g[k] & bg);
+        dst += 8;
+    }
+}
+
+/* Same for 16 bit pixels, fg and bg are 1555 colors */
+void
+NVMonoExpand16(uint32_t b, uint32_t m, uint16_t fg, uint16_t bg,
+               uint16_t *dst)
+{
+    const uint32_t fgBits = b & m;
+    const uint32_t bgBits = ~b & m;
+    int n, k;
+
+    for(n = 0; n < 4; n++) {
+        const uint32_t *f = expandTab[SRC_BYTE(fgBits, n)];
+        const uint32_t *g = expandTab[SRC_BYTE(bgBits, n)];
+
+        for(k = 0; k < 8; k++)
+            dst[k] = (f[k] & fg) | (g[k] & bg);
+        dst += 8;
+    }
+}
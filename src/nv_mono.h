@@ -0,0 +1,19 @@
+#ifndef __NV_MONO_H__
+#define __NV_MONO_H__
+
+#include <stdint.h>
+
+/*
+ * Mono cursor expansion in nv_mono.c.  NVMonoExpand turns one word of
+ * 1 bpp source and one of mask, in the server's bit order, into 32
+ * pixels: fg where both are set, bg where only the mask is and 0 where
+ * the mask is clear.  NVMonoExpand16 does the same for 16 bit pixels.
+ * NVMonoInit has to be called once first.
+ */
+void NVMonoInit(void);
+void NVMonoExpand(uint32_t src, uint32_t mask, uint32_t fg, uint32_t bg,
+                  uint32_t *dst);
+void NVMonoExpand16(uint32_t src, uint32_t mask, uint16_t fg, uint16_t bg,
+                    uint16_t *dst);
+
+#endif /* __NV_MONO_H__ */
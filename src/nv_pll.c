@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2007 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "nv_pll.h"
+
+/*
+ * The search walks the post divider, M1 and, for two stage PLLs, N1 and
+ * M2.  The ranges of each follow directly from the limits, and the last
+ * multiplier is the target rounded down or up, so it is never searched.
+ * Errors are compared exactly as fractions, which is why the results can
+ * differ from the old per-family loops: those truncated or rounded the
+ * candidate clock before comparing.
+ */
+
+#define DIV_UP(a, b) (((a) + (b) - 1) / (b))
+
+typedef struct {
+    const NVPllLimits *limits;
+    uint64_t clock;
+    uint64_t err, den;          /* best error is err / den, den 0 if none */
+    NVPllCoeffs best;
+} PllSearch;
+
+/*
+ * The last multiplier for a set of dividers is num / vco.  Rounded down
+ * the error is clock - refclk * N / den = (num % vco) / den, rounded up it
+ * is the rest of vco, so both candidates are scored from the remainder.
+ */
+static void
+tryRounded(PllSearch *s, uint64_t q, uint64_t r, uint64_t vco, int minN,
+           int maxN, int n1, int m1, int m2, int p, uint64_t div)
+{
+    uint64_t den = (uint64_t)m1 * m2 * div;
+    uint64_t err = r;
+
+    if((q < (uint64_t)minN) || ((vco - r < r) && (q < (uint64_t)maxN))) {
+        err = vco - r;
+        q++;
+    }
+    if((q < (uint64_t)minN) || (q > (uint64_t)maxN))
+        return;
+    if(s->den && (err * s->den >= s->err * den))
+        return;
+
+    s->err = err;
+    s->den = den;
+    s->best.m1 = m1;
+    s->best.m2 = m2;
+    s->best.p = p;
+    if(s->limits->maxM2) {
+        s->best.n1 = n1;
+        s->best.n2 = (int)q;
+    } else {
+        s->best.n1 = (int)q;
+        s->best.n2 = 1;
+    }
+    s->best.clock = (uint64_t)s->limits->refclk * s->best.n1 * s->best.n2 /
+                    den;
+}
+
+static void
+searchPll(PllSearch *s)
+{
+    const NVPllLimits *lim = s->limits;
+    uint64_t ref = lim->refclk;
+    int p, m1, n1, m2;
+    uint64_t q, r, dq, dr;
+    int minM1, maxM1, minN1, maxN1, minM2, maxM2;
+
+    minM1 = lim->minM1;
+    maxM1 = lim->maxM1;
+    if(lim->maxU1 && (minM1 < DIV_UP(lim->refclk, lim->maxU1)))
+        minM1 = DIV_UP(lim->refclk, lim->maxU1);
+    if(lim->minU1 && (maxM1 > lim->refclk / lim->minU1))
+        maxM1 = lim->refclk / lim->minU1;
+
+    for(p = lim->lowP; p <= lim->highP; p++) {
+        uint64_t div = lim->log2P ? (1 << p) : p;
+
+        if(!div)
+            continue;
+
+        for(m1 = minM1; m1 <= maxM1; m1++) {
+            /* the last multiplier is step * M2 / vco */
+            uint64_t step = s->clock * div * m1;
+
+            if(!lim->maxM2) {
+                tryRounded(s, step / ref, step % ref, ref,
+                           lim->minN1, lim->maxN1, 0, m1, 1, p, div);
+                continue;
+            }
+
+            minN1 = lim->minN1;
+            maxN1 = lim->maxN1;
+            if(lim->minVco1 &&
+               (minN1 < (int)DIV_UP((uint64_t)lim->minVco1 * m1, ref)))
+                minN1 = DIV_UP((uint64_t)lim->minVco1 * m1, ref);
+            if(lim->maxVco1 &&
+               (maxN1 > (int)((uint64_t)lim->maxVco1 * m1 / ref)))
+                maxN1 = (uint64_t)lim->maxVco1 * m1 / ref;
+
+            for(n1 = minN1; n1 <= maxN1; n1++) {
+                uint64_t vco = ref * n1;  /* first stage output times m1 */
+
+                minM2 = lim->minM2;
+                maxM2 = lim->maxM2;
+                if(lim->maxU2 &&
+                   (minM2 < (int)DIV_UP(vco, (uint64_t)m1 * lim->maxU2)))
+                    minM2 = DIV_UP(vco, (uint64_t)m1 * lim->maxU2);
+                if(lim->minU2 &&
+                   (maxM2 > (int)(vco / ((uint64_t)m1 * lim->minU2))))
+                    maxM2 = vco / ((uint64_t)m1 * lim->minU2);
+
+                /* N2 grows with M2, stop before it leaves its range */
+                if(maxM2 > (int)(((lim->maxN2 + 1) * vco - 1) / step))
+                    maxM2 = ((lim->maxN2 + 1) * vco - 1) / step;
+                if((lim->minN2 > 1) &&
+                   (minM2 < (int)DIV_UP((lim->minN2 - 1) * vco, step)))
+                    minM2 = DIV_UP((lim->minN2 - 1) * vco, step);
+                if(minM2 > maxM2)
+                    continue;
+
+                /* walk N2 along with M2 instead of dividing every time */
+                q = step * minM2 / vco;
+                r = step * minM2 % vco;
+                dq = step / vco;
+                dr = step % vco;
+                for(m2 = minM2; m2 <= maxM2; m2++) {
+                    tryRounded(s, q, r, vco, lim->minN2, lim->maxN2,
+                               n1, m1, m2, p, div);
+                    q += dq;
+                    r += dr;
+                    if(r >= vco) {
+                        r -= vco;
+                        q++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Mode validation and mode setting ask for the same few clocks over and
+ * over, so the last results are kept around.
+ */
+#define PLL_CACHE_SIZE 16
+
+static struct {
+    NVPllLimits limits;
+    int         clock;
+    int         found;
+    NVPllCoeffs coeffs;
+} pllCache[PLL_CACHE_SIZE];
+static int pllCacheUsed, pllCacheNext;
+
+/*
+ * Find the coefficients that come closest to clock.  Returns FALSE, and
+ * leaves coeffs alone, when none fit the limits.
+ */
+int
+NVPllSolve(const NVPllLimits *limits, int clock, NVPllCoeffs *coeffs)
+{
+    PllSearch s;
+    int i;
+
+    if(clock <= 0)
+        return 0;
+
+    for(i = 0; i < pllCacheUsed; i++) {
+        if((pllCache[i].clock == clock) &&
+           !memcmp(&pllCache[i].limits, limits, sizeof(*limits)))
+        {
+            if(pllCache[i].found)
+                *coeffs = pllCache[i].coeffs;
+            return pllCache[i].found;
+        }
+    }
+
+    s.limits = limits;
+    s.clock = clock;
+    s.err = s.den = 0;
+    searchPll(&s);
+
+    i = pllCacheNext;
+    pllCacheNext = (pllCacheNext + 1) % PLL_CACHE_SIZE;
+    if(pllCacheUsed < PLL_CACHE_SIZE)
+        pllCacheUsed++;
+    pllCache[i].limits = *limits;
+    pllCache[i].clock = clock;
+    pllCache[i].found = s.den != 0;
+    pllCache[i].coeffs = s.best;
+
+    if(s.den)
+        *coeffs = s.best;
+    return s.den != 0;
+}
+
+/*
+ * Range of log2 post dividers that put clock << P between minVco and
+ * maxVco.  Returns FALSE if there is none, with both ends set to the
+ * outermost divider on the side the clock is out of range.
+ */
+int
+NVPllPostRange(int clock, int minVco, int maxVco, int minP, int maxP,
+               int *lowP, int *highP)
+{
+    int p;
+
+    *lowP = maxP + 1;
+    *highP = minP - 1;
+
+    for(p = minP; p <= maxP; p++) {
+        uint64_t vco = (uint64_t)clock << p;
+
+        if((vco < (uint64_t)minVco) || (vco > (uint64_t)maxVco))
+            continue;
+        if(*lowP > p)
+            *lowP = p;
+        *highP = p;
+    }
+
+    if(*lowP > *highP) {
+        *lowP = *highP = ((uint64_t)clock << minP) > (uint64_t)maxVco ?
+                         minP : maxP;
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,37 @@
+#ifndef __NV_PLL_H__
+#define __NV_PLL_H__
+
+/*
+ * PLL coefficient search in nv_pll.c, shared by the NV, Riva and G80 code.
+ * The output clock is
+ *
+ *   refclk * N1 / M1 * N2 / M2 / P   (or >> P with log2P set)
+ *
+ * Single stage PLLs leave maxM2 at 0 and get N2 = M2 = 1 back.  All
+ * clocks are in kHz; a limit of 0 means the value is not checked.
+ */
+typedef struct {
+    int refclk;
+    int minM1, maxM1;
+    int minN1, maxN1;
+    int minU1, maxU1;           /* refclk / M1 */
+    int minVco1, maxVco1;       /* first stage output, two stage only */
+    int minM2, maxM2;
+    int minN2, maxN2;
+    int minU2, maxU2;           /* first stage output / M2 */
+    int lowP, highP;            /* post divider range to search */
+    int log2P;
+} NVPllLimits;
+
+typedef struct {
+    int n1, m1;
+    int n2, m2;
+    int p;
+    int clock;                  /* resulting clock, rounded down */
+} NVPllCoeffs;
+
+int NVPllPostRange(int clock, int minVco, int maxVco, int minP, int maxP,
+                   int *lowP, int *highP);
+int NVPllSolve(const NVPllLimits *limits, int clock, NVPllCoeffs *coeffs);
+
+#endif /* __NV_PLL_H__ */
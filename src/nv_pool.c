@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2026 The xf86-video-nv authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include "nv_pool.h"
+
+#ifdef HAVE_PTHREAD
+/*
+ * Everything below the thread ids is only touched with the lock held.
+ * Outside NVPoolRun next and jobs are both 0, so a worker that wakes up
+ * for no reason finds nothing to do.
+ */
+struct _NVPool {
+    int                 threads;
+    pthread_t          *tids;
+    pthread_mutex_t     lock;
+    pthread_cond_t      work;
+    pthread_cond_t      done;
+    int                 quit;
+
+    NVPoolProc          proc;
+    void               *data;
+    int                 jobs;
+    int                 next;
+    int                 pending;
+};
+
+/* Runs jobs until there are none left.  Called and returns locked. */
+static void
+poolWork(NVPoolPtr pool)
+{
+    while(pool->next < pool->jobs) {
+        NVPoolProc proc = pool->proc;
+        void *data = pool->data;
+        int job = pool->next++;
+
+        pthread_mutex_unlock(&pool->lock);
+        (*proc)(data, job);
+        pthread_mutex_lock(&pool->lock);
+
+        if(!--pool->pending)
+            pthread_cond_signal(&pool->done);
+    }
+}
+
+static void *
+poolThread(void *data)
+{
+    NVPoolPtr pool = data;
+
+    pthread_mutex_lock(&pool->lock);
+    while(!pool->quit) {
+        poolWork(pool);
+        pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+NVPoolPtr
+NVPoolCreate(int threads)
+{
+    NVPoolPtr pool;
+    sigset_t all, saved;
+    int i;
+
+    if(threads < 1)
+        return NULL;
+
+    pool = calloc(1, sizeof(*pool));
+    if(!pool)
+        return NULL;
+    pool->tids = calloc(threads, sizeof(pthread_t));
+    if(!pool->tids) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    /* the server's signals have to keep going to the main thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    for(i = 0; i < threads; i++) {
+        if(pthread_create(&pool->tids[i], NULL, poolThread, pool))
+            break;
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    pool->threads = i;
+    if(!i) {
+        NVPoolDestroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void
+NVPoolDestroy(NVPoolPtr pool)
+{
+    int i;
+
+    if(!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(i = 0; i < pool->threads; i++)
+        pthread_join(pool->tids[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->tids);
+    free(pool);
+}
+
+int
+NVPoolThreads(NVPoolPtr pool)
+{
+    return pool ? pool->threads : 0;
+}
+
+void
+NVPoolRun(NVPoolPtr pool, NVPoolProc proc, void *data, int jobs)
+{
+    int i;
+
+    if(!pool) {
+        for(i = 0; i < jobs; i++)
+            (*proc)(data, i);
+        return;
+    }
+    if(jobs <= 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->proc = proc;
+    pool->data = data;
+    pool->jobs = jobs;
+    pool->next = 0;
+    pool->pending = jobs;
+    pthread_cond_broadcast(&pool->work);
+
+    poolWork(pool);
+    while(pool->pending)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    pool->jobs = 0;
+    pool->next = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+#else
+NVPoolPtr
+NVPoolCreate(int threads)
+{
+    return NULL;
+}
+
+void
+NVPoolDestroy(NVPoolPtr pool)
+{
+}
+
+int
+NVPoolThreads(NVPoolPtr pool)
+{
+    return 0;
+}
+
+void
+NVPoolRun(NVPoolPtr pool, NVPoolProc proc, void *data, int jobs)
+{
+    int i;
+
+    for(i = 0; i < jobs; i++)
+        (*proc)(data, i);
+}
+#endif
@@ -0,0 +1,18 @@
+#ifndef __NV_POOL_H__
+#define __NV_POOL_H__
+
+/*
+ * Worker threads in nv_pool.c.  NVPoolRun calls proc once for each job
+ * number from 0 to jobs - 1, spread over the workers and the calling
+ * thread, and returns once all of them are done.  Without pthreads, or
+ * with a NULL pool, the jobs just run in the calling thread.
+ */
+typedef struct _NVPool *NVPoolPtr;
+typedef void (*NVPoolProc)(void *data, int job);
+
+NVPoolPtr NVPoolCreate(int threads);
+void NVPoolDestroy(NVPoolPtr pool);
+int NVPoolThreads(NVPoolPtr pool);
+void NVPoolRun(NVPoolPtr pool, NVPoolProc proc, void *data, int jobs);
+
+#endif /* __NV_POOL_H__ */
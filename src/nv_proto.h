@@ -28,14 +28,25 @@ void   NVCommonSetup(ScrnInfoPtr pScrn);
 
 /* in nv_cursor.c */
 Bool   NVCursorInit(ScreenPtr pScreen);
+void   NVCursorInvalidate(ScrnInfoPtr pScrn);
 
 /* in nv_xaa.c */
 Bool   NVAccelInit(ScreenPtr pScreen);
 void   NVSync(ScrnInfoPtr pScrn);
 void   NVResetGraphics(ScrnInfoPtr pScrn);
 void   NVDmaKickoff(NVPtr pNv);
+void   NVDmaAutoKickoff(NVPtr pNv, int pixels);
 void   NVDmaWait(NVPtr pNv, int size);
 void   NVWaitVSync(NVPtr pNv);
+void   NVSetRopSolid(ScrnInfoPtr pScrn, CARD32 rop, CARD32 planemask);
+void   NVDMAKickoffCallback(ScrnInfoPtr pScrn);
+void   NVDmaSolidRect(NVPtr pNv, int x, int y, int w, int h);
+CARD32 NVEmitFence(ScrnInfoPtr pScrn);
+Bool   NVFencePassed(NVPtr pNv, CARD32 fence);
+void   NVWaitFence(ScrnInfoPtr pScrn, CARD32 fence);
+
+/* in nv_exa.c */
+Bool   NVExaInit(ScreenPtr pScreen);
 
 /* in nv_dga.c */
 Bool   NVDGAInit(ScreenPtr pScreen);
@@ -46,6 +57,7 @@ void NVLoadStateExt(NVPtr,struct _riva_hw_state *);
 void NVUnloadStateExt(NVPtr,struct _riva_hw_state *);
 void NVSetStartAddress(NVPtr,CARD32);
 int  NVShowHideCursor(NVPtr,int);
+void NVSetCursorStart(NVPtr,CARD32);
 void NVLockUnlock(NVPtr,int);
 
 /* in nv_shadow.c */
@@ -54,5 +66,11 @@ void NVRefreshArea8(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 void NVRefreshArea16(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 void NVRefreshArea32(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 void NVPointerMoved(SCRN_ARG_TYPE arg, int x, int y);
+void NVRefreshAccumulate(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
+void NVShadowFlush(ScrnInfoPtr pScrn, pointer pTimeout);
+void NVRefreshThreaded(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
+Bool NVShadowHashInit(ScrnInfoPtr pScrn);
+void NVShadowHashFini(ScrnInfoPtr pScrn);
+void NVShadowHashInvalidate(ScrnInfoPtr pScrn);
 
 #endif /* __NV_PROTO_H__ */
@@ -10,37 +10,331 @@
 #include "nv_local.h"
 #include "nv_include.h"
 #include "nv_type.h"
+#include "nv_shadow.h"
+#include "nv_copy.h"
+#include "nv_pool.h"
 #include "shadowfb.h"
 #include "servermd.h"
 
 
+/*
+ * Unrotated refresh.  NVCopyLines in nv_copy.c streams each line in whole
+ * write-combining bursts.  Boxes in the same band that touch or nearly
+ * touch, and boxes stacked on top of each other with the same extent, are
+ * merged first.  Copying the few unchanged pixels in between costs less
+ * than breaking up the bursts.
+ */
+
+static void
+copyBox(CARD8 *dst, int dstPitch, const CARD8 *src, int srcPitch, int Bpp,
+        BoxPtr pbox)
+{
+    src += (pbox->y1 * srcPitch) + (pbox->x1 * Bpp);
+    dst += (pbox->y1 * dstPitch) + (pbox->x1 * Bpp);
+
+    NVCopyLines(dst, dstPitch, src, srcPitch, (pbox->x2 - pbox->x1) * Bpp,
+                pbox->y2 - pbox->y1);
+}
+
+void
+NVShadowCopyBoxes(CARD8 *dst, int dstPitch, const CARD8 *src, int srcPitch,
+                  int Bpp, int num, BoxPtr pbox)
+{
+    BoxRec box;
+
+    if(num <= 0)
+        return;
+
+    box = *(pbox++);
+
+    while(--num) {
+        if((pbox->y1 == box.y1) && (pbox->y2 == box.y2) &&
+           (pbox->x1 <= box.x2 + NV_COPY_BURST / Bpp) &&
+           (pbox->x2 >= box.x1 - NV_COPY_BURST / Bpp))
+        {
+            box.x1 = min(box.x1, pbox->x1);
+            box.x2 = max(box.x2, pbox->x2);
+        } else if((pbox->x1 == box.x1) && (pbox->x2 == box.x2) &&
+                  (pbox->y1 <= box.y2) && (pbox->y2 >= box.y1))
+        {
+            box.y1 = min(box.y1, pbox->y1);
+            box.y2 = max(box.y2, pbox->y2);
+        } else {
+            copyBox(dst, dstPitch, src, srcPitch, Bpp, &box);
+            box = *pbox;
+        }
+        pbox++;
+    }
+    copyBox(dst, dstPitch, src, srcPitch, Bpp, &box);
+    NVCopyFlush();
+}
+
+/*
+ * Tile hashes, Option "ShadowHash".  The screen is cut into HASH_TILE
+ * square tiles and the hash of each tile's shadow contents is remembered
+ * from the last time the tile was copied out.  Damaged tiles whose hash
+ * hasn't changed since are dropped from the refresh, which catches the
+ * clients that redraw the same pixels over and over.  A tile that did
+ * change is copied whole rather than just the damaged part, so that the
+ * framebuffer matches the stored hash afterwards.  A hash of 0 marks a
+ * tile whose framebuffer contents are unknown.
+ */
+
+#define HASH_TILE 64
+
+#define HASH_K1 0x9e3779b97f4a7c15ULL
+#define HASH_K2 0xc2b2ae3d27d4eb4fULL
+
+static CARD64
+hashWord(CARD64 h, CARD64 v)
+{
+    h ^= v * HASH_K2;
+    h = (h << 31) | (h >> 33);
+    return h * HASH_K1;
+}
+
+static CARD64
+hashTile(const CARD8 *src, int pitch, int bytes, int rows)
+{
+    CARD64 h0 = HASH_K1, h1 = HASH_K2, v0, v1;
+    int i;
+
+    while(rows--) {
+        for(i = 0; i + 16 <= bytes; i += 16) {
+            memcpy(&v0, src + i, 8);
+            memcpy(&v1, src + i + 8, 8);
+            h0 = hashWord(h0, v0);
+            h1 = hashWord(h1, v1);
+        }
+        for(; i < bytes; i++)
+            h0 = hashWord(h0, src[i]);
+        src += pitch;
+    }
+
+    h0 = hashWord(h0, h1);
+    h0 ^= h0 >> 29;
+
+    return h0 ? h0 : 1;
+}
+
+Bool
+NVShadowHashInit(ScrnInfoPtr pScrn)
+{
+    NVPtr pNv = NVPTR(pScrn);
+    int tiles;
+
+    pNv->ShadowTilesX = (pScrn->virtualX + HASH_TILE - 1) / HASH_TILE;
+    pNv->ShadowTilesY = (pScrn->virtualY + HASH_TILE - 1) / HASH_TILE;
+    tiles = pNv->ShadowTilesX * pNv->ShadowTilesY;
+
+    pNv->ShadowTileHash = calloc(tiles, sizeof(CARD64));
+    pNv->ShadowTileStamp = calloc(tiles, sizeof(CARD32));
+    pNv->ShadowTileBoxes = malloc(tiles * sizeof(BoxRec));
+    if(!pNv->ShadowTileHash || !pNv->ShadowTileStamp ||
+       !pNv->ShadowTileBoxes)
+    {
+        NVShadowHashFini(pScrn);
+        return FALSE;
+    }
+
+    pNv->ShadowTileGeneration = 0;
+    pNv->statTileHits = pNv->statTileMisses = 0;
+    return TRUE;
+}
+
+void
+NVShadowHashFini(ScrnInfoPtr pScrn)
+{
+    NVPtr pNv = NVPTR(pScrn);
+
+    free(pNv->ShadowTileHash);
+    free(pNv->ShadowTileStamp);
+    free(pNv->ShadowTileBoxes);
+    pNv->ShadowTileHash = NULL;
+    pNv->ShadowTileStamp = NULL;
+    pNv->ShadowTileBoxes = NULL;
+}
+
+/* The framebuffer was written behind our back, e.g. by a mode switch. */
+void
+NVShadowHashInvalidate(ScrnInfoPtr pScrn)
+{
+    NVPtr pNv = NVPTR(pScrn);
+
+    if(pNv->ShadowTileHash)
+        memset(pNv->ShadowTileHash, 0, pNv->ShadowTilesX *
+               pNv->ShadowTilesY * sizeof(CARD64));
+}
+
+/* Returns the whole tiles of pbox whose contents changed in ppbox. */
+static int
+hashBoxes(ScrnInfoPtr pScrn, int num, BoxPtr pbox, BoxPtr *ppbox)
+{
+    NVPtr pNv = NVPTR(pScrn);
+    const int Bpp = pScrn->bitsPerPixel >> 3;
+    BoxPtr out = pNv->ShadowTileBoxes;
+    CARD32 gen = ++pNv->ShadowTileGeneration;
+    int tx, ty, n = 0;
+
+    /* the stamps have wrapped around, a stale one could match */
+    if(!gen) {
+        memset(pNv->ShadowTileStamp, 0, pNv->ShadowTilesX *
+               pNv->ShadowTilesY * sizeof(CARD32));
+        gen = pNv->ShadowTileGeneration = 1;
+    }
+
+    for(; num--; pbox++) {
+        int tx1 = max(pbox->x1, 0) / HASH_TILE;
+        int ty1 = max(pbox->y1, 0) / HASH_TILE;
+        int tx2 = min((pbox->x2 + HASH_TILE - 1) / HASH_TILE,
+                      pNv->ShadowTilesX);
+        int ty2 = min((pbox->y2 + HASH_TILE - 1) / HASH_TILE,
+                      pNv->ShadowTilesY);
+
+        for(ty = ty1; ty < ty2; ty++) {
+            for(tx = tx1; tx < tx2; tx++) {
+                int tile = (ty * pNv->ShadowTilesX) + tx;
+                BoxRec box;
+                CARD64 hash;
+
+                if(pNv->ShadowTileStamp[tile] == gen)
+                    continue;
+                pNv->ShadowTileStamp[tile] = gen;
+
+                box.x1 = tx * HASH_TILE;
+                box.y1 = ty * HASH_TILE;
+                box.x2 = min(box.x1 + HASH_TILE, pScrn->virtualX);
+                box.y2 = min(box.y1 + HASH_TILE, pScrn->virtualY);
+
+                hash = hashTile(pNv->ShadowPtr + (box.y1 * pNv->ShadowPitch) +
+                                (box.x1 * Bpp), pNv->ShadowPitch,
+                                (box.x2 - box.x1) * Bpp, box.y2 - box.y1);
+
+                if(hash == pNv->ShadowTileHash[tile]) {
+                    pNv->statTileHits++;
+                    continue;
+                }
+
+                pNv->statTileMisses++;
+                pNv->ShadowTileHash[tile] = hash;
+                out[n++] = box;
+            }
+        }
+    }
+
+    *ppbox = out;
+    return n;
+}
+
 void
 NVRefreshArea(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 {
     NVPtr pNv = NVPTR(pScrn);
-    int width, height, Bpp, FBPitch;
-    unsigned char *src, *dst;
-   
+    int Bpp, FBPitch;
+
+    if(pNv->ShadowTileHash) {
+        num = hashBoxes(pScrn, num, pbox, &pbox);
+        if(!num)
+            return;
+    }
+
     Bpp = pScrn->bitsPerPixel >> 3;
     FBPitch = BitmapBytePad(pScrn->displayWidth * pScrn->bitsPerPixel);
 
-    while(num--) {
-	width = (pbox->x2 - pbox->x1) * Bpp;
-	height = pbox->y2 - pbox->y1;
-	src = pNv->ShadowPtr + (pbox->y1 * pNv->ShadowPitch) + 
-						(pbox->x1 * Bpp);
-	dst = pNv->FbStart + (pbox->y1 * FBPitch) + (pbox->x1 * Bpp);
-
-	while(height--) {
-	    memcpy(dst, src, width);
-	    dst += FBPitch;
-	    src += pNv->ShadowPitch;
-	}
-	
-	pbox++;
-    }
+    NVShadowCopyBoxes(pNv->FbStart, FBPitch, pNv->ShadowPtr,
+                      pNv->ShadowPitch, Bpp, num, pbox);
 } 
 
+/*
+ * Paced refresh, Option "ShadowPacing".  The damage ShadowFB reports is
+ * collected in ShadowDamage and copied out from the BlockHandler at most
+ * once per frame of the current mode, so a client animating faster than
+ * the display doesn't get the same pixels copied several times a frame.
+ * Damage arriving after a frame or more without updates is copied right
+ * away, so isolated updates such as typing don't pick up any latency.
+ */
+
+static CARD32
+framePeriod(ScrnInfoPtr pScrn)
+{
+    DisplayModePtr mode = pScrn->currentMode;
+    CARD32 period = 16;
+
+    if(mode && mode->Clock > 0)
+        period = (mode->HTotal * mode->VTotal) / mode->Clock;
+
+    return period ? period : 1;
+}
+
+void
+NVRefreshAccumulate(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
+{
+    NVPtr pNv = NVPTR(pScrn);
+    ScreenPtr pScreen = pScrn->pScreen;
+    CARD32 now = GetTimeInMillis();
+    xRectangle stack[32], *rects = stack;
+    RegionPtr region;
+    int i;
+
+    if(!REGION_NOTEMPTY(pScreen, &pNv->ShadowDamage) &&
+       ((now - pNv->ShadowFlushed) >= framePeriod(pScrn)))
+    {
+        (*pNv->ShadowRefresh)(pScrn, num, pbox);
+        pNv->ShadowFlushed = now;
+        return;
+    }
+
+    if(num > (int)(sizeof(stack) / sizeof(stack[0]))) {
+        rects = malloc(num * sizeof(xRectangle));
+        if(!rects) {
+            (*pNv->ShadowRefresh)(pScrn, num, pbox);
+            return;
+        }
+    }
+
+    for(i = 0; i < num; i++) {
+        rects[i].x = pbox[i].x1;
+        rects[i].y = pbox[i].y1;
+        rects[i].width = pbox[i].x2 - pbox[i].x1;
+        rects[i].height = pbox[i].y2 - pbox[i].y1;
+    }
+
+    /* the boxes are the rectangles of shadowfb's damage region, so they
+       are already banded and the region doesn't have to sort them */
+    region = RECTS_TO_REGION(pScreen, num, rects, CT_YXBANDED);
+    REGION_UNION(pScreen, &pNv->ShadowDamage, &pNv->ShadowDamage, region);
+    REGION_DESTROY(pScreen, region);
+
+    if(rects != stack)
+        free(rects);
+}
+
+void
+NVShadowFlush(ScrnInfoPtr pScrn, pointer pTimeout)
+{
+    NVPtr pNv = NVPTR(pScrn);
+    ScreenPtr pScreen = pScrn->pScreen;
+    RegionPtr pReg = &pNv->ShadowDamage;
+    CARD32 now, due;
+
+    if(!REGION_NOTEMPTY(pScreen, pReg))
+        return;
+
+    now = GetTimeInMillis();
+    due = pNv->ShadowFlushed + framePeriod(pScrn);
+
+    if((INT32)(now - due) < 0) {
+        AdjustWaitForDelay(pTimeout, due - now);
+        return;
+    }
+
+    if(pScrn->vtSema)
+        (*pNv->ShadowRefresh)(pScrn, REGION_NUM_RECTS(pReg),
+                              REGION_RECTS(pReg));
+    REGION_EMPTY(pScreen, pReg);
+    pNv->ShadowFlushed = now;
+}
+
 void
 NVPointerMoved(SCRN_ARG_TYPE arg, int x, int y)
 {
@@ -59,13 +353,25 @@ NVPointerMoved(SCRN_ARG_TYPE arg, int x, int y)
     (*pNv->PointerMoved)(arg, newX, newY);
 }
 
+/*
+ * Rotation.  The boxes go through NVCopyRotate in nv_copy.c, which works
+ * in NV_COPY_TILE x NV_COPY_TILE blocks so the shadow lines of a block
+ * stay in cache while its output rows go out as contiguous runs.
+ */
+
+/* Picks the line copy and rotation kernels for this CPU */
+void
+NVShadowInit(void)
+{
+    NVCopyInit(1);
+}
+
 void
 NVRefreshArea8(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 {
     NVPtr pNv = NVPTR(pScrn);
-    int count, width, height, y1, y2, dstPitch, srcPitch;
-    CARD8 *dstPtr, *srcPtr, *src;
-    CARD32 *dst;
+    int width, y1, y2, dstPitch, srcPitch;
+    CARD8 *dstPtr, *srcPtr;
 
     if(!pNv->Rotate) {
        NVRefreshArea(pScrn, num, pbox);
@@ -79,7 +385,6 @@ NVRefreshArea8(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 	width = pbox->x2 - pbox->x1;
 	y1 = pbox->y1 & ~3;
 	y2 = (pbox->y2 + 3) & ~3;
-	height = (y2 - y1) >> 2;  /* in dwords */
 
 	if(pNv->Rotate == 1) {
 	    dstPtr = pNv->FbStart + 
@@ -91,19 +396,8 @@ NVRefreshArea8(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 	    srcPtr = pNv->ShadowPtr + (y1 * srcPitch) + pbox->x2 - 1;
 	}
 
-	while(width--) {
-	    src = srcPtr;
-	    dst = (CARD32*)dstPtr;
-	    count = height;
-	    while(count--) {
-		*(dst++) = src[0] | (src[srcPitch] << 8) | 
-					(src[srcPitch * 2] << 16) | 
-					(src[srcPitch * 3] << 24);
-		src += srcPitch * 4;
-	    }
-	    srcPtr += pNv->Rotate;
-	    dstPtr += dstPitch;
-	}
+	NVCopyRotate(1, dstPtr, dstPitch, srcPtr, srcPitch,
+		     pNv->Rotate, width, y2 - y1);
 
 	pbox++;
     }
@@ -114,9 +408,8 @@ void
 NVRefreshArea16(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 {
     NVPtr pNv = NVPTR(pScrn);
-    int count, width, height, y1, y2, dstPitch, srcPitch;
-    CARD16 *dstPtr, *srcPtr, *src;
-    CARD32 *dst;
+    int width, y1, y2, dstPitch, srcPitch;
+    CARD16 *dstPtr, *srcPtr;
 
     if(!pNv->Rotate) {
        NVRefreshArea(pScrn, num, pbox);
@@ -130,7 +423,6 @@ NVRefreshArea16(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 	width = pbox->x2 - pbox->x1;
 	y1 = pbox->y1 & ~1;
 	y2 = (pbox->y2 + 1) & ~1;
-	height = (y2 - y1) >> 1;  /* in dwords */
 
 	if(pNv->Rotate == 1) {
 	    dstPtr = (CARD16*)pNv->FbStart + 
@@ -144,17 +436,8 @@ NVRefreshArea16(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 			(y1 * srcPitch) + pbox->x2 - 1;
 	}
 
-	while(width--) {
-	    src = srcPtr;
-	    dst = (CARD32*)dstPtr;
-	    count = height;
-	    while(count--) {
-		*(dst++) = src[0] | (src[srcPitch] << 16);
-		src += srcPitch * 2;
-	    }
-	    srcPtr += pNv->Rotate;
-	    dstPtr += dstPitch;
-	}
+	NVCopyRotate(2, dstPtr, dstPitch, srcPtr, srcPitch,
+		     pNv->Rotate, width, y2 - y1);
 
 	pbox++;
     }
@@ -165,8 +448,8 @@ void
 NVRefreshArea32(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 {
     NVPtr pNv = NVPTR(pScrn);
-    int count, width, height, dstPitch, srcPitch;
-    CARD32 *dstPtr, *srcPtr, *src, *dst;
+    int width, height, dstPitch, srcPitch;
+    CARD32 *dstPtr, *srcPtr;
 
     if(!pNv->Rotate) {
        NVRefreshArea(pScrn, num, pbox);
@@ -192,18 +475,143 @@ NVRefreshArea32(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 			(pbox->y1 * srcPitch) + pbox->x2 - 1;
 	}
 
-	while(width--) {
-	    src = srcPtr;
-	    dst = dstPtr;
-	    count = height;
-	    while(count--) {
-		*(dst++) = *src;
-		src += srcPitch;
-	    }
-	    srcPtr += pNv->Rotate;
-	    dstPtr += dstPitch;
-	}
+	NVCopyRotate(4, dstPtr, dstPitch, srcPtr, srcPitch,
+		     pNv->Rotate, width, height);
 
 	pbox++;
     }
 }
+
+
+/*
+ * Worker pool for Option "ShadowThreads".  The boxes are cut into bands of
+ * rows which NVPoolRun in nv_pool.c hands to the workers and the calling
+ * thread; the call returns once all of them are done.  Band edges fall on
+ * multiples of NV_COPY_TILE rows so the dword packing of the 8 and 16 bit
+ * rotations never has two threads write the same dword.  The bands are
+ * all cut before the pool gets to see any of them.
+ */
+
+/* boxes smaller than this aren't worth handing out */
+#define POOL_MIN_PIXELS (128 * 128)
+
+struct _NVShadowPool {
+    NVPoolPtr           pool;
+    RefreshAreaFuncPtr  refresh;
+    ScrnInfoPtr         pScrn;
+    BoxPtr              bands;
+    int                 numBands;
+    int                 maxBands;
+};
+
+NVShadowPoolPtr
+NVShadowPoolCreate(int threads)
+{
+    NVShadowPoolPtr pool = calloc(1, sizeof(*pool));
+
+    if(!pool)
+        return NULL;
+
+    pool->pool = NVPoolCreate(threads);
+    if(!pool->pool) {
+        free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void
+NVShadowPoolDestroy(NVShadowPoolPtr pool)
+{
+    if(!pool)
+        return;
+
+    NVPoolDestroy(pool->pool);
+    free(pool->bands);
+    free(pool);
+}
+
+static Bool
+poolAddBand(NVShadowPoolPtr pool, BoxPtr pbox, int y1, int y2)
+{
+    BoxPtr band;
+
+    if(pool->numBands == pool->maxBands) {
+        int max = pool->maxBands ? (pool->maxBands * 2) : 64;
+        BoxPtr bands = realloc(pool->bands, max * sizeof(BoxRec));
+
+        if(!bands)
+            return FALSE;
+        pool->bands = bands;
+        pool->maxBands = max;
+    }
+
+    band = &pool->bands[pool->numBands++];
+    band->x1 = pbox->x1;
+    band->x2 = pbox->x2;
+    band->y1 = y1;
+    band->y2 = y2;
+    return TRUE;
+}
+
+static void
+poolBand(void *data, int i)
+{
+    NVShadowPoolPtr pool = data;
+
+    (*pool->refresh)(pool->pScrn, 1, &pool->bands[i]);
+}
+
+void
+NVShadowPoolRun(NVShadowPoolPtr pool, RefreshAreaFuncPtr refresh,
+                ScrnInfoPtr pScrn, int num, BoxPtr pbox)
+{
+    const int threads = pool ? NVPoolThreads(pool->pool) : 0;
+    int i;
+
+    if(!threads) {
+        (*refresh)(pScrn, num, pbox);
+        return;
+    }
+
+    pool->numBands = 0;
+    for(i = 0; i < num; i++) {
+        BoxPtr box = &pbox[i];
+        int height = box->y2 - box->y1;
+        int step, y, next;
+
+        if((box->x2 - box->x1) * height < POOL_MIN_PIXELS) {
+            if(!poolAddBand(pool, box, box->y1, box->y2))
+                goto fallback;
+            continue;
+        }
+
+        step = (height + threads) / (threads + 1);
+        step = (step + NV_COPY_TILE - 1) & ~(NV_COPY_TILE - 1);
+        for(y = box->y1; y < box->y2; y = next) {
+            next = min(((y + step) & ~(NV_COPY_TILE - 1)), box->y2);
+            if(next <= y)
+                next = min(y + NV_COPY_TILE, box->y2);
+            if(!poolAddBand(pool, box, y, next))
+                goto fallback;
+        }
+    }
+
+    pool->refresh = refresh;
+    pool->pScrn = pScrn;
+    NVPoolRun(pool->pool, poolBand, pool, pool->numBands);
+    return;
+
+fallback:
+    (*refresh)(pScrn, num, pbox);
+}
+
+void
+NVRefreshThreaded(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
+{
+    NVPtr pNv = NVPTR(pScrn);
+
+    NVShadowPoolRun(pNv->ShadowPool, pNv->ShadowThreadedRefresh,
+                    pScrn, num, pbox);
+}
@@ -0,0 +1,16 @@
+#ifndef __NV_SHADOW_H__
+#define __NV_SHADOW_H__
+
+/* Shadow framebuffer helpers in nv_shadow.c, shared with the Riva code */
+void NVShadowInit(void);
+void NVShadowCopyBoxes(CARD8 *dst, int dstPitch, const CARD8 *src,
+                       int srcPitch, int Bpp, int num, BoxPtr pbox);
+
+typedef struct _NVShadowPool *NVShadowPoolPtr;
+
+NVShadowPoolPtr NVShadowPoolCreate(int threads);
+void NVShadowPoolDestroy(NVShadowPoolPtr pool);
+void NVShadowPoolRun(NVShadowPoolPtr pool, RefreshAreaFuncPtr refresh,
+                     ScrnInfoPtr pScrn, int num, BoxPtr pbox);
+
+#endif /* __NV_SHADOW_H__ */
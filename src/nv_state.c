@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 1993-2003 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+
+#include "nv_state.h"
+
+#define RD(ap, off)       hw->read(hw->priv, (ap), (off))
+#define WR(ap, off, val)  hw->write(hw->priv, (ap), (off), (val))
+#define CR(index, val)    hw->writeCR(hw->priv, (index), (val))
+
+/*
+ * The PLL registers in PRAMDAC0 are shared by both heads, so they are
+ * compared against the hardware rather than against the last state we
+ * loaded ourselves.
+ */
+static int
+pllsLoaded(const NVStateHW *hw, const RIVA_HW_STATE *state)
+{
+    if((hw->architecture >= NV_ARCH_40) &&
+       (RD(NV_STATE_PRAMDAC0, 0x0580) != state->control))
+        return 0;
+    if((RD(NV_STATE_PRAMDAC0, 0x050C) != state->pllsel) ||
+       (RD(NV_STATE_PRAMDAC0, 0x0508) != state->vpll))
+        return 0;
+    if(hw->twoHeads && (RD(NV_STATE_PRAMDAC0, 0x0520) != state->vpll2))
+        return 0;
+    if(hw->twoStagePLL &&
+       ((RD(NV_STATE_PRAMDAC0, 0x0578) != state->vpllB) ||
+        (RD(NV_STATE_PRAMDAC0, 0x057C) != state->vpll2B)))
+        return 0;
+
+    return 1;
+}
+
+/*
+ * Only write the CRTC and RAMDAC registers that differ from old, the last
+ * state loaded, or all of them if there is none.  Reprogramming identical
+ * timings and PLLs makes the display blink on mode switches that don't
+ * need it.  The cursor registers and the flat panel control are also
+ * written by the cursor and backlight code, so they are always reloaded.
+ */
+void
+NVStateLoad(const NVStateHW *hw, const RIVA_HW_STATE *state,
+            const RIVA_HW_STATE *old)
+{
+#define CHANGED(field) (!old || (old->field != state->field))
+
+    if(hw->architecture >= NV_ARCH_10) {
+        if(CHANGED(cursorConfig))
+           WR(NV_STATE_PCRTC, 0x0810, state->cursorConfig);
+        if(CHANGED(displayV)) {
+           WR(NV_STATE_PCRTC, 0x0830, state->displayV - 3);
+           WR(NV_STATE_PCRTC, 0x0834, state->displayV - 1);
+        }
+
+        if(hw->flatPanel) {
+           if(CHANGED(dither)) {
+              if((hw->chipset & 0x0ff0) == 0x0110) {
+                  WR(NV_STATE_PRAMDAC, 0x0528, state->dither);
+              } else
+              if(hw->twoHeads) {
+                  WR(NV_STATE_PRAMDAC, 0x083C, state->dither);
+              }
+           }
+
+           if(CHANGED(timingH))
+              CR(0x53, state->timingH);
+           if(CHANGED(timingV))
+              CR(0x54, state->timingV);
+           CR(0x21, 0xfa);
+        }
+
+        if(CHANGED(extra))
+           CR(0x41, state->extra);
+    }
+
+    if(CHANGED(repaint0))
+       CR(0x19, state->repaint0);
+    if(CHANGED(repaint1))
+       CR(0x1A, state->repaint1);
+    if(CHANGED(screen))
+       CR(0x25, state->screen);
+    if(CHANGED(pixel))
+       CR(0x28, state->pixel);
+    if(CHANGED(horiz))
+       CR(0x2D, state->horiz);
+    if(CHANGED(fifo))
+       CR(0x1C, state->fifo);
+    if(CHANGED(arbitration0))
+       CR(0x1B, state->arbitration0);
+    if(CHANGED(arbitration1)) {
+       CR(0x20, state->arbitration1);
+       if(hw->architecture >= NV_ARCH_30)
+         CR(0x47, state->arbitration1 >> 8);
+    }
+    CR(0x30, state->cursor0);
+    CR(0x31, state->cursor1);
+    CR(0x2F, state->cursor2);
+    if(CHANGED(interlace))
+       CR(0x39, state->interlace);
+
+    if(!hw->flatPanel) {
+       if(!pllsLoaded(hw, state)) {
+          if(hw->architecture >= NV_ARCH_40) {
+              WR(NV_STATE_PRAMDAC0, 0x0580, state->control);
+          }
+
+          WR(NV_STATE_PRAMDAC0, 0x050C, state->pllsel);
+          WR(NV_STATE_PRAMDAC0, 0x0508, state->vpll);
+          if(hw->twoHeads)
+             WR(NV_STATE_PRAMDAC0, 0x0520, state->vpll2);
+          if(hw->twoStagePLL) {
+             WR(NV_STATE_PRAMDAC0, 0x0578, state->vpllB);
+             WR(NV_STATE_PRAMDAC0, 0x057C, state->vpll2B);
+          }
+       }
+    } else {
+       WR(NV_STATE_PRAMDAC, 0x0848, state->scale);
+       if(CHANGED(crtcSync))
+          WR(NV_STATE_PRAMDAC, 0x0828, state->crtcSync);
+       if(CHANGED(crtcVSync))
+          WR(NV_STATE_PRAMDAC, 0x0808, state->crtcVSync);
+    }
+    if(CHANGED(general))
+       WR(NV_STATE_PRAMDAC, 0x0600, state->general);
+
+#undef CHANGED
+}
@@ -0,0 +1,81 @@
+#ifndef __NV_STATE_H__
+#define __NV_STATE_H__
+
+#include <stdint.h>
+
+#define NV_ARCH_04  0x04
+#define NV_ARCH_10  0x10
+#define NV_ARCH_20  0x20
+#define NV_ARCH_30  0x30
+#define NV_ARCH_40  0x40
+
+typedef struct _riva_hw_state
+{
+    uint32_t bpp;
+    uint32_t width;
+    uint32_t height;
+    uint32_t interlace;
+    uint32_t repaint0;
+    uint32_t repaint1;
+    uint32_t screen;
+    uint32_t scale;
+    uint32_t dither;
+    uint32_t extra;
+    uint32_t fifo;
+    uint32_t pixel;
+    uint32_t horiz;
+    uint32_t arbitration0;
+    uint32_t arbitration1;
+    uint32_t pll;
+    uint32_t pllB;
+    uint32_t vpll;
+    uint32_t vpll2;
+    uint32_t vpllB;
+    uint32_t vpll2B;
+    uint32_t pllsel;
+    uint32_t control;
+    uint32_t general;
+    uint32_t crtcOwner;
+    uint32_t head;
+    uint32_t head2;
+    uint32_t config;
+    uint32_t cursorConfig;
+    uint32_t cursor0;
+    uint32_t cursor1;
+    uint32_t cursor2;
+    uint32_t timingH;
+    uint32_t timingV;
+    uint32_t displayV;
+    uint32_t crtcSync;
+    uint32_t crtcVSync;
+} RIVA_HW_STATE, *NVRegPtr;
+
+/*
+ * The CRTC and RAMDAC half of NVLoadStateExt, in nv_state.c.  It only
+ * reaches the hardware through NVStateHW, so the driver points that at
+ * the mapped registers and anything else can stand in for them.
+ */
+enum {
+    NV_STATE_PCRTC,
+    NV_STATE_PRAMDAC,
+    NV_STATE_PRAMDAC0
+};
+
+typedef struct {
+    int architecture;
+    int chipset;
+    int flatPanel;
+    int twoHeads;
+    int twoStagePLL;
+    void *priv;
+    /* offsets are in bytes into one of the NV_STATE_* apertures */
+    uint32_t (*read)(void *priv, int aperture, int offset);
+    void (*write)(void *priv, int aperture, int offset, uint32_t value);
+    /* CRTC extension register through the VGA index and data ports */
+    void (*writeCR)(void *priv, int index, uint8_t value);
+} NVStateHW;
+
+void NVStateLoad(const NVStateHW *hw, const RIVA_HW_STATE *state,
+                 const RIVA_HW_STATE *old);
+
+#endif /* __NV_STATE_H__ */
@@ -6,11 +6,11 @@
 #include "xf86Cursor.h"
 #include "xf86int10.h"
 
-#define NV_ARCH_04  0x04
-#define NV_ARCH_10  0x10
-#define NV_ARCH_20  0x20
-#define NV_ARCH_30  0x30
-#define NV_ARCH_40  0x40
+#include "nv_state.h"
+
+#define NV_CURSOR_SLOTS 4
+#define NV_CURSOR_FRAMES 16
+#define NV_CURSOR_SLOT_SIZE (64 * 64 * 4)
 
 
 #define NV_BITMASK(t,b) (((unsigned)(1U << (((t)-(b)+1)))-1)  << (b))
@@ -21,6 +21,11 @@
 #define NV_SetBit(n) (1<<(n))
 #define NV_Set8Bits(value) ((value)&0xff)
 
+typedef enum AccelMethod {
+    XAA,
+    EXA,
+} AccelMethod;
+
 typedef struct {
     int bitsPerPixel;
     int depth;
@@ -29,54 +34,19 @@ typedef struct {
     DisplayModePtr mode;
 } NVFBLayout;
 
-typedef struct _riva_hw_state
-{
-    U032 bpp;
-    U032 width;
-    U032 height;
-    U032 interlace;
-    U032 repaint0;
-    U032 repaint1;
-    U032 screen;
-    U032 scale;
-    U032 dither;
-    U032 extra;
-    U032 fifo;
-    U032 pixel;
-    U032 horiz;
-    U032 arbitration0;
-    U032 arbitration1;
-    U032 pll;
-    U032 pllB;
-    U032 vpll;
-    U032 vpll2;
-    U032 vpllB;
-    U032 vpll2B;
-    U032 pllsel;
-    U032 control;
-    U032 general;
-    U032 crtcOwner;
-    U032 head;
-    U032 head2;
-    U032 config;
-    U032 cursorConfig;
-    U032 cursor0;
-    U032 cursor1;
-    U032 cursor2;
-    U032 timingH;
-    U032 timingV;
-    U032 displayV;
-    U032 crtcSync;
-    U032 crtcVSync;
-} RIVA_HW_STATE, *NVRegPtr;
 
 
 typedef struct {
     RIVA_HW_STATE       SavedReg;
     RIVA_HW_STATE       ModeReg;
     RIVA_HW_STATE       *CurrentState;
+    /* last state written by NVLoadStateExt, see nv_hw.c */
+    RIVA_HW_STATE       LoadedReg;
+    Bool                LoadedRegValid;
     CARD32              Architecture;
     CARD32              CursorStart;
+    CARD32              CursorOffset;
+    CARD32              CursorCacheStart;
     EntityInfoPtr       pEnt;
 #if XSERVER_LIBPCIACCESS
     struct pci_device  *PciInfo;
@@ -95,12 +65,31 @@ typedef struct {
     CARD32              FbUsableSize;
     CARD32              ScratchBufferSize;
     CARD32              ScratchBufferStart;
+    CARD32              FenceStart;
+    CARD32              fenceSeq;
+    CARD32              scratchFence;
+    CARD32              markFence;
     Bool                NoAccel;
+    AccelMethod         AccelMethod;
     Bool                HWCursor;
     Bool                FpScale;
     Bool                ShadowFB;
     unsigned char *     ShadowPtr;
     int                 ShadowPitch;
+    Bool                ShadowPacing;
+    RefreshAreaFuncPtr  ShadowRefresh;
+    RegionRec           ShadowDamage;
+    CARD32              ShadowFlushed;
+    int                 ShadowThreads;
+    struct _NVShadowPool *ShadowPool;
+    RefreshAreaFuncPtr  ShadowThreadedRefresh;
+    Bool                ShadowHash;
+    CARD64             *ShadowTileHash;
+    CARD32             *ShadowTileStamp;
+    BoxPtr              ShadowTileBoxes;
+    CARD32              ShadowTileGeneration;
+    int                 ShadowTilesX;
+    int                 ShadowTilesY;
     CARD32              MinVClockFreqKHz;
     CARD32              MaxVClockFreqKHz;
     CARD32              CrystalFreqKHz;
@@ -128,6 +117,7 @@ typedef struct {
 #ifdef HAVE_XAA_H
     XAAInfoRecPtr       AccelInfoRec;
 #endif
+    ExaDriverPtr        exa;
     xf86CursorInfoPtr   CursorInfoRec;
     DGAModePtr          DGAModes;
     int                 numDGAModes;
@@ -144,6 +134,16 @@ typedef struct {
     /* Cursor */
     CARD32              curFg, curBg;
     CARD32              curImage[256];
+    /* cursor image cache, see nv_cursor.c */
+    int                 curSlots;
+    int                 curFrames;
+    int                 curFrameNext;
+    int                 curFrameMisses;
+    int                 curSlot;
+    CARD64              curKey[NV_CURSOR_SLOTS + NV_CURSOR_FRAMES];
+    CARD32              curStamp[NV_CURSOR_SLOTS + NV_CURSOR_FRAMES];
+    CARD32              curClock;
+    CARD32              curLoadTime;
     /* I2C / DDC */
     I2CBusPtr           I2C;
     xf86Int10InfoPtr    pInt;
@@ -152,6 +152,7 @@ typedef struct {
     XF86VideoAdaptorPtr	overlayAdaptor;
     XF86VideoAdaptorPtr	blitAdaptor;
     int			videoKey;
+    int                 videoFreeDelay;
     int			FlatPanel;
     Bool                FPDither;
     Bool                Television;
@@ -175,6 +176,29 @@ typedef struct {
     CARD32              dmaFree;
     CARD32              dmaMax;
     CARD32              *dmaBase;
+    CARD32              dmaPixels;
+    CARD32              dmaIdleCheck;
+    CARD32              dmaOpenTag;
+    CARD32              dmaOpenHeader;
+    CARD32              dmaOpenEnd;
+    int                 dmaOpenSize;
+
+    /* kickoff statistics, logged at CloseScreen */
+    CARD32              statKickoffs;
+    CARD32              statKickoffDwords;
+    CARD32              statKickoffPixels;
+    CARD32              statKickoffIdle;
+    unsigned long       statDwords;
+    unsigned long       statTileHits;
+    unsigned long       statTileMisses;
+    unsigned long       statVideoAllocs;
+    unsigned long       statVideoGrows;
+    unsigned long       statVideoReuses;
+    unsigned long       statVideoPurges;
+    unsigned long       statVideoReleases;
+    unsigned long       statCursorHits;
+    unsigned long       statCursorMisses;
+    unsigned long       statCursorFrames;
 
     CARD32              currentRop;
     Bool                WaitVSyncPossible;
@@ -17,9 +17,9 @@
 
 #include "nv_include.h"
 #include "nv_dma.h"
+#include "nv_copy.h"
 
 #define OFF_DELAY 	500  /* milliseconds */
-#define FREE_DELAY 	5000
 
 #define OFF_TIMER 	0x01
 #define FREE_TIMER	0x02
@@ -29,6 +29,10 @@
 
 #define NUM_BLIT_PORTS 32
 
+/* blit ports cycle through this many upload buffers */
+#define MIN_BLIT_BUFFERS 2
+#define MAX_BLIT_BUFFERS 4
+
 typedef struct _NVPortPrivRec {
    short        brightness;
    short        contrast;
@@ -46,8 +50,13 @@ typedef struct _NVPortPrivRec {
    Bool         blitter;
    Bool         SyncToVBlank;
    FBLinearPtr  linear;
+   ExaOffscreenArea *area;
    int pitch;
    int offset;
+   int          numBuffers;
+   int          bufferSize;
+   CARD32       fence[MAX_BLIT_BUFFERS];
+   CARD32       fenced;
 } NVPortPrivRec, *NVPortPrivPtr;
 
 
@@ -88,14 +97,14 @@ static void NVInitOffscreenImages (ScreenPtr pScreen);
 #define GET_OVERLAY_PRIVATE(pNv) \
    (NVPortPrivPtr)((pNv)->overlayAdaptor->pPortPrivates[0].ptr)
 
-#define GET_BLIT_PRIVATE(pNv) \
-   (NVPortPrivPtr)((pNv)->blitAdaptor->pPortPrivates[0].ptr)
+#define GET_BLIT_PRIVATE(pNv, i) \
+   (NVPortPrivPtr)((pNv)->blitAdaptor->pPortPrivates[i].ptr)
 
 #define MAKE_ATOM(a) MakeAtom(a, sizeof(a) - 1, TRUE)
 
 static Atom xvBrightness, xvContrast, xvColorKey, xvSaturation, 
             xvHue, xvAutopaintColorKey, xvSetDefaults, xvDoubleBuffer,
-            xvITURBT709, xvSyncToVBlank;
+            xvITURBT709, xvSyncToVBlank, xvBufferCount;
 
 /* client libraries expect an encoding */
 static XF86VideoEncodingRec DummyEncoding =
@@ -128,10 +137,13 @@ XF86AttributeRec NVOverlayAttributes[NUM_OVERLAY_ATTRIBUTES] =
    {XvSettable | XvGettable, 0, 1, "XV_ITURBT_709"}
 };
 
-#define NUM_BLIT_ATTRIBUTES 2
+/* XV_SYNC_TO_VBLANK has to stay last, it's dropped without vblank waits */
+#define NUM_BLIT_ATTRIBUTES 3
 XF86AttributeRec NVBlitAttributes[NUM_BLIT_ATTRIBUTES] =
 {
    {XvSettable             , 0, 0, "XV_SET_DEFAULTS"},
+   {XvSettable | XvGettable, MIN_BLIT_BUFFERS, MAX_BLIT_BUFFERS,
+                                  "XV_BUFFER_COUNT"},
    {XvSettable | XvGettable, 0, 1, "XV_SYNC_TO_VBLANK"}
 };
 
@@ -218,68 +230,142 @@ NVStopOverlay (ScrnInfoPtr pScrnInfo)
     pNv->PMC[0x00008704/4] = 1;
 }
 
+/*
+ * Video memory is only ever grown while a port is in use and is given
+ * back once the port has been idle for pNv->videoFreeDelay.  Requests are
+ * rounded up to a multiple of the largest power of two no more than an
+ * eighth of their size, i.e. to 8 through 16 times a power of two.  That
+ * gives eight classes per doubling and wastes less than an eighth, while a
+ * stream changing size a little keeps its buffer.
+ */
+static int
+NVVideoSizeClass(int size)
+{
+   int step = 1;
+
+   while((step << 3) <= size)
+        step <<= 1;
+
+   return (size + step - 1) & ~(step - 1);
+}
+
 static FBLinearPtr
 NVAllocateOverlayMemory(
    ScrnInfoPtr pScrn,
    FBLinearPtr linear,
-   int size
+   int size,
+   int minSize
 ){
+   NVPtr pNv = NVPTR(pScrn);
    ScreenPtr pScreen;
    FBLinearPtr new_linear;
 
    if(linear) {
-        if(linear->size >= size) 
+        if(linear->size >= minSize) {
+           pNv->statVideoReuses++;
            return linear;
-        
-        if(xf86ResizeOffscreenLinear(linear, size))
+        }
+
+        if(xf86ResizeOffscreenLinear(linear, size)) {
+           pNv->statVideoGrows++;
            return linear;
+        }
 
         xf86FreeOffscreenLinear(linear);
    }
 
    pScreen = xf86ScrnToScreen(pScrn);
+   pNv->statVideoAllocs++;
 
    new_linear = xf86AllocateOffscreenLinear(pScreen, size, 32, 
                                                 NULL, NULL, NULL);
 
+   /* rather go without the slack than throw out the pixmap cache */
+   if(!new_linear && (minSize < size))
+        new_linear = xf86AllocateOffscreenLinear(pScreen, minSize, 32,
+                                                NULL, NULL, NULL);
+
    if(!new_linear) {
         int max_size;
 
         xf86QueryLargestOffscreenLinear(pScreen, &max_size, 32, 
                                                 PRIORITY_EXTREME);
         
-        if(max_size < size)
+        if(max_size < minSize)
            return NULL;
 
+        pNv->statVideoPurges++;
         xf86PurgeUnlockedOffscreenAreas(pScreen);
-        new_linear = xf86AllocateOffscreenLinear(pScreen, size, 32, 
+        new_linear = xf86AllocateOffscreenLinear(pScreen, minSize, 32, 
                                                 NULL, NULL, NULL);
    }
 
    return new_linear;
 }
 
-static void NVFreeOverlayMemory(ScrnInfoPtr pScrnInfo)
+/*
+ * Returns the byte offset of a buffer of at least size bytes for this
+ * port, or -1.  With EXA the offscreen memory belongs to EXA, so the
+ * buffer has to come from its allocator instead of the FB manager.
+ */
+static int
+NVAllocateVideoMemory(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv, int size)
 {
-    NVPtr               pNv   = NVPTR(pScrnInfo);
-    NVPortPrivPtr  pPriv   = GET_OVERLAY_PRIVATE(pNv);
+   NVPtr pNv = NVPTR(pScrn);
+   int bpp = pScrn->bitsPerPixel >> 3;
+   int classSize = NVVideoSizeClass(size);
 
-    if(pPriv->linear) {
-        xf86FreeOffscreenLinear(pPriv->linear);
-	pPriv->linear = NULL;
-    }
-}
+   if(pNv->exa) {
+        ScreenPtr pScreen = xf86ScrnToScreen(pScrn);
 
+        if(pPriv->area) {
+           if(pPriv->area->size >= size) {
+              pNv->statVideoReuses++;
+              return pPriv->area->offset;
+           }
+
+           exaOffscreenFree(pScreen, pPriv->area);
+        }
+
+        pNv->statVideoAllocs++;
+        pPriv->area = exaOffscreenAlloc(pScreen, classSize, 64, TRUE,
+                                        NULL, NULL);
+        if(!pPriv->area && (size < classSize))
+           pPriv->area = exaOffscreenAlloc(pScreen, size, 64, TRUE,
+                                           NULL, NULL);
+
+        return pPriv->area ? pPriv->area->offset : -1;
+   }
 
-static void NVFreeBlitMemory(ScrnInfoPtr pScrnInfo)
+   pPriv->linear = NVAllocateOverlayMemory(pScrn, pPriv->linear,
+                                           (classSize + bpp - 1) / bpp,
+                                           (size + bpp - 1) / bpp);
+
+   return pPriv->linear ? pPriv->linear->offset * bpp : -1;
+}
+
+static void
+NVFreeVideoMemory(ScrnInfoPtr pScrn, NVPortPrivPtr pPriv)
 {
-    NVPtr               pNv   = NVPTR(pScrnInfo);
-    NVPortPrivPtr  pPriv   = GET_BLIT_PRIVATE(pNv);
+    if(pPriv->linear || pPriv->area)
+        NVPTR(pScrn)->statVideoReleases++;
 
     if(pPriv->linear) {
         xf86FreeOffscreenLinear(pPriv->linear);
         pPriv->linear = NULL;
     }
+    if(pPriv->area) {
+        exaOffscreenFree(xf86ScrnToScreen(pScrn), pPriv->area);
+        pPriv->area = NULL;
+    }
+}
+
+static void NVFreeOverlayMemory(ScrnInfoPtr pScrnInfo)
+{
+    NVPtr               pNv   = NVPTR(pScrnInfo);
+    NVPortPrivPtr  pPriv   = GET_OVERLAY_PRIVATE(pNv);
+
+    NVFreeVideoMemory(pScrnInfo, pPriv);
 }
 
 
@@ -292,6 +378,8 @@ void NVInitVideo (ScreenPtr pScreen)
     NVPtr         	pNv   = NVPTR(pScrn);
     int 		num_adaptors;
 
+    NVCopyInit(1);
+
     if((pScrn->bitsPerPixel != 8) && (pNv->Architecture >= NV_ARCH_10) &&
          ((pNv->Architecture <= NV_ARCH_30) || 
             ((pNv->Chipset & 0xfff0) == 0x0040)))
@@ -348,7 +436,7 @@ NVSetupBlitVideo (ScreenPtr pScreen)
     int         i;
 
     if (!(adapt = calloc(1, sizeof(XF86VideoAdaptorRec) +
-                             sizeof(NVPortPrivRec) +
+                             (sizeof(NVPortPrivRec) * NUM_BLIT_PORTS) +
                              (sizeof(DevUnion) * NUM_BLIT_PORTS))))
     {
         return NULL;
@@ -364,17 +452,27 @@ NVSetupBlitVideo (ScreenPtr pScreen)
     adapt->nPorts               = NUM_BLIT_PORTS;
     adapt->pPortPrivates        = (DevUnion*)(&adapt[1]);
 
+    /* each port has its own buffer so clients don't wait on each other */
     pPriv = (NVPortPrivPtr)(&adapt->pPortPrivates[NUM_BLIT_PORTS]);
-    for(i = 0; i < NUM_BLIT_PORTS; i++)
-       adapt->pPortPrivates[i].ptr = (pointer)(pPriv);
+    for(i = 0; i < NUM_BLIT_PORTS; i++) {
+       adapt->pPortPrivates[i].ptr = (pointer)(&pPriv[i]);
+
+       pPriv[i].videoStatus     = 0;
+       pPriv[i].grabbedByV4L    = FALSE;
+       pPriv[i].blitter         = TRUE;
+       pPriv[i].doubleBuffer    = FALSE;
+       pPriv[i].SyncToVBlank    = pNv->WaitVSyncPossible;
+       pPriv[i].numBuffers      = MIN_BLIT_BUFFERS;
+       pPriv[i].bufferSize      = 0;
+       pPriv[i].currentBuffer   = 0;
+       pPriv[i].fenced          = 0;
+    }
 
-    if(pNv->WaitVSyncPossible) {
-       adapt->pAttributes          = NVBlitAttributes;
+    adapt->pAttributes          = NVBlitAttributes;
+    if(pNv->WaitVSyncPossible)
        adapt->nAttributes          = NUM_BLIT_ATTRIBUTES;
-    } else {
-       adapt->pAttributes          = NULL;
-       adapt->nAttributes          = 0;
-    }
+    else
+       adapt->nAttributes          = NUM_BLIT_ATTRIBUTES - 1;
     adapt->pImages              = NVImages;
     adapt->nImages              = NUM_IMAGES_ALL;
     adapt->PutVideo             = NULL;
@@ -388,15 +486,11 @@ NVSetupBlitVideo (ScreenPtr pScreen)
     adapt->PutImage             = NVPutImage;
     adapt->QueryImageAttributes = NVQueryImageAttributes;
 
-    pPriv->videoStatus          = 0;
-    pPriv->grabbedByV4L         = FALSE;
-    pPriv->blitter              = TRUE;
-    pPriv->doubleBuffer         = FALSE;
-    pPriv->SyncToVBlank         = pNv->WaitVSyncPossible;
-
     pNv->blitAdaptor            = adapt;
 
     xvSyncToVBlank              = MAKE_ATOM("XV_SYNC_TO_VBLANK");
+    xvBufferCount               = MAKE_ATOM("XV_BUFFER_COUNT");
+    xvSetDefaults               = MAKE_ATOM("XV_SET_DEFAULTS");
 
     return adapt;
 }
@@ -538,6 +632,7 @@ NVPutOverlayImage (
 static void
 NVPutBlitImage (
     ScrnInfoPtr pScrnInfo,
+    NVPortPrivPtr pPriv,
     int         offset,
     int         id,
     int         dstPitch,
@@ -556,7 +651,6 @@ NVPutBlitImage (
 )
 {
     NVPtr          pNv     = NVPTR(pScrnInfo);
-    NVPortPrivPtr  pPriv   = GET_BLIT_PRIVATE(pNv);
     BoxPtr         pbox    = REGION_RECTS(clipBoxes);
     int            nbox    = REGION_NUM_RECTS(clipBoxes);
     CARD32         dsdx, dtdy, size, point, srcpoint, format;
@@ -584,6 +678,17 @@ NVPutBlitImage (
         break;
     }
 
+    if(pNv->exa) {
+        /* EXA may have left the surfaces pointing at a pixmap */
+        CARD32 pitch = pNv->CurrentLayout.displayWidth *
+                       (pNv->CurrentLayout.bitsPerPixel >> 3);
+
+        NVDmaStart(pNv, SURFACE_PITCH, 3);
+        NVDmaNext (pNv, pitch | (pitch << 16));
+        NVDmaNext (pNv, 0);
+        NVDmaNext (pNv, 0);
+    }
+
     if(pNv->CurrentLayout.depth == 15) {
         NVDmaStart(pNv, SURFACE_FORMAT, 1);
         NVDmaNext (pNv, SURFACE_FORMAT_DEPTH15);
@@ -628,12 +733,22 @@ NVPutBlitImage (
         NVDmaNext (pNv, SURFACE_FORMAT_DEPTH16);
     }
 
+    /* this buffer may be written again once the fence has passed */
+    pPriv->fence[pPriv->currentBuffer] = NVEmitFence(pScrnInfo);
+    pPriv->fenced |= 1 << pPriv->currentBuffer;
+
     NVDmaKickoff(pNv);
+    if(pNv->exa) {
+        /* the port's fence covers everything queued so far */
+        pNv->markFence = pPriv->fence[pPriv->currentBuffer];
+        exaMarkSync(pScrnInfo->pScreen);
+    }
 #ifdef HAVE_XAA_H
-    SET_SYNC_FLAG(pNv->AccelInfoRec);
+    if(pNv->AccelInfoRec)
+        SET_SYNC_FLAG(pNv->AccelInfoRec);
 #endif
     pPriv->videoStatus = FREE_TIMER;
-    pPriv->videoTime = currentTime.milliseconds + FREE_DELAY;
+    pPriv->videoTime = currentTime.milliseconds + pNv->videoFreeDelay;
     pNv->VideoTimerCallback = NVVideoTimerCallback;
 }
 
@@ -779,6 +894,35 @@ static int NVGetOverlayPortAttribute
     return Success;
 }
 
+/*
+ * The blit buffers are laid out back to back in one allocation, so a new
+ * buffer size or count moves them around.  Wait for the blits still
+ * reading any of them and start over at the first one.
+ */
+static void
+NVIdleBlitBuffers(ScrnInfoPtr pScrnInfo, NVPortPrivPtr pPriv)
+{
+    int i;
+
+    for(i = 0; i < MAX_BLIT_BUFFERS; i++) {
+        if(pPriv->fenced & (1 << i))
+            NVWaitFence(pScrnInfo, pPriv->fence[i]);
+    }
+
+    pPriv->currentBuffer = 0;
+    pPriv->fenced = 0;
+}
+
+static void
+NVSetBlitBufferCount(ScrnInfoPtr pScrnInfo, NVPortPrivPtr pPriv, int count)
+{
+    if(count == pPriv->numBuffers)
+        return;
+
+    NVIdleBlitBuffers(pScrnInfo, pPriv);
+    pPriv->numBuffers = count;
+}
+
 static int NVSetBlitPortAttribute
 (
     ScrnInfoPtr pScrnInfo,
@@ -795,8 +939,14 @@ static int NVSetBlitPortAttribute
             return BadValue;
         pPriv->SyncToVBlank = value;
     } else
+    if (attribute == xvBufferCount) {
+        if ((value < MIN_BLIT_BUFFERS) || (value > MAX_BLIT_BUFFERS))
+            return BadValue;
+        NVSetBlitBufferCount(pScrnInfo, pPriv, value);
+    } else
     if (attribute == xvSetDefaults) {
         pPriv->SyncToVBlank = pNv->WaitVSyncPossible;
+        NVSetBlitBufferCount(pScrnInfo, pPriv, MIN_BLIT_BUFFERS);
     } else
        return BadMatch;
 
@@ -815,6 +965,8 @@ static int NVGetBlitPortAttribute
 
     if(attribute == xvSyncToVBlank)
        *value = (pPriv->SyncToVBlank) ? 1 : 0;
+    else if(attribute == xvBufferCount)
+       *value = pPriv->numBuffers;
     else
        return BadMatch;
 
@@ -847,139 +999,6 @@ static void NVQueryBestSize
     *p_h = drw_h; 
 }
 
-static void NVCopyData420
-(
-    unsigned char *src1,
-    unsigned char *src2,
-    unsigned char *src3,
-    unsigned char *dst1,
-    int            srcPitch,
-    int            srcPitch2,
-    int            dstPitch,
-    int            h,
-    int            w
-)
-{
-   CARD32 *dst;
-   CARD8 *s1, *s2, *s3;
-   int i, j;
-
-   w >>= 1;
-
-   for(j = 0; j < h; j++) {
-        dst = (CARD32*)dst1;
-        s1 = src1;  s2 = src2;  s3 = src3;
-        i = w;
-        while(i > 4) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-           dst[0] = (s1[0] << 24) | (s1[1] << 8) | (s3[0] << 16) | s2[0];
-           dst[1] = (s1[2] << 24) | (s1[3] << 8) | (s3[1] << 16) | s2[1];
-           dst[2] = (s1[4] << 24) | (s1[5] << 8) | (s3[2] << 16) | s2[2];
-           dst[3] = (s1[6] << 24) | (s1[7] << 8) | (s3[3] << 16) | s2[3];
-#else
-           dst[0] = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
-           dst[1] = s1[2] | (s1[3] << 16) | (s3[1] << 8) | (s2[1] << 24);
-           dst[2] = s1[4] | (s1[5] << 16) | (s3[2] << 8) | (s2[2] << 24);
-           dst[3] = s1[6] | (s1[7] << 16) | (s3[3] << 8) | (s2[3] << 24);
-#endif
-           dst += 4; s2 += 4; s3 += 4; s1 += 8;
-           i -= 4;
-        }
-
-        while(i--) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-           dst[0] = (s1[0] << 24) | (s1[1] << 8) | (s3[0] << 16) | s2[0];
-#else
-           dst[0] = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
-#endif
-           dst++; s2++; s3++;
-           s1 += 2;
-        }
-
-        dst1 += dstPitch;
-        src1 += srcPitch;
-        if(j & 1) {
-            src2 += srcPitch2;
-            src3 += srcPitch2;
-        }
-   }
-}
-
-
-static void NVMoveDWORDS(
-   CARD32* dest,
-   CARD32* src,
-   int dwords )
-{
-     while(dwords & ~0x03) {
-        *dest = *src;
-        *(dest + 1) = *(src + 1);
-        *(dest + 2) = *(src + 2);
-        *(dest + 3) = *(src + 3);
-        src += 4;
-        dest += 4;
-        dwords -= 4;
-     }
-     if(!dwords) return;
-     *dest = *src;
-     if(dwords == 1) return;
-     *(dest + 1) = *(src + 1);
-     if(dwords == 2) return;
-     *(dest + 2) = *(src + 2);
-}
-
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-static void NVMoveDWORDSSwapped(
-   CARD32* dest,
-   CARD8* src,
-   int dwords )
-{
-     while(dwords--) {
-        *dest++ = (src[3] << 24) | (src[2] << 16) | (src[1] << 8) | src[0];
-        src += 4;
-     }
-}
-#endif
-
-static void NVCopyData422
-(
-  unsigned char *src,
-  unsigned char *dst,
-  int            srcPitch,
-  int            dstPitch,
-  int            h,
-  int            w
-)
-{
-    w >>= 1;  /* pixels to DWORDS */
-    while(h--) {
-        NVMoveDWORDS((CARD32*)dst, (CARD32*)src, w);
-        src += srcPitch;
-        dst += dstPitch;
-    }
-}
-
-static void NVCopyDataRGB
-(
-  unsigned char *src,
-  unsigned char *dst,
-  int            srcPitch,
-  int            dstPitch,
-  int            h,
-  int            w
-)
-{
-    while(h--) {
-#if X_BYTE_ORDER == X_BIG_ENDIAN
-        NVMoveDWORDSSwapped((CARD32*)dst, (CARD8*)src, w);
-#else
-        NVMoveDWORDS((CARD32*)dst, (CARD32*)src, w);
-#endif
-        src += srcPitch;
-        dst += dstPitch;
-    }
-}
-
 
 /*
  * PutImage
@@ -1087,17 +1106,30 @@ static int NVPutImage
 
     newSize = height * dstPitch / bpp;
 
-    if(pPriv->doubleBuffer)
+    if(pPriv->blitter && (pPriv->bufferSize != newSize)) {
+        NVIdleBlitBuffers(pScrnInfo, pPriv);
+        pPriv->bufferSize = newSize;
+    }
+
+    if(pPriv->blitter)
+	newSize *= pPriv->numBuffers;
+    else if(pPriv->doubleBuffer)
 	newSize <<= 1;
 
-    pPriv->linear = NVAllocateOverlayMemory(pScrnInfo, 
-					    pPriv->linear, 
-					    newSize);
+    offset = NVAllocateVideoMemory(pScrnInfo, pPriv, newSize * bpp);
+
+    if(offset < 0) return BadAlloc;
 
-    if(!pPriv->linear) return BadAlloc;
+    if(pPriv->blitter) {
+        int buffer = pPriv->currentBuffer;
 
-    offset = pPriv->linear->offset * bpp;
+        /* only wait for the blit that last read this buffer, the ones out
+           of the other buffers can go on while we copy */
+        if(pPriv->fenced & (1 << buffer))
+            NVWaitFence(pScrnInfo, pPriv->fence[buffer]);
 
+        offset += buffer * pPriv->bufferSize * bpp;
+    } else
     if(pPriv->doubleBuffer) {
         int mask = 1 << (pPriv->currentBuffer << 2);
 
@@ -1130,8 +1162,6 @@ static int NVPutImage
     bottom = (yb + 0x0001ffff) >> 16;
     if(bottom > height) bottom = height;
 
-    if(pPriv->blitter) NVSync(pScrnInfo);
-
     switch(id) {
     case FOURCC_YV12:
     case FOURCC_I420:
@@ -1182,10 +1212,12 @@ static int NVPutImage
 
     if(!skip) {
        if(pPriv->blitter) {
-            NVPutBlitImage(pScrnInfo, offset, id, dstPitch, &dstBox,
+            NVPutBlitImage(pScrnInfo, pPriv, offset, id, dstPitch, &dstBox,
                            xa, ya, xb, yb,
                            width, height, src_w, src_h, drw_w, drw_h,
                            clipBoxes);
+            pPriv->currentBuffer = (pPriv->currentBuffer + 1) %
+                                   pPriv->numBuffers;
        } else {
             NVPutOverlayImage(pScrnInfo, offset, id, dstPitch, &dstBox, 
                              xa, ya, xb, yb,
@@ -1269,8 +1301,9 @@ static void NVVideoTimerCallback
 {
     NVPtr         pNv = NVPTR(pScrnInfo);
     NVPortPrivPtr pOverPriv = NULL;
-    NVPortPrivPtr pBlitPriv = NULL;
+    NVPortPrivPtr pBlitPriv;
     Bool needCallback = FALSE;
+    int i;
 
     if(!pScrnInfo->vtSema) return; 
 
@@ -1280,18 +1313,13 @@ static void NVVideoTimerCallback
 	   pOverPriv = NULL;
     }
 
-    if(pNv->blitAdaptor) {
-        pBlitPriv = GET_BLIT_PRIVATE(pNv);
-        if(!pBlitPriv->videoStatus)
-           pBlitPriv = NULL;
-    }
    
     if(pOverPriv) {
          if(pOverPriv->videoTime < currentTime) {
 	    if(pOverPriv->videoStatus & OFF_TIMER) {
 		NVStopOverlay(pScrnInfo);
 		pOverPriv->videoStatus = FREE_TIMER;
-                pOverPriv->videoTime = currentTime + FREE_DELAY;
+                pOverPriv->videoTime = currentTime + pNv->videoFreeDelay;
                 needCallback = TRUE;
 	    } else
             if(pOverPriv->videoStatus & FREE_TIMER) {
@@ -1303,10 +1331,17 @@ static void NVVideoTimerCallback
          }
     }
 
-    if(pBlitPriv) {
+    for(i = 0; pNv->blitAdaptor && (i < NUM_BLIT_PORTS); i++) {
+        pBlitPriv = GET_BLIT_PRIVATE(pNv, i);
+        if(!pBlitPriv->videoStatus)
+            continue;
+
         if(pBlitPriv->videoTime < currentTime) {
-            NVFreeBlitMemory(pScrnInfo);
-            pBlitPriv->videoStatus = 0;              
+            NVFreeVideoMemory(pScrnInfo, pBlitPriv);
+            pBlitPriv->videoStatus = 0;
+            pBlitPriv->currentBuffer = 0;
+            pBlitPriv->fenced = 0;
+            pBlitPriv->bufferSize = 0;
         } else {
             needCallback = TRUE;
         }
@@ -1342,12 +1377,9 @@ NVAllocSurface (
     pPriv->pitch = ((w << 1) + 63) & ~63;
     size = h * pPriv->pitch / bpp;
 
-    pPriv->linear = NVAllocateOverlayMemory(pScrnInfo, pPriv->linear,
-					    size);
-
-    if(!pPriv->linear) return BadAlloc;
+    pPriv->offset = NVAllocateVideoMemory(pScrnInfo, pPriv, size * bpp);
 
-    pPriv->offset = pPriv->linear->offset * bpp;
+    if(pPriv->offset < 0) return BadAlloc;
 
     surface->width = w;
     surface->height = h;
@@ -92,13 +92,51 @@ static const int NVPatternROP[16] =
    0xFF
 };
 
+/* Budgets for NVDmaAutoKickoff */
+#define KICKOFF_DWORDS      512
+#define KICKOFF_PIXELS      (128 * 128)
+#define KICKOFF_IDLE_DWORDS 32
+
 void
 NVDmaKickoff(NVPtr pNv)
 {
     if(pNv->dmaCurrent != pNv->dmaPut) {
+        pNv->statKickoffs++;
+        pNv->statDwords += pNv->dmaCurrent - pNv->dmaPut;
         pNv->dmaPut = pNv->dmaCurrent;
         WRITE_PUT(pNv,  pNv->dmaPut);
     }
+    pNv->dmaOpenTag = 0;
+    pNv->dmaPixels = 0;
+    pNv->dmaIdleCheck = pNv->dmaPut + KICKOFF_IDLE_DWORDS;
+}
+
+/* Called after queueing an operation touching "pixels" pixels.  Submits
+   once enough pushbuffer space or pixel work has piled up, or early if
+   the FIFO has already drained so the engine doesn't sit idle while we
+   batch.  GET is only polled every KICKOFF_IDLE_DWORDS since reading it
+   is not free.  Anything left goes out from the BlockHandler. */
+void
+NVDmaAutoKickoff(NVPtr pNv, int pixels)
+{
+    const CARD32 queued = pNv->dmaCurrent - pNv->dmaPut;
+
+    pNv->dmaPixels += pixels;
+
+    if(queued >= KICKOFF_DWORDS) {
+        pNv->statKickoffDwords++;
+    } else if(pNv->dmaPixels >= KICKOFF_PIXELS) {
+        pNv->statKickoffPixels++;
+    } else if(pNv->dmaCurrent >= pNv->dmaIdleCheck) {
+        pNv->dmaIdleCheck = pNv->dmaCurrent + KICKOFF_IDLE_DWORDS;
+        if(READ_GET(pNv) != pNv->dmaPut)
+            return;
+        pNv->statKickoffIdle++;
+    } else {
+        return;
+    }
+
+    NVDmaKickoff(pNv);
 }
 
 
@@ -132,6 +170,8 @@ NVDmaWait (
                }
                WRITE_PUT(pNv, SKIPS);
                pNv->dmaCurrent = pNv->dmaPut = SKIPS;
+               pNv->dmaOpenTag = 0;
+               pNv->dmaIdleCheck = SKIPS + KICKOFF_IDLE_DWORDS;
                pNv->dmaFree = dmaGet - (SKIPS + 1);
            }
        } else 
@@ -139,6 +179,49 @@ NVDmaWait (
     }
 }
 
+/* Runs of the same method array are merged into one packet: if the last
+   thing in the pushbuffer is a packet for "tag" that hasn't been submitted
+   yet, its header is patched to take "size" more dwords of data, up to
+   "max" in total.  Any other method, a kickoff or a wrap of the buffer
+   ends the packet.  Returns FALSE if a new packet has to be started. */
+static Bool
+NVDmaExtend(NVPtr pNv, CARD32 tag, int size, int max)
+{
+    if((pNv->dmaOpenTag != tag) ||
+       (pNv->dmaCurrent != pNv->dmaOpenEnd) ||
+       (pNv->dmaOpenSize + size > max) ||
+       (pNv->dmaFree <= size))
+        return FALSE;
+
+    pNv->dmaOpenSize += size;
+    pNv->dmaOpenEnd += size;
+    pNv->dmaBase[pNv->dmaOpenHeader] = (pNv->dmaOpenSize << 18) | tag;
+    pNv->dmaFree -= size;
+    return TRUE;
+}
+
+static void
+NVDmaOpen(NVPtr pNv, CARD32 tag, int size)
+{
+    NVDmaStart(pNv, tag, size);
+    pNv->dmaOpenTag = tag;
+    pNv->dmaOpenHeader = pNv->dmaCurrent - 1;
+    pNv->dmaOpenSize = size;
+    pNv->dmaOpenEnd = pNv->dmaCurrent + size;
+}
+
+/* Queue a solid rectangle with the current color and ROP, two dwords per
+   rectangle when it continues a run of fills. */
+void
+NVDmaSolidRect(NVPtr pNv, int x, int y, int w, int h)
+{
+    if(!NVDmaExtend(pNv, RECT_SOLID_RECTS(0), 2,
+                    RECT_SOLID_RECTS_MAX_RECTS * 2))
+        NVDmaOpen(pNv, RECT_SOLID_RECTS(0), 2);
+    NVDmaNext (pNv, (x << 16) | y);
+    NVDmaNext (pNv, (w << 16) | h);
+}
+
 void
 NVWaitVSync(NVPtr pNv)
 {
@@ -176,7 +259,7 @@ NVSetPattern(
     NVDmaNext (pNv, pat1);
 }
 
-static void 
+void
 NVSetRopSolid(ScrnInfoPtr pScrn, CARD32 rop, CARD32 planemask)
 {
     NVPtr pNv = NVPTR(pScrn);
@@ -198,6 +281,114 @@ NVSetRopSolid(ScrnInfoPtr pScrn, CARD32 rop, CARD32 planemask)
     }
 }
 
+/*
+ * Fences.  A fence is a handful of one pixel fills that write an
+ * increasing sequence number into the pixels at FenceStart.  The engine
+ * runs its commands in order, so once the number has landed everything
+ * emitted before it is done and we don't need to wait for the whole
+ * queue to drain.  The surface only stores "depth" bits per pixel, so
+ * the number is spread over several pixels, lowest bits first.
+ */
+static void
+NVWriteFence(NVPtr pNv, CARD32 fence)
+{
+    const int depth = pNv->CurrentLayout.depth;
+    const int Bpp = pNv->CurrentLayout.bitsPerPixel >> 3;
+    volatile unsigned char *p = pNv->FbStart + pNv->FenceStart;
+    int shift;
+
+    for(shift = 0; shift < 32; shift += depth, p += Bpp) {
+        switch(Bpp) {
+        case 1:  *p = fence >> shift; break;
+        case 2:  *(volatile CARD16*)p = fence >> shift; break;
+        default: *(volatile CARD32*)p = fence >> shift; break;
+        }
+    }
+}
+
+/* Read the highest bits first.  The engine writes the lowest ones first,
+   so a fence caught halfway through being written never reads as more
+   than what has actually passed. */
+static CARD32
+NVReadFence(NVPtr pNv)
+{
+    const int depth = pNv->CurrentLayout.depth;
+    const int Bpp = pNv->CurrentLayout.bitsPerPixel >> 3;
+    const CARD32 mask = (1 << depth) - 1;
+    const int chunks = (32 + depth - 1) / depth;
+    volatile unsigned char *p = pNv->FbStart + pNv->FenceStart;
+    CARD32 fence = 0, pixel;
+    int i;
+
+    for(i = chunks - 1; i >= 0; i--) {
+        switch(Bpp) {
+        case 1:  pixel = p[i]; break;
+        case 2:  pixel = ((volatile CARD16*)p)[i]; break;
+        default: pixel = ((volatile CARD32*)p)[i]; break;
+        }
+        fence |= (pixel & mask) << (i * depth);
+    }
+
+    return fence;
+}
+
+CARD32
+NVEmitFence(ScrnInfoPtr pScrn)
+{
+    NVPtr pNv = NVPTR(pScrn);
+    const int depth = pNv->CurrentLayout.depth;
+    const CARD32 mask = (1 << depth) - 1;
+    const CARD32 fence = ++pNv->fenceSeq;
+    int pitch, i, shift;
+
+    pitch = pNv->CurrentLayout.displayWidth *
+            (pNv->CurrentLayout.bitsPerPixel >> 3);
+
+    NVDmaStart(pNv, SURFACE_PITCH, 3);
+    NVDmaNext (pNv, pitch | (256 << 16));
+    NVDmaNext (pNv, 0);
+    NVDmaNext (pNv, pNv->FenceStart);
+    NVSetRopSolid(pScrn, GXcopy, ~0);
+
+    for(i = 0, shift = 0; shift < 32; i++, shift += depth) {
+        NVDmaStart(pNv, RECT_SOLID_COLOR, 1);
+        NVDmaNext (pNv, (fence >> shift) & mask);
+        NVDmaStart(pNv, RECT_SOLID_RECTS(0), 2);
+        NVDmaNext (pNv, i << 16);
+        NVDmaNext (pNv, (1 << 16) | 1);
+    }
+
+    /* back to the screen, which is what XAA and Xv expect */
+    NVDmaStart(pNv, SURFACE_PITCH, 3);
+    NVDmaNext (pNv, pitch | (pitch << 16));
+    NVDmaNext (pNv, 0);
+    NVDmaNext (pNv, 0);
+
+    pNv->DMAKickoffCallback = NVDMAKickoffCallback;
+    return fence;
+}
+
+Bool
+NVFencePassed(NVPtr pNv, CARD32 fence)
+{
+    return (INT32)(NVReadFence(pNv) - fence) >= 0;
+}
+
+void
+NVWaitFence(ScrnInfoPtr pScrn, CARD32 fence)
+{
+    NVPtr pNv = NVPTR(pScrn);
+
+    if(NVFencePassed(pNv, fence))
+        return;
+
+    if(pNv->DMAKickoffCallback)
+       (*pNv->DMAKickoffCallback)(pScrn);
+    NVDmaKickoff(pNv);
+
+    while(!NVFencePassed(pNv, fence));
+}
+
 void NVResetGraphics(ScrnInfoPtr pScrn)
 {
     NVPtr pNv = NVPTR(pScrn);
@@ -232,6 +423,7 @@ void NVResetGraphics(ScrnInfoPtr pScrn)
     pNv->dmaBase[0xF + SKIPS] = 0x80000017;
 
     pNv->dmaPut = 0;
+    pNv->dmaOpenTag = 0;
     pNv->dmaCurrent = 16 + SKIPS;
     pNv->dmaMax = 8191;
     pNv->dmaFree = pNv->dmaMax - pNv->dmaCurrent;
@@ -276,6 +468,9 @@ void NVResetGraphics(ScrnInfoPtr pScrn)
     pNv->currentRop = ~0;  /* set to something invalid */
     NVSetRopSolid(pScrn, GXcopy, ~0);
 
+    /* nothing from before the reset is still pending */
+    NVWriteFence(pNv, pNv->fenceSeq);
+
     NVDmaKickoff(pNv);
 }
 
@@ -291,7 +486,7 @@ void NVSync(ScrnInfoPtr pScrn)
     while(pNv->PGRAPH[0x0700/4]);
 }
 
-static void
+void
 NVDMAKickoffCallback (ScrnInfoPtr pScrn)
 {
    NVPtr pNv = NVPTR(pScrn);
@@ -334,8 +529,7 @@ NVSubsequentScreenToScreenCopy(
     NVDmaNext (pNv, (y2 << 16) | x2);
     NVDmaNext (pNv, (h  << 16) | w);
 
-    if((w * h) >= 512)
-       NVDmaKickoff(pNv); 
+    NVDmaAutoKickoff(pNv, w * h);
 }
 
 static void
@@ -362,12 +556,9 @@ NVSubsequentSolidFillRect(ScrnInfoPtr pScrn, int x, int y, int w, int h)
 {
    NVPtr pNv = NVPTR(pScrn);
 
-   NVDmaStart(pNv, RECT_SOLID_RECTS(0), 2);
-   NVDmaNext (pNv, (x << 16) | y);
-   NVDmaNext (pNv, (w << 16) | h);
+   NVDmaSolidRect(pNv, x, y, w, h);
 
-   if((w * h) >= 512)
-      NVDmaKickoff(pNv);
+   NVDmaAutoKickoff(pNv, w * h);
 }
 
 static void
@@ -410,12 +601,9 @@ NVSubsequentMono8x8PatternFillRect(
 {
    NVPtr pNv = NVPTR(pScrn);
 
-   NVDmaStart(pNv, RECT_SOLID_RECTS(0), 2);
-   NVDmaNext (pNv, (x << 16) | y);
-   NVDmaNext (pNv, (w << 16) | h);
+   NVDmaSolidRect(pNv, x, y, w, h);
 
-   if((w * h) >= 512)
-      NVDmaKickoff(pNv);
+   NVDmaAutoKickoff(pNv, w * h);
 }
 
 static CARD32 _bg_pixel;
@@ -507,6 +695,9 @@ NVSubsequentColorExpandScanline(ScrnInfoPtr pScrn, int bufno)
    }
 }
 
+static int _image_rop;
+static CARD32 _image_planemask;
+
 static void 
 NVSetupForScanlineImageWrite(
    ScrnInfoPtr pScrn, int rop, 
@@ -520,12 +711,43 @@ NVSetupForScanlineImageWrite(
    planemask |= ~0 << pNv->CurrentLayout.depth;
 
    NVSetRopSolid (pScrn, rop, planemask);
+   _image_rop = rop;
+   _image_planemask = planemask;
 }
 
+/* The scratch area is carved into a ring of scanline slots so that the
+   CPU can fill the next lines while the engine is still blitting the
+   previous ones.  XAA looks up ScanlineImageWriteBuffers[bufno] before
+   every line, so we just point all of them at the next free slot.
+   The ring is split in two halves and a fence goes in after the last
+   line of each, so the CPU only waits when it comes back around to a
+   half the engine may still be reading. */
+#define NV_IMAGE_BUFFERS  2
+#define NV_IMAGE_SLOTS    16
+
 static CARD32 _image_size;
 static CARD32 _image_srcpoint;
 static CARD32 _image_dstpoint;
 static CARD32 _image_dstpitch;
+static CARD32 _image_srcpitch;
+static int _image_half;
+static int _image_slot;
+static int _image_fenced;
+static CARD32 _image_half_fence[2];
+static unsigned char *_image_buffer[NV_IMAGE_BUFFERS];
+
+static void
+NVSetImageBuffer(ScrnInfoPtr pScrn, int slot)
+{
+   NVPtr pNv = NVPTR(pScrn);
+   unsigned char *ptr;
+   int i;
+
+   ptr = pNv->FbStart + pNv->ScratchBufferStart + (slot * _image_srcpitch);
+
+   for(i = 0; i < NV_IMAGE_BUFFERS; i++)
+      _image_buffer[i] = ptr;
+}
 
 static void 
 NVSubsequentScanlineImageWriteRect(
@@ -537,43 +759,91 @@ NVSubsequentScanlineImageWriteRect(
 {
    NVPtr pNv = NVPTR(pScrn);
    int Bpp = pNv->CurrentLayout.bitsPerPixel >> 3;
-   int image_srcpitch;
+   int slots;
 
    _image_size = (1 << 16) | (w - skipleft);
    _image_srcpoint = skipleft;
    _image_dstpoint = (y << 16) | (x + skipleft);
    _remaining = h;
    _image_dstpitch = pNv->CurrentLayout.displayWidth * Bpp;
-   image_srcpitch =  ((w * Bpp) + 63) & ~63;
-   _storage_buffer[0] = pNv->FbStart + pNv->ScratchBufferStart;
+   _image_srcpitch =  ((w * Bpp) + 63) & ~63;
+
+   slots = pNv->ScratchBufferSize / _image_srcpitch;
+   if(slots > NV_IMAGE_SLOTS)
+      slots = NV_IMAGE_SLOTS;
+   _image_half = slots >> 1;
+   _image_slot = 0;
+   _image_fenced = 0;
+
+   NVSetImageBuffer(pScrn, 0);
 
-   NVSync(pScrn);
+   /* the last rect fenced its final line, so once that has passed
+      nothing reads the scratch area any more */
+   NVWaitFence(pScrn, pNv->scratchFence);
 
    NVDmaStart(pNv, SURFACE_PITCH, 2);
-   NVDmaNext (pNv, (_image_dstpitch << 16) | image_srcpitch);
+   NVDmaNext (pNv, (_image_dstpitch << 16) | _image_srcpitch);
    NVDmaNext (pNv, pNv->ScratchBufferStart);
 }
 
 static void NVSubsequentImageWriteScanline(ScrnInfoPtr pScrn, int bufno)
 {
    NVPtr pNv = NVPTR(pScrn);
+   int half;
 
    NVDmaStart(pNv, BLIT_POINT_SRC, 3);
-   NVDmaNext (pNv, _image_srcpoint);
+   NVDmaNext (pNv, (_image_slot << 16) | _image_srcpoint);
    NVDmaNext (pNv, _image_dstpoint);
    NVDmaNext (pNv, _image_size);
-   NVDmaKickoff(pNv);
 
    if(--_remaining) {
       _image_dstpoint += (1 << 16);
-      NVSync(pScrn);
+
+      if(!_image_half) {
+         NVDmaKickoff(pNv);
+         NVSync(pScrn);
+         return;
+      }
+
+      if(++_image_slot == (_image_half << 1))
+         _image_slot = 0;
+
+      if(!(_image_slot % _image_half)) {
+         /* That was the last line of a half.  The FIFO having fetched
+            its blits doesn't mean the engine has read the slots yet,
+            so fence them.  The fence leaves the surfaces and ROP
+            pointing at the screen. */
+         half = _image_slot ? 0 : 1;
+         _image_half_fence[half] = NVEmitFence(pScrn);
+         _image_fenced |= 1 << half;
+         NVSetRopSolid(pScrn, _image_rop, _image_planemask);
+         NVDmaStart(pNv, SURFACE_PITCH, 2);
+         NVDmaNext (pNv, (_image_dstpitch << 16) | _image_srcpitch);
+         NVDmaNext (pNv, pNv->ScratchBufferStart);
+         NVDmaKickoff(pNv);
+
+         half ^= 1;
+         if(_image_fenced & (1 << half))
+            NVWaitFence(pScrn, _image_half_fence[half]);
+      }
+
+      NVSetImageBuffer(pScrn, _image_slot);
    } else {
-      NVDmaStart(pNv, SURFACE_PITCH, 2);
-      NVDmaNext (pNv, _image_dstpitch | (_image_dstpitch << 16));
-      NVDmaNext (pNv, 0);
+      /* also puts the surfaces back on the screen */
+      pNv->scratchFence = NVEmitFence(pScrn);
+      NVDmaKickoff(pNv);
    }
 }
 
+/* Queue lines with the current color and ROP, up to LINE_MAX_LINES
+   to a packet. */
+static void
+NVDmaLines(NVPtr pNv, int size)
+{
+    if(!NVDmaExtend(pNv, LINE_LINES(0), size, LINE_MAX_LINES * 2))
+        NVDmaOpen(pNv, LINE_LINES(0), size);
+}
+
 static void
 NVSetupForSolidLine(ScrnInfoPtr pScrn, int color, int rop, unsigned planemask)
 {
@@ -582,8 +852,8 @@ NVSetupForSolidLine(ScrnInfoPtr pScrn, int color, int rop, unsigned planemask)
     planemask |= ~0 << pNv->CurrentLayout.depth;
 
     NVSetRopSolid(pScrn, rop, planemask);
-
-    _fg_pixel = color;
+    NVDmaStart(pNv, LINE_COLOR, 1);
+    NVDmaNext (pNv, color);
 
     pNv->DMAKickoffCallback = NVDMAKickoffCallback;
 }
@@ -593,9 +863,7 @@ NVSubsequentSolidHorVertLine(ScrnInfoPtr pScrn, int x, int y, int len, int dir)
 {
     NVPtr pNv = NVPTR(pScrn);
 
-    NVDmaStart(pNv, LINE_COLOR, 1);
-    NVDmaNext (pNv, _fg_pixel);
-    NVDmaStart(pNv, LINE_LINES(0), 2);
+    NVDmaLines(pNv, 2);
     NVDmaNext (pNv, (y << 16) | ( x & 0xffff));
     if(dir == DEGREES_0) {
        NVDmaNext (pNv, (y << 16) | ((x + len) & 0xffff));
@@ -615,9 +883,7 @@ NVSubsequentSolidTwoPointLine(
     NVPtr pNv = NVPTR(pScrn);
     Bool drawLast = !(flags & OMIT_LAST);
 
-    NVDmaStart(pNv, LINE_COLOR, 1);
-    NVDmaNext (pNv, _fg_pixel);
-    NVDmaStart(pNv, LINE_LINES(0), drawLast ? 4 : 2);
+    NVDmaLines(pNv, drawLast ? 4 : 2);
     NVDmaNext (pNv, (y1 << 16) | (x1 & 0xffff));
     NVDmaNext (pNv, (y2 << 16) | (x2 & 0xffff));
     if(drawLast) {
@@ -697,11 +963,11 @@ NVAccelInit(ScreenPtr pScreen)
                                     NO_TRANSPARENCY |
                                     LEFT_EDGE_CLIPPING |
                                     LEFT_EDGE_CLIPPING_NEGATIVE_X;
-   accel->NumScanlineImageWriteBuffers = 1;
+   accel->NumScanlineImageWriteBuffers = NV_IMAGE_BUFFERS;
    accel->SetupForScanlineImageWrite = NVSetupForScanlineImageWrite;
    accel->SubsequentScanlineImageWriteRect = NVSubsequentScanlineImageWriteRect;
    accel->SubsequentImageWriteScanline = NVSubsequentImageWriteScanline;
-   accel->ScanlineImageWriteBuffers = _storage_buffer;
+   accel->ScanlineImageWriteBuffers = _image_buffer;
 
    accel->SolidLineFlags = 0;
    accel->SetupForSolidLine = NVSetupForSolidLine;
@@ -31,36 +31,33 @@
 
 #include "cursorstr.h"
 
+#include "nv_mono.h"
+
 /****************************************************************************\
 *                                                                            *
 *                          HW Cursor Entrypoints                             *
 *                                                                            *
 \****************************************************************************/
 
-#define TRANSPARENT_PIXEL   0
-
 #define ConvertToRGB555(c) \
 (((c & 0xf80000) >> 9 ) | ((c & 0xf800) >> 6 ) | ((c & 0xf8) >> 3 ) | 0x8000)
 
 
 static void 
-RivaConvertCursor1555(RivaPtr pRiva, CARD32 *src, CARD16 *dst)
+RivaConvertCursor1555(RivaPtr pRiva, CARD32 *src, volatile U032 *dst)
 {
-    CARD32 b, m;
+    union {
+        CARD16 pixels[32];
+        CARD32 dwords[16];
+    } line;
     int i, j;
     
     for ( i = 0; i < 32; i++ ) {
-        b = *src++;
-        m = *src++;
-        for ( j = 0; j < 32; j++ ) {
-            if ( m & 1 )
-                *dst = ( b & 1) ? pRiva->curFg : pRiva->curBg;
-            else
-                *dst = TRANSPARENT_PIXEL;
-            b >>= 1;
-            m >>= 1;
-            dst++;
-        }
+        NVMonoExpand16(src[0], src[1], pRiva->curFg, pRiva->curBg,
+                       line.pixels);
+        src += 2;
+        for ( j = 0; j < 16; j++ )
+            *dst++ = line.dwords[j];
     }
 }
 
@@ -68,17 +65,7 @@ RivaConvertCursor1555(RivaPtr pRiva, CARD32 *src, CARD16 *dst)
 static void
 RivaTransformCursor (RivaPtr pRiva)
 {
-    CARD32 *tmp;
-    int i, dwords;
-
-    dwords = (32 * 32) >> 1;
-    if(!(tmp = calloc(1, dwords * 4))) return;
-    RivaConvertCursor1555(pRiva, pRiva->curImage, (CARD16*)tmp);
-
-    for(i = 0; i < dwords; i++)
-        pRiva->riva.CURSOR[i] = tmp[i];
-
-    free(tmp);
+    RivaConvertCursor1555(pRiva, pRiva->curImage, pRiva->riva.CURSOR);
 }
 
 static void
@@ -153,6 +140,8 @@ RivaCursorInit(ScreenPtr pScreen)
     
     pRiva->CursorInfoRec = infoPtr;
 
+    NVMonoInit();
+
     infoPtr->MaxWidth = infoPtr->MaxHeight = 32;
     infoPtr->Flags = HARDWARE_CURSOR_TRUECOLOR_AT_8BPP |
                      HARDWARE_CURSOR_SOURCE_MASK_INTERLEAVE_32; 
@@ -29,6 +29,7 @@
 
 #include "nv_const.h"
 #include "riva_include.h"
+#include "nv_shadow.h"
 
 #include "xf86int10.h"
 
@@ -66,7 +67,9 @@ typedef enum {
     OPTION_SHOWCACHE,
     OPTION_SHADOW_FB,
     OPTION_FBDEV,
-    OPTION_ROTATE
+    OPTION_ROTATE,
+    OPTION_ACCEL_METHOD,
+    OPTION_SHADOW_THREADS
 } RivaOpts;
 
 
@@ -78,6 +81,8 @@ static const OptionInfoRec RivaOptions[] = {
     { OPTION_SHADOW_FB,         "ShadowFB",     OPTV_BOOLEAN,   {0}, FALSE },
     { OPTION_FBDEV,             "UseFBDev",     OPTV_BOOLEAN,   {0}, FALSE },
     { OPTION_ROTATE,		"Rotate",	OPTV_ANYSTR,	{0}, FALSE },
+    { OPTION_ACCEL_METHOD,      "AccelMethod",  OPTV_STRING,    {0}, FALSE },
+    { OPTION_SHADOW_THREADS,    "ShadowThreads", OPTV_INTEGER,  {0}, FALSE },
     { -1,                       NULL,           OPTV_NONE,      {0}, FALSE }
 };
 
@@ -261,8 +266,17 @@ RivaCloseScreen(CLOSE_SCREEN_ARGS_DECL)
     if (pRiva->AccelInfoRec)
         XAADestroyInfoRec(pRiva->AccelInfoRec);
 #endif
+    if (pRiva->exa) {
+        exaDriverFini(pScreen);
+        free(pRiva->exa);
+        pRiva->exa = NULL;
+    }
     if (pRiva->CursorInfoRec)
         xf86DestroyCursorInfoRec(pRiva->CursorInfoRec);
+    if (pRiva->ShadowPool) {
+        NVShadowPoolDestroy(pRiva->ShadowPool);
+        pRiva->ShadowPool = NULL;
+    }
     if (pRiva->ShadowPtr)
         free(pRiva->ShadowPtr);
     if (pRiva->DGAModes)
@@ -526,6 +540,20 @@ RivaPreInit(ScrnInfoPtr pScrn, int flags)
 	pRiva->NoAccel = TRUE;
 	xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "Acceleration disabled\n");
     }
+#ifdef HAVE_XAA_H
+    pRiva->AccelMethod = XAA;
+#else
+    pRiva->AccelMethod = EXA;
+#endif
+    if ((s = xf86GetOptValString(pRiva->Options, OPTION_ACCEL_METHOD))) {
+	if (!xf86NameCmp(s, "XAA"))
+	    pRiva->AccelMethod = XAA;
+	else if (!xf86NameCmp(s, "EXA"))
+	    pRiva->AccelMethod = EXA;
+	else
+	    xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+		"Unrecognized AccelMethod \"%s\"\n", s);
+    }
     if (xf86ReturnOptValBool(pRiva->Options, OPTION_SHOWCACHE, FALSE)) {
 	pRiva->ShowCache = TRUE;
 	xf86DrvMsg(pScrn->scrnIndex, X_CONFIG, "ShowCache enabled\n");
@@ -583,6 +611,17 @@ RivaPreInit(ScrnInfoPtr pScrn, int flags)
       }
     }
 
+    if (xf86GetOptValInteger(pRiva->Options, OPTION_SHADOW_THREADS,
+                             &pRiva->ShadowThreads)) {
+	if (pRiva->ShadowThreads < 0)
+	    pRiva->ShadowThreads = 0;
+	if (pRiva->ShadowThreads > 16)
+	    pRiva->ShadowThreads = 16;
+	xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+	    "Using %d worker threads for the rotated shadow framebuffer\n",
+	    pRiva->ShadowThreads);
+    }
+
     if (pRiva->pEnt->device->MemBase != 0) {
 	/* Require that the config file value matches one of the PCI values. */
 	if (!xf86CheckPciMemBase(pRiva->PciInfo, pRiva->pEnt->device->MemBase)) {
@@ -771,9 +810,10 @@ RivaPreInit(ScrnInfoPtr pScrn, int flags)
 	return FALSE;
     }
 
-    /* Load XAA if needed */
+    /* Load XAA or EXA if needed */
     if (!pRiva->NoAccel) {
-	if (!xf86LoadSubModule(pScrn, "xaa")) {
+	if (!xf86LoadSubModule(pScrn,
+			       (pRiva->AccelMethod == EXA) ? "exa" : "xaa")) {
 	    xf86DrvMsg(pScrn->scrnIndex, X_INFO, "Falling back to shadowfb\n");
 	    pRiva->NoAccel = 1;
 	    pRiva->ShadowFB = 1;
@@ -1158,15 +1198,26 @@ RivaScreenInit(SCREEN_INIT_ARGS_DECL)
     if(!pRiva->ShadowFB) /* hardware cursor needs to wrap this layer */
 	RivaDGAInit(pScreen);
 
-    AvailFBArea.x1 = 0;
-    AvailFBArea.y1 = 0;
-    AvailFBArea.x2 = pScrn->displayWidth;
-    AvailFBArea.y2 = (min(pRiva->FbUsableSize, 32*1024*1024)) / 
-                     (pScrn->displayWidth * pScrn->bitsPerPixel / 8);
-    xf86InitFBManager(pScreen, &AvailFBArea);
+    /* EXA manages the offscreen memory itself */
+    if (pRiva->NoAccel || (pRiva->AccelMethod != EXA)) {
+	AvailFBArea.x1 = 0;
+	AvailFBArea.y1 = 0;
+	AvailFBArea.x2 = pScrn->displayWidth;
+	AvailFBArea.y2 = (min(pRiva->FbUsableSize, 32*1024*1024)) / 
+	                 (pScrn->displayWidth * pScrn->bitsPerPixel / 8);
+	xf86InitFBManager(pScreen, &AvailFBArea);
+    }
     
-    if (!pRiva->NoAccel)
-	RivaAccelInit(pScreen);
+    if (!pRiva->NoAccel) {
+	if (pRiva->AccelMethod == EXA) {
+	    if (!RivaExaInit(pScreen)) {
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+		    "EXA hardware acceleration initialization failed\n");
+		return FALSE;
+	    }
+	} else
+	    RivaAccelInit(pScreen);
+    }
     
     xf86SetBackingStore(pScreen);
     xf86SetSilkenMouse(pScreen);
@@ -1201,6 +1252,8 @@ RivaScreenInit(SCREEN_INIT_ARGS_DECL)
     if(pRiva->ShadowFB) {
 	RefreshAreaFuncPtr refreshArea = RivaRefreshArea;
 
+	NVShadowInit();
+
 	if(pRiva->Rotate) {
    	   pRiva->PointerMoved = pScrn->PointerMoved;
 	   pScrn->PointerMoved = RivaPointerMoved;
@@ -1213,6 +1266,15 @@ RivaScreenInit(SCREEN_INIT_ARGS_DECL)
            xf86DisableRandR();
            xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                       "Driver rotation enabled, RandR disabled\n");
+
+	   if(pRiva->ShadowThreads)
+	       pRiva->ShadowPool = NVShadowPoolCreate(pRiva->ShadowThreads);
+	   if(pRiva->ShadowPool) {
+	       pRiva->ShadowThreadedRefresh = refreshArea;
+	       refreshArea = RivaRefreshThreaded;
+	   } else if(pRiva->ShadowThreads)
+	       xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+	                  "Failed to start the shadow framebuffer threads\n");
 	}
 
 	ShadowFBInit(pScreen, refreshArea);
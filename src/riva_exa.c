@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 1993-1999 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "riva_include.h"
+
+/*
+ * The RIVA 128 objects have no context surface we can retarget, they
+ * always render into the screen.  Pixmaps are therefore allocated as
+ * whole rows of the screen (offset and pitch both aligned to the screen
+ * pitch) and addressed by their row in screen coordinates, the same way
+ * the XAA pixmap cache works.
+ */
+
+static void
+waitMarker(ScreenPtr pScreen, int marker)
+{
+    RivaSync(xf86ScreenToScrn(pScreen));
+}
+
+static Bool
+checkPixmap(RivaPtr pRiva, PixmapPtr pPix)
+{
+    const int pitch = pRiva->CurrentLayout.displayWidth *
+                      (pRiva->CurrentLayout.bitsPerPixel >> 3);
+
+    if(pPix->drawable.bitsPerPixel != pRiva->CurrentLayout.bitsPerPixel)
+        return FALSE;
+    if(pPix->drawable.depth != pRiva->CurrentLayout.depth)
+        return FALSE;
+    if(exaGetPixmapPitch(pPix) != pitch)
+        return FALSE;
+    return TRUE;
+}
+
+/* first screen row of the pixmap */
+static int
+pixmapY(PixmapPtr pPix)
+{
+    return exaGetPixmapOffset(pPix) / exaGetPixmapPitch(pPix);
+}
+
+static Bool
+checkPlanemask(PixmapPtr pPix, Pixel planemask)
+{
+    CARD32 mask = planemask | (~0 << pPix->drawable.depth);
+
+    return (mask == 0xffffffff);
+}
+
+/* solid fills */
+
+static Bool
+prepareSolid(PixmapPtr      pPixmap,
+             int            alu,
+             Pixel          planemask,
+             Pixel          fg)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+
+    if(!checkPixmap(pRiva, pPixmap)) return FALSE;
+    if(!checkPlanemask(pPixmap, planemask)) return FALSE;
+
+    pRiva->exaDstY = pixmapY(pPixmap);
+
+    RivaSetRopSolid(pRiva, alu);
+    RIVA_FIFO_FREE(pRiva->riva, Bitmap, 1);
+    pRiva->riva.Bitmap->Color1A = fg;
+
+    return TRUE;
+}
+
+static void
+solid(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+    int w = x2 - x1, h = y2 - y1;
+
+    y1 += pRiva->exaDstY;
+
+    RIVA_FIFO_FREE(pRiva->riva, Bitmap, 2);
+    pRiva->riva.Bitmap->UnclippedRectangle[0].TopLeft     = (x1 << 16) | y1;
+    write_mem_barrier();
+    pRiva->riva.Bitmap->UnclippedRectangle[0].WidthHeight = (w << 16) | h;
+    write_mem_barrier();
+}
+
+static void
+doneSolid(PixmapPtr pPixmap)
+{
+}
+
+/* screen to screen copies */
+
+static Bool
+prepareCopy(PixmapPtr       pSrcPixmap,
+            PixmapPtr       pDstPixmap,
+            int             dx,
+            int             dy,
+            int             alu,
+            Pixel           planemask)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDstPixmap->drawable.pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+
+    if(!checkPixmap(pRiva, pSrcPixmap)) return FALSE;
+    if(!checkPixmap(pRiva, pDstPixmap)) return FALSE;
+    if(!checkPlanemask(pDstPixmap, planemask)) return FALSE;
+
+    pRiva->exaSrcY = pixmapY(pSrcPixmap);
+    pRiva->exaDstY = pixmapY(pDstPixmap);
+
+    RivaSetRopSolid(pRiva, alu);
+
+    return TRUE;
+}
+
+static void
+copy(PixmapPtr pDstPixmap,
+     int       srcX,
+     int       srcY,
+     int       dstX,
+     int       dstY,
+     int       width,
+     int       height)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDstPixmap->drawable.pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+
+    srcY += pRiva->exaSrcY;
+    dstY += pRiva->exaDstY;
+
+    RIVA_FIFO_FREE(pRiva->riva, Blt, 3);
+    pRiva->riva.Blt->TopLeftSrc  = (srcY << 16) | srcX;
+    pRiva->riva.Blt->TopLeftDst  = (dstY << 16) | dstX;
+    write_mem_barrier();
+    pRiva->riva.Blt->WidthHeight = (height << 16) | width;
+    write_mem_barrier();
+}
+
+static void
+doneCopy(PixmapPtr pDstPixmap)
+{
+}
+
+/* upload to screen */
+
+/*
+ * The pixels are pushed through the image from CPU object, so the upload
+ * is queued behind whatever the engine is still drawing instead of
+ * waiting for it to go idle and writing the framebuffer directly.  Each
+ * line goes through expandBuffer first since the source lines are not
+ * necessarily dword aligned.
+ */
+static Bool
+upload(PixmapPtr pDst,
+       int       x,
+       int       y,
+       int       w,
+       int       h,
+       char      *src,
+       int       src_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+    const int Bpp = pDst->drawable.bitsPerPixel >> 3;
+    const int dwords = ((w * Bpp) + 3) >> 2;
+    CARD32 *d = (CARD32*)&pRiva->riva.Pixmap->Pixels;
+
+    if(!checkPixmap(pRiva, pDst)) return FALSE;
+
+    y += pixmapY(pDst);
+
+    RivaSetRopSolid(pRiva, GXcopy);
+    RIVA_FIFO_FREE(pRiva->riva, Pixmap, 3);
+    pRiva->riva.Pixmap->TopLeft       = (y << 16) | x;
+    pRiva->riva.Pixmap->WidthHeight   = (h << 16) | w;
+    pRiva->riva.Pixmap->WidthHeightIn = (h << 16) | ((dwords << 2) / Bpp);
+
+    while(h--) {
+        CARD32 *pbits = (CARD32*)pRiva->expandBuffer;
+        int t = dwords;
+
+        memcpy(pbits, src, w * Bpp);
+        src += src_pitch;
+
+        while(t >= 16) {
+            RIVA_FIFO_FREE(pRiva->riva, Pixmap, 16);
+            d[0]  = pbits[0];
+            d[1]  = pbits[1];
+            d[2]  = pbits[2];
+            d[3]  = pbits[3];
+            d[4]  = pbits[4];
+            d[5]  = pbits[5];
+            d[6]  = pbits[6];
+            d[7]  = pbits[7];
+            d[8]  = pbits[8];
+            d[9]  = pbits[9];
+            d[10] = pbits[10];
+            d[11] = pbits[11];
+            d[12] = pbits[12];
+            d[13] = pbits[13];
+            d[14] = pbits[14];
+            d[15] = pbits[15];
+            t -= 16; pbits += 16;
+        }
+        if(t) {
+            RIVA_FIFO_FREE(pRiva->riva, Pixmap, t);
+            while(t--)
+                *(d++) = *(pbits++);
+            d = (CARD32*)&pRiva->riva.Pixmap->Pixels;
+        }
+        write_mem_barrier();
+    }
+
+    /* hardware bug workaround, same as the color expansion */
+    RIVA_FIFO_FREE(pRiva->riva, Blt, 1);
+    write_mem_barrier();
+    pRiva->riva.Blt->TopLeftSrc = 0;
+    write_mem_barrier();
+
+    return TRUE;
+}
+
+/* download from screen */
+
+static Bool
+download(PixmapPtr pSrc,
+         int       x,
+         int       y,
+         int       w,
+         int       h,
+         char      *dst,
+         int       dst_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pSrc->drawable.pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+    const int Bpp = pSrc->drawable.bitsPerPixel >> 3;
+    const int pitch = exaGetPixmapPitch(pSrc);
+    unsigned char *src;
+
+    src = pRiva->FbStart + exaGetPixmapOffset(pSrc) + (y * pitch) + (x * Bpp);
+
+    RivaSync(pScrn);
+
+    while(h--) {
+        memcpy(dst, src, w * Bpp);
+        src += pitch;
+        dst += dst_pitch;
+    }
+
+    return TRUE;
+}
+
+/******************************************************************************/
+
+Bool
+RivaExaInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    RivaPtr pRiva = RivaPTR(pScrn);
+    ExaDriverPtr exa;
+    const int pitch = pScrn->displayWidth * (pScrn->bitsPerPixel >> 3);
+    long size = min(pRiva->FbUsableSize, 32*1024*1024);
+
+    /* keep every row addressable by the 16 bit coordinates */
+    if(size > (long)pitch * 32767)
+        size = (long)pitch * 32767;
+
+    exa = pRiva->exa = exaDriverAlloc();
+    if(!exa) return FALSE;
+
+    /* line buffer for uploads, the pixmaps can't be wider than the screen */
+    pRiva->expandBuffer = xnfalloc(pitch + 8);
+
+    exa->exa_major         = EXA_VERSION_MAJOR;
+    exa->exa_minor         = EXA_VERSION_MINOR;
+    exa->memoryBase        = pRiva->FbStart;
+    exa->offScreenBase     = pitch * pScrn->virtualY;
+    exa->memorySize        = size;
+    exa->pixmapOffsetAlign = pitch;
+    exa->pixmapPitchAlign  = pitch;
+    exa->flags             = EXA_OFFSCREEN_PIXMAPS;
+    exa->maxX              = pScrn->displayWidth;
+    exa->maxY              = 2048;
+
+    /**** Rendering ops ****/
+    exa->PrepareSolid       = prepareSolid;
+    exa->Solid              = solid;
+    exa->DoneSolid          = doneSolid;
+    exa->PrepareCopy        = prepareCopy;
+    exa->Copy               = copy;
+    exa->DoneCopy           = doneCopy;
+    exa->UploadToScreen     = upload;
+    exa->DownloadFromScreen = download;
+
+    exa->WaitMarker         = waitMarker;
+
+    RivaResetGraphics(pScrn);
+
+    return exaDriverInit(pScreen, exa);
+}
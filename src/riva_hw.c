@@ -29,6 +29,7 @@
 #include "compiler.h"
 #include "riva_include.h"
 #include "riva_hw.h"
+#include "nv_pll.h"
 #include "riva_tbl.h"
 
 /*
@@ -577,54 +578,36 @@ static int CalcVClock
     RIVA_HW_INST *chip
 )
 {
-    unsigned lowM, highM, highP;
-    unsigned DeltaNew, DeltaOld;
-    unsigned VClk, Freq;
-    unsigned M, N, P;
-    
-    DeltaOld = 0xFFFFFFFF;
+    NVPllLimits limits = { 0 };
+    NVPllCoeffs pll;
 
-    VClk     = (unsigned)clockIn;
-    
+    limits.refclk = chip->CrystalFreqKHz;
     if (chip->CrystalFreqKHz == 13500)
     {
-        lowM  = 7;
-        highM = 12;
+        limits.minM1 = 7;
+        limits.maxM1 = 12;
     }                      
     else
     {
-        lowM  = 8;
-        highM = 13;
+        limits.minM1 = 8;
+        limits.maxM1 = 13;
     }
+    limits.minN1 = 1;
+    limits.maxN1 = 255;
+    limits.log2P = 1;
 
-    highP = 3;
-    for (P = 0; P <= highP; P ++)
-    {
-        Freq = VClk << P;
-        if ((Freq >= 128000) && (Freq <= chip->MaxVClockFreqKHz))
-        {
-            for (M = lowM; M <= highM; M++)
-            {
-                N    = (VClk << P) * M / chip->CrystalFreqKHz;
-                if(N <= 255) {
-                    Freq = (chip->CrystalFreqKHz * N / M) >> P;
-                    if (Freq > VClk)
-                        DeltaNew = Freq - VClk;
-                    else
-                        DeltaNew = VClk - Freq;
-                    if (DeltaNew < DeltaOld)
-                    {
-                        *mOut     = M;
-                        *nOut     = N;
-                        *pOut     = P;
-                        *clockOut = Freq;
-                        DeltaOld  = DeltaNew;
-                    }
-                }
-            }
-        }
-    }
-    return (DeltaOld != 0xFFFFFFFF);
+    if (!NVPllPostRange(clockIn, 128000, chip->MaxVClockFreqKHz, 0, 3,
+                        &limits.lowP, &limits.highP))
+        return 0;
+
+    if (!NVPllSolve(&limits, clockIn, &pll))
+        return 0;
+
+    *mOut     = pll.m1;
+    *nOut     = pll.n1;
+    *pOut     = pll.p;
+    *clockOut = pll.clock;
+    return 1;
 }
 /*
  * Calculate extended mode parameters (SVGA) and save in a 
@@ -39,6 +39,7 @@
 #ifdef HAVE_XAA_H
 #include "xaa.h"
 #endif
+#include "exa.h"
 #include "xf86fbman.h"
 #include "xf86cmap.h"
 #include "shadowfb.h"
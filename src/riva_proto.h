@@ -30,6 +30,10 @@ Bool    RivaCursorInit(ScreenPtr pScreen);
 Bool    RivaAccelInit(ScreenPtr pScreen);
 void    RivaSync(ScrnInfoPtr pScrn);
 void    RivaResetGraphics(ScrnInfoPtr pScrn);
+void    RivaSetRopSolid(RivaPtr pRiva, int rop);
+
+/* in riva_exa.c */
+Bool    RivaExaInit(ScreenPtr pScreen);
 
 /* in riva_dga.c */
 Bool    RivaDGAInit(ScreenPtr pScreen);
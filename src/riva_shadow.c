@@ -10,6 +10,7 @@
 #include "riva_local.h"
 #include "riva_include.h"
 #include "riva_type.h"
+#include "nv_shadow.h"
 #include "shadowfb.h"
 #include "servermd.h"
 
@@ -18,27 +19,13 @@ void
 RivaRefreshArea(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 {
     RivaPtr pRiva = RivaPTR(pScrn);
-    int width, height, Bpp, FBPitch;
-    unsigned char *src, *dst;
+    int Bpp, FBPitch;
    
     Bpp = pScrn->bitsPerPixel >> 3;
     FBPitch = BitmapBytePad(pScrn->displayWidth * pScrn->bitsPerPixel);
 
-    while(num--) {
-	width = (pbox->x2 - pbox->x1) * Bpp;
-	height = pbox->y2 - pbox->y1;
-	src = pRiva->ShadowPtr + (pbox->y1 * pRiva->ShadowPitch) + 
-						(pbox->x1 * Bpp);
-	dst = pRiva->FbStart + (pbox->y1 * FBPitch) + (pbox->x1 * Bpp);
-
-	while(height--) {
-	    memcpy(dst, src, width);
-	    dst += FBPitch;
-	    src += pRiva->ShadowPitch;
-	}
-	
-	pbox++;
-    }
+    NVShadowCopyBoxes(pRiva->FbStart, FBPitch, pRiva->ShadowPtr,
+                      pRiva->ShadowPitch, Bpp, num, pbox);
 } 
 
 void
@@ -192,3 +179,12 @@ RivaRefreshArea32(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
 	pbox++;
     }
 }
+
+void
+RivaRefreshThreaded(ScrnInfoPtr pScrn, int num, BoxPtr pbox)
+{
+    RivaPtr pRiva = RivaPTR(pScrn);
+
+    NVShadowPoolRun(pRiva->ShadowPool, pRiva->ShadowThreadedRefresh,
+                    pScrn, num, pbox);
+}
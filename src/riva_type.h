@@ -21,6 +21,11 @@
 
 typedef RIVA_HW_STATE* RivaRegPtr;
 
+typedef enum AccelMethod {
+    XAA,
+    EXA,
+} AccelMethod;
+
 typedef struct {
     Bool        isHwCursor;
     int         CursorMaxWidth;
@@ -72,16 +77,23 @@ typedef struct {
     long                FbUsableSize;
     RivaRamdacRec         Dac;
     Bool                NoAccel;
+    AccelMethod         AccelMethod;
     Bool                HWCursor;
     Bool                ShowCache;
     Bool                ShadowFB;
     unsigned char *     ShadowPtr;
     int                 ShadowPitch;
+    int                 ShadowThreads;
+    struct _NVShadowPool *ShadowPool;
+    RefreshAreaFuncPtr  ShadowThreadedRefresh;
     int                 MinClock;
     int                 MaxClock;
 #ifdef HAVE_XAA_H
     XAAInfoRecPtr       AccelInfoRec;
 #endif
+    ExaDriverPtr        exa;
+    int                 exaSrcY;
+    int                 exaDstY;
     xf86CursorInfoPtr   CursorInfoRec;
     DGAModePtr          DGAModes;
     int                 numDGAModes;
@@ -122,6 +134,7 @@ void RivaRefreshArea8(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 void RivaRefreshArea16(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 void RivaRefreshArea32(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 void RivaPointerMoved(SCRN_ARG_TYPE arg, int x, int y);
+void RivaRefreshThreaded(ScrnInfoPtr pScrn, int num, BoxPtr pbox);
 
 int RivaGetConfig(RivaPtr);
 
@@ -31,10 +31,30 @@
 #include "riva_include.h"
 #ifdef HAVE_XAA_H
 #include "xaalocal.h"
-#endif
 #include "xaarop.h"
+#endif
 #include "miline.h"
 
+static const int RivaCopyROP[16] =
+{
+   0x00,            /* GXclear */
+   0x88,            /* GXand */
+   0x44,            /* GXandReverse */
+   0xCC,            /* GXcopy */
+   0x22,            /* GXandInverted */
+   0xAA,            /* GXnoop */
+   0x66,            /* GXxor */
+   0xEE,            /* GXor */
+   0x11,            /* GXnor */
+   0x99,            /* GXequiv */
+   0x55,            /* GXinvert*/
+   0xDD,            /* GXorReverse */
+   0x33,            /* GXcopyInverted */
+   0xBB,            /* GXorInverted */
+   0x77,            /* GXnand */
+   0xFF             /* GXset */
+};
+
 static void
 RivaSetClippingRectangle(ScrnInfoPtr pScrn, int x1, int y1, int x2, int y2)
 {
@@ -69,9 +89,9 @@ RivaSetPattern(RivaPtr pRiva, int clr0, int clr1, int pat0, int pat1)
 }
 
 /*
- * Set ROP.  Translate X rop into ROP3.  Internal routine.
+ * Set ROP.  Translate X rop into ROP3.
  */
-static void
+void
 RivaSetRopSolid(RivaPtr pRiva, int rop)
 {    
     if (pRiva->currentRop != rop) {
@@ -79,12 +99,11 @@ RivaSetRopSolid(RivaPtr pRiva, int rop)
             RivaSetPattern(pRiva, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
         pRiva->currentRop = rop;
         RIVA_FIFO_FREE(pRiva->riva, Rop, 1);
-#ifdef HAVE_XAA_H
-        pRiva->riva.Rop->Rop3 = XAAGetCopyROP(rop);
-#endif
+        pRiva->riva.Rop->Rop3 = RivaCopyROP[rop];
     }
 }
 
+#ifdef HAVE_XAA_H
 static void
 RivaSetRopPattern(RivaPtr pRiva, int rop)
 {
@@ -94,7 +113,7 @@ RivaSetRopPattern(RivaPtr pRiva, int rop)
         pRiva->riva.Rop->Rop3 = XAAGetPatternROP(rop);
     }
 }
-#ifdef HAVE_XAA_H
+
 /*
  * Fill solid rectangles.
  */
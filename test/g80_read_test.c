@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2007 NVIDIA, Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the DownloadFromScreen line copies in g80_read.c against plain
+ * memcpy, with host memory standing in for the aperture.  Every source
+ * alignment within a 64 byte line is tried with line lengths around the
+ * 16 and 64 byte steps of the SSE4.1 loop, and the bytes around each
+ * destination line must come back untouched.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "g80_read.h"
+
+#define SRC_PITCH 1024
+#define DST_PITCH 1031  /* odd so destination alignment varies per line */
+#define LINES     3
+#define GUARD     0xa5
+
+static unsigned char *src;
+static char *dst, *ref;
+
+static int
+check(const char *name, G80ReadLinesProc proc, int skew, int len)
+{
+    const unsigned char *s = src + skew;
+    int i;
+
+    memset(dst, GUARD, DST_PITCH * (LINES + 1));
+    memset(ref, GUARD, DST_PITCH * (LINES + 1));
+    for(i = 0; i < LINES; i++)
+        memcpy(ref + DST_PITCH * i + 1, s + SRC_PITCH * i, len);
+
+    proc(dst + 1, DST_PITCH, s, SRC_PITCH, len, LINES);
+
+    if(memcmp(dst, ref, DST_PITCH * (LINES + 1))) {
+        fprintf(stderr, "%s: mismatch at source offset %d, length %d\n",
+                name, skew, len);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+checkAll(const char *name, G80ReadLinesProc proc)
+{
+    int skew, len, failed = 0;
+
+    for(skew = 0; skew < 64; skew++) {
+        for(len = 0; len <= 3 * 64 + 17; len++)
+            failed += check(name, proc, skew, len);
+        failed += check(name, proc, skew, SRC_PITCH - 64);
+    }
+
+    return failed;
+}
+
+int
+main(void)
+{
+    int i, failed = 0;
+
+    /* rows are 256 byte aligned in video memory, keep that here too */
+    if(posix_memalign((void**)&src, 256, SRC_PITCH * (LINES + 1)))
+        return 1;
+    dst = malloc(DST_PITCH * (LINES + 1));
+    ref = malloc(DST_PITCH * (LINES + 1));
+    if(!dst || !ref)
+        return 1;
+
+    srand(1);
+    for(i = 0; i < SRC_PITCH * (LINES + 1); i++)
+        src[i] = rand();
+
+    failed += checkAll("G80ReadLines", G80ReadLines);
+#ifdef HAVE_SSE41
+    if(__builtin_cpu_supports("sse4.1"))
+        failed += checkAll("G80ReadLinesSSE41", G80ReadLinesSSE41);
+    else
+        printf("SSE4.1 not supported here, only the C version was checked\n");
+#endif
+
+    free(src);
+    free(dst);
+    free(ref);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Times the unrotated shadow refresh line copies in nv_copy.c on host
+ * memory against the plain memcpy per line the refresh used before, for a
+ * range of box widths and destination alignments.  Every copy is checked
+ * against memcpy first, including the bytes around each line.
+ *
+ *   nv_burst_bench [lines]
+ *
+ * Host memory is cached rather than write-combined like the framebuffer,
+ * so this shows the cost of the copies themselves more than the bus
+ * bursts they are shaped for.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nv_copy.h"
+
+#define PITCH 8192
+#define GUARD 0x5a
+
+static int lines = 4096;
+static uint8_t *shadow, *fb, *ref;
+
+typedef void (*CopyFunc)(void *dst, int dstPitch, const void *src,
+                         int srcPitch, int len, int h);
+
+static void
+memcpyLines(void *dst, int dstPitch, const void *src, int srcPitch, int len,
+            int h)
+{
+    while(h--) {
+        memcpy(dst, src, len);
+        dst = (uint8_t*)dst + dstPitch;
+        src = (const uint8_t*)src + srcPitch;
+    }
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+check(const char *name, CopyFunc func, int offset, int len)
+{
+    const int h = 7;
+
+    memset(fb, GUARD, (size_t)PITCH * (h + 1));
+    memset(ref, GUARD, (size_t)PITCH * (h + 1));
+    memcpyLines(ref + offset, PITCH, shadow + 3, PITCH, len, h);
+    (*func)(fb + offset, PITCH, shadow + 3, PITCH, len, h);
+    NVCopyFlush();
+
+    if(memcmp(fb, ref, (size_t)PITCH * (h + 1))) {
+        fprintf(stderr, "%s: %d bytes at offset %d differ from memcpy\n",
+                name, len, offset);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+run(const char *name, CopyFunc func, int offset, int len)
+{
+    double start, elapsed;
+    int reps, i;
+
+    for(i = 0; i <= 3 * NV_COPY_BURST; i++) {
+        if(check(name, func, offset, i))
+            return 1;
+    }
+    if(check(name, func, offset, len))
+        return 1;
+
+    /* move about 256MB per measurement */
+    reps = (256 << 20) / ((size_t)len * lines) + 1;
+    start = now();
+    for(i = 0; i < reps; i++) {
+        (*func)(fb + offset, PITCH, shadow, PITCH, len, lines);
+        NVCopyFlush();
+    }
+    elapsed = now() - start;
+
+    printf("%-8s %5d bytes  offset %2d  %8.1f MB/s\n", name, len, offset,
+           (double)len * lines * reps / elapsed / 1e6);
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    const int widths[] = { 16, 60, 64, 100, 256, 640, 2560, 7680 };
+    const int offsets[] = { 0, 4, 36 };
+    int i, j, failed = 0;
+
+    if(argc >= 2)
+        lines = atoi(argv[1]);
+    if(lines < 8) {
+        fprintf(stderr, "usage: %s [lines]\n", argv[0]);
+        return 2;
+    }
+
+    if(posix_memalign((void**)&shadow, 64, (size_t)PITCH * lines) ||
+       posix_memalign((void**)&fb, 64, (size_t)PITCH * lines) ||
+       posix_memalign((void**)&ref, 64, (size_t)PITCH * lines))
+        return 2;
+    srand(1);
+    for(i = 0; i < PITCH * lines; i++)
+        shadow[i] = rand();
+
+    for(i = 0; i < (int)(sizeof(widths) / sizeof(widths[0])); i++) {
+        for(j = 0; j < (int)(sizeof(offsets) / sizeof(offsets[0])); j++) {
+            failed += run("memcpy", memcpyLines, offsets[j], widths[i]);
+            NVCopyInit(0);
+            failed += run("C", NVCopyLines, offsets[j], widths[i]);
+            NVCopyInit(1);
+            failed += run("best", NVCopyLines, offsets[j], widths[i]);
+        }
+    }
+
+    free(shadow);
+    free(fb);
+    free(ref);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Checks the mono cursor expansion in nv_mono.c bit for bit against the
+ * pixel at a time loop it replaced.  Every pair of source and mask bytes
+ * is tried in every byte of the word, with random bits around it and
+ * random colors, so each table entry is used in each lane.  The 16 bit
+ * variant gets the same treatment with 16 bit colors.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nv_mono.h"
+
+static uint32_t
+random32(void)
+{
+    return ((uint32_t)(rand() & 0xffff) << 16) | (rand() & 0xffff);
+}
+
+static void
+reference(uint32_t b, uint32_t m, uint32_t fg, uint32_t bg, uint32_t *dst)
+{
+    int j;
+
+    for(j = 0; j < 32; j++) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        if(m & 0x80000000)
+            *dst = (b & 0x80000000) ? fg : bg;
+        else
+            *dst = 0;
+        b <<= 1;
+        m <<= 1;
+#else
+        if(m & 1)
+            *dst = (b & 1) ? fg : bg;
+        else
+            *dst = 0;
+        b >>= 1;
+        m >>= 1;
+#endif
+        dst++;
+    }
+}
+
+int
+main(void)
+{
+    uint32_t out[33], ref[32];
+    uint16_t out16[33];
+    int n, s, k, j;
+
+    srand(1);
+    NVMonoInit();
+
+    for(n = 0; n < 4; n++) {
+        for(s = 0; s < 256; s++) {
+            for(k = 0; k < 256; k++) {
+                const uint32_t keep = ~(0xffu << (n * 8));
+                const uint32_t b = (random32() & keep) | (s << (n * 8));
+                const uint32_t m = (random32() & keep) | (k << (n * 8));
+                const uint32_t fg = random32(), bg = random32();
+
+                out[32] = 0x5a5a5a5a;
+                NVMonoExpand(b, m, fg, bg, out);
+                reference(b, m, fg, bg, ref);
+
+                for(j = 0; j < 32; j++) {
+                    if(out[j] != ref[j]) {
+                        fprintf(stderr, "NVMonoExpand: src %08x mask %08x "
+                                "fg %08x bg %08x: pixel %d is %08x, "
+                                "expected %08x\n", b, m, fg, bg, j, out[j],
+                                ref[j]);
+                        return 1;
+                    }
+                }
+                if(out[32] != 0x5a5a5a5a) {
+                    fprintf(stderr, "NVMonoExpand: wrote past 32 pixels\n");
+                    return 1;
+                }
+
+                out16[32] = 0x5a5a;
+                NVMonoExpand16(b, m, fg, bg, out16);
+                reference(b, m, fg & 0xffff, bg & 0xffff, ref);
+
+                for(j = 0; j < 32; j++) {
+                    if(out16[j] != ref[j]) {
+                        fprintf(stderr, "NVMonoExpand16: src %08x mask %08x "
+                                "fg %04x bg %04x: pixel %d is %04x, "
+                                "expected %04x\n", b, m, fg & 0xffff,
+                                bg & 0xffff, j, out16[j], ref[j]);
+                        return 1;
+                    }
+                }
+                if(out16[32] != 0x5a5a) {
+                    fprintf(stderr, "NVMonoExpand16: wrote past 32 pixels\n");
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,756 @@
+/*
+ * Checks the PLL search in nv_pll.c with the limits the NV, Riva and G80
+ * code give it, on the VESA DMT and CEA-861 pixel clocks and a few more.
+ * Each answer must be within the limits and exactly as close to the
+ * target as the best of every coefficient set a brute force walk finds,
+ * errors being compared as fractions.  Single stage PLLs must round N to
+ * the nearest value, and clocks G80CalcPLL can't reach must get the
+ * outermost post divider.
+ *
+ * Copies of the solvers nv_pll.c replaced are kept below.  On every clock
+ * the new answer must be as close to the target as theirs, or closer.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nv_pll.h"
+
+static const int clocks[] = {
+    /* VESA DMT */
+    25175, 31500, 35500, 36000, 40000, 44900, 49500, 50000, 56250, 65000,
+    68250, 71000, 73250, 75000, 78750, 79500, 83500, 85250, 85500, 88750,
+    94500, 101000, 102250, 106500, 108000, 117500, 119000, 121750, 122500,
+    135000, 140250, 146250, 148250, 154000, 156000, 157000, 157500, 162000,
+    175500, 179500, 187000, 189000, 193250, 202500, 204750, 214750, 218250,
+    229500, 234000, 245500, 261000, 268250, 281250, 297000, 317000, 333250,
+    348500, 380500,
+    /* CEA-861 */
+    13500, 25200, 27000, 27027, 54000, 54054, 74176, 74250, 108108, 148352,
+    148500, 296703, 594000,
+    /* others */
+    30240, 57284, 80000, 99000, 100000, 172800, 193160, 210000, 230000,
+    252000, 270000, 340000, 400000
+};
+
+#define NUM_CLOCKS (int)(sizeof(clocks) / sizeof(clocks[0]))
+
+typedef struct {
+    uint64_t num, den;          /* error is num / den */
+    int found;
+} PllError;
+
+static uint64_t
+absDiff(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static PllError
+errorOf(const NVPllLimits *lim, int clock, int n1, int m1, int n2, int m2,
+        int p)
+{
+    const uint64_t div = lim->log2P ? (1 << p) : p;
+    PllError e;
+
+    e.den = (uint64_t)m1 * m2 * div;
+    e.num = absDiff((uint64_t)clock * e.den,
+                    (uint64_t)lim->refclk * n1 * n2);
+    e.found = 1;
+    return e;
+}
+
+static int
+closer(PllError a, PllError b)
+{
+    return !b.found || (a.num * b.den < b.num * a.den);
+}
+
+static int
+in(int v, int lo, int hi)
+{
+    return (v >= lo) && (v <= hi);
+}
+
+/* whether a coefficient set meets every limit, checked the long way */
+static int
+fits(const NVPllLimits *lim, int n1, int m1, int n2, int m2, int p)
+{
+    const uint64_t ref = lim->refclk;
+
+    if(!in(p, lim->lowP, lim->highP) || (!lim->log2P && !p) ||
+       !in(m1, lim->minM1, lim->maxM1) || !in(n1, lim->minN1, lim->maxN1))
+        return 0;
+    if((lim->minU1 && (ref < (uint64_t)lim->minU1 * m1)) ||
+       (lim->maxU1 && (ref > (uint64_t)lim->maxU1 * m1)))
+        return 0;
+    if(!lim->maxM2)
+        return (n2 == 1) && (m2 == 1);
+
+    if((lim->minVco1 && (ref * n1 < (uint64_t)lim->minVco1 * m1)) ||
+       (lim->maxVco1 && (ref * n1 > (uint64_t)lim->maxVco1 * m1)))
+        return 0;
+    if(!in(m2, lim->minM2, lim->maxM2) || !in(n2, lim->minN2, lim->maxN2))
+        return 0;
+    if((lim->minU2 && (ref * n1 < (uint64_t)lim->minU2 * m1 * m2)) ||
+       (lim->maxU2 && (ref * n1 > (uint64_t)lim->maxU2 * m1 * m2)))
+        return 0;
+
+    return 1;
+}
+
+static PllError
+bruteForce(const NVPllLimits *lim, int clock)
+{
+    PllError best, e;
+    int p, m1, n1, m2, n2;
+
+    memset(&best, 0, sizeof(best));
+
+    for(p = lim->lowP; p <= lim->highP; p++) {
+        for(m1 = lim->minM1; m1 <= lim->maxM1; m1++) {
+            for(n1 = lim->minN1; n1 <= lim->maxN1; n1++) {
+                if(!lim->maxM2) {
+                    if(!fits(lim, n1, m1, 1, 1, p))
+                        continue;
+                    e = errorOf(lim, clock, n1, m1, 1, 1, p);
+                    if(closer(e, best))
+                        best = e;
+                    continue;
+                }
+                /* skip first stages out of range, fits() is slow */
+                if((lim->minVco1 && ((uint64_t)lim->refclk * n1 <
+                                     (uint64_t)lim->minVco1 * m1)) ||
+                   (lim->maxVco1 && ((uint64_t)lim->refclk * n1 >
+                                     (uint64_t)lim->maxVco1 * m1)))
+                    continue;
+                for(m2 = lim->minM2; m2 <= lim->maxM2; m2++) {
+                    for(n2 = lim->minN2; n2 <= lim->maxN2; n2++) {
+                        if(!fits(lim, n1, m1, n2, m2, p))
+                            continue;
+                        e = errorOf(lim, clock, n1, m1, n2, m2, p);
+                        if(closer(e, best))
+                            best = e;
+                    }
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+static int
+checkClock(const char *what, const NVPllLimits *lim, int clock)
+{
+    const PllError best = bruteForce(lim, clock);
+    NVPllCoeffs c, again;
+    PllError e;
+    uint64_t div;
+
+    memset(&c, 0, sizeof(c));
+    if(!NVPllSolve(lim, clock, &c)) {
+        if(best.found) {
+            fprintf(stderr, "%s: %d kHz: nothing found\n", what, clock);
+            return 1;
+        }
+        return 0;
+    }
+    if(!best.found) {
+        fprintf(stderr, "%s: %d kHz: found coefficients that don't fit\n",
+                what, clock);
+        return 1;
+    }
+
+    if(!fits(lim, c.n1, c.m1, c.n2, c.m2, c.p)) {
+        fprintf(stderr, "%s: %d kHz: N1 %d M1 %d N2 %d M2 %d P %d are out "
+                "of range\n", what, clock, c.n1, c.m1, c.n2, c.m2, c.p);
+        return 1;
+    }
+
+    e = errorOf(lim, clock, c.n1, c.m1, c.n2, c.m2, c.p);
+    if(closer(best, e)) {
+        fprintf(stderr, "%s: %d kHz: error %llu/%llu, the best is "
+                "%llu/%llu\n", what, clock, (unsigned long long)e.num,
+                (unsigned long long)e.den, (unsigned long long)best.num,
+                (unsigned long long)best.den);
+        return 1;
+    }
+
+    div = lim->log2P ? (1 << c.p) : c.p;
+    if((uint64_t)c.clock != (uint64_t)lim->refclk * c.n1 * c.n2 /
+                            ((uint64_t)c.m1 * c.m2 * div))
+    {
+        fprintf(stderr, "%s: %d kHz: reports %d kHz\n", what, clock,
+                c.clock);
+        return 1;
+    }
+
+    /* single stage: N is the nearest one for the dividers picked */
+    if(!lim->maxM2) {
+        const uint64_t target = (uint64_t)clock * c.m1 * div;
+        const uint64_t got = (uint64_t)lim->refclk * c.n1;
+
+        if((in(c.n1 + 1, lim->minN1, lim->maxN1) &&
+            (absDiff(got + lim->refclk, target) < absDiff(got, target))) ||
+           (in(c.n1 - 1, lim->minN1, lim->maxN1) &&
+            (absDiff(got - lim->refclk, target) < absDiff(got, target))))
+        {
+            fprintf(stderr, "%s: %d kHz: N %d isn't rounded to nearest\n",
+                    what, clock, c.n1);
+            return 1;
+        }
+    }
+
+    /* cached answers are the same */
+    if(!NVPllSolve(lim, clock, &again) || memcmp(&c, &again, sizeof(c))) {
+        fprintf(stderr, "%s: %d kHz: second answer differs\n", what, clock);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * The solvers before nv_pll.c, CalcVClock and CalcVClock2Stage from
+ * nv_hw.c, CalcVClock from riva_hw.c and G80CalcPLL and G80CalcPLL2 from
+ * g80_display.c.  Only the way they return their results is changed.
+ */
+static int
+legacyNV(int xtal, int clockIn, NVPllCoeffs *c)
+{
+    unsigned lowM, highM;
+    unsigned DeltaNew, DeltaOld;
+    unsigned VClk, Freq;
+    unsigned M, N, P;
+
+    DeltaOld = 0xFFFFFFFF;
+
+    VClk = (unsigned)clockIn;
+
+    if (xtal == 13500) {
+        lowM  = 7;
+        highM = 13;
+    } else {
+        lowM  = 8;
+        highM = 14;
+    }
+
+    for (P = 0; P <= 4; P++) {
+        Freq = VClk << P;
+        if ((Freq >= 128000) && (Freq <= 350000)) {
+            for (M = lowM; M <= highM; M++) {
+                N = ((VClk << P) * M) / xtal;
+                if(N <= 255) {
+                    Freq = ((xtal * N) / M) >> P;
+                    if (Freq > VClk)
+                        DeltaNew = Freq - VClk;
+                    else
+                        DeltaNew = VClk - Freq;
+                    if (DeltaNew < DeltaOld) {
+                        c->n1 = N;
+                        c->m1 = M;
+                        c->p  = P;
+                        DeltaOld  = DeltaNew;
+                    }
+                }
+            }
+        }
+    }
+
+    c->n2 = c->m2 = 1;
+    return DeltaOld != 0xFFFFFFFF;
+}
+
+static int
+legacyNV2Stage(int xtal, int clockIn, NVPllCoeffs *c)
+{
+    unsigned DeltaNew, DeltaOld;
+    unsigned VClk, Freq;
+    unsigned M, N, P;
+
+    DeltaOld = 0xFFFFFFFF;
+
+    VClk = (unsigned)clockIn;
+
+    for (P = 0; P <= 6; P++) {
+        Freq = VClk << P;
+        if ((Freq >= 400000) && (Freq <= 1000000)) {
+            for (M = 1; M <= 13; M++) {
+                N = ((VClk << P) * M) / (xtal << 2);
+                if((N >= 5) && (N <= 255)) {
+                    Freq = (((xtal << 2) * N) / M) >> P;
+                    if (Freq > VClk)
+                        DeltaNew = Freq - VClk;
+                    else
+                        DeltaNew = VClk - Freq;
+                    if (DeltaNew < DeltaOld) {
+                        c->n1 = N;
+                        c->m1 = M;
+                        c->p  = P;
+                        DeltaOld  = DeltaNew;
+                    }
+                }
+            }
+        }
+    }
+
+    c->n2 = c->m2 = 1;
+    return DeltaOld != 0xFFFFFFFF;
+}
+
+static int
+legacyRiva(int xtal, int maxVClock, int clockIn, NVPllCoeffs *c)
+{
+    unsigned lowM, highM, highP;
+    unsigned DeltaNew, DeltaOld;
+    unsigned VClk, Freq;
+    unsigned M, N, P;
+
+    DeltaOld = 0xFFFFFFFF;
+
+    VClk     = (unsigned)clockIn;
+
+    if (xtal == 13500)
+    {
+        lowM  = 7;
+        highM = 12;
+    }
+    else
+    {
+        lowM  = 8;
+        highM = 13;
+    }
+
+    highP = 3;
+    for (P = 0; P <= highP; P ++)
+    {
+        Freq = VClk << P;
+        if ((Freq >= 128000) && (Freq <= (unsigned)maxVClock))
+        {
+            for (M = lowM; M <= highM; M++)
+            {
+                N    = (VClk << P) * M / xtal;
+                if(N <= 255) {
+                    Freq = (xtal * N / M) >> P;
+                    if (Freq > VClk)
+                        DeltaNew = Freq - VClk;
+                    else
+                        DeltaNew = VClk - Freq;
+                    if (DeltaNew < DeltaOld)
+                    {
+                        c->m1     = M;
+                        c->n1     = N;
+                        c->p      = P;
+                        DeltaOld  = DeltaNew;
+                    }
+                }
+            }
+        }
+    }
+
+    c->n2 = c->m2 = 1;
+    return (DeltaOld != 0xFFFFFFFF);
+}
+
+static int
+legacyG80(float pclk, NVPllCoeffs *c)
+{
+    const float refclk = 27000.0f;
+    const float minVcoA = 100000;
+    const float maxVcoA = 400000;
+    const float minVcoB = 600000;
+    float maxVcoB = 1400000;
+    const float minUA = 2000;
+    const float maxUA = 400000;
+    const float minUB = 50000;
+    const float maxUB = 200000;
+    const int minNA = 1, maxNA = 255;
+    const int minNB = 1, maxNB = 31;
+    const int minMA = 1, maxMA = 255;
+    const int minMB = 1, maxMB = 31;
+    const int minP = 0, maxP = 6;
+    int lowP, highP;
+    float vcoB;
+
+    int na, ma, nb, mb, p;
+    float bestError = FLT_MAX;
+
+    memset(c, 0, sizeof(*c));
+
+    if(maxVcoB < pclk + pclk / 200)
+        maxVcoB = pclk + pclk / 200;
+    if(minVcoB / (1 << maxP) > pclk)
+        pclk = minVcoB / (1 << maxP);
+
+    vcoB = maxVcoB - maxVcoB / 200;
+    lowP = minP;
+    vcoB /= 1 << (lowP + 1);
+
+    while(pclk <= vcoB && lowP < maxP)
+    {
+        vcoB /= 2;
+        lowP++;
+    }
+
+    vcoB = maxVcoB + maxVcoB / 200;
+    highP = lowP;
+    vcoB /= 1 << (highP + 1);
+
+    while(pclk <= vcoB && highP < maxP)
+    {
+        vcoB /= 2;
+        highP++;
+    }
+
+    for(p = lowP; p <= highP; p++)
+    {
+        for(ma = minMA; ma <= maxMA; ma++)
+        {
+            if(refclk / ma < minUA)
+                break;
+            else if(refclk / ma > maxUA)
+                continue;
+
+            for(na = minNA; na <= maxNA; na++)
+            {
+                if(refclk * na / ma < minVcoA || refclk * na / ma > maxVcoA)
+                    continue;
+
+                for(mb = minMB; mb <= maxMB; mb++)
+                {
+                    if(refclk * na / ma / mb < minUB)
+                        break;
+                    else if(refclk * na / ma / mb > maxUB)
+                        continue;
+
+                    nb = rint(pclk * (1 << p) * (ma / (float)na) * mb / refclk);
+
+                    if(nb > maxNB)
+                        break;
+                    else if(nb < minNB)
+                        continue;
+                    else
+                    {
+                        float freq = refclk * (na / (float)ma) * (nb / (float)mb) / (1 << p);
+                        float error = fabsf(pclk - freq);
+                        if(error < bestError) {
+                            c->n1 = na;
+                            c->m1 = ma;
+                            c->n2 = nb;
+                            c->m2 = mb;
+                            c->p = p;
+                            bestError = error;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return c->m1 != 0;
+}
+
+static int
+legacyG80Linear(float pclk, NVPllCoeffs *c)
+{
+    const float refclk = 27000.0f;
+    const int minN = 8, maxN = 255;
+    const int minM = 1, maxM = 255;
+    const int minPL = 1, maxPL = 63;
+    const int minU = 25000, maxU = 50000;
+    const int minVco = 500000;
+    int maxVco = 1000000;
+    int lowPL, highPL, pl;
+    float vco, bestError = FLT_MAX;
+
+    memset(c, 0, sizeof(*c));
+    c->n2 = c->m2 = 1;
+
+    vco = pclk + pclk / 50;
+
+    if(maxVco < vco) maxVco = vco;
+
+    highPL = (maxVco + vco - 1) / pclk;
+    if(highPL > maxPL) highPL = maxPL;
+    if(highPL < minPL) highPL = minPL;
+
+    lowPL = minVco / vco;
+    if(lowPL > maxPL) lowPL = maxPL;
+    if(lowPL < minPL) lowPL = minPL;
+
+    for(pl = highPL; pl >= lowPL; pl--) {
+        int m;
+
+        for(m = minM; m <= maxM; m++) {
+            int n;
+            float freq, error;
+
+            if(refclk / m < minU) break;
+            if(refclk / m > maxU) continue;
+
+            n = rint(pclk * pl * m / refclk);
+            if(n > maxN) break;
+            if(n < minN) continue;
+
+            freq = refclk * (n / (float)m) / pl;
+            error = fabsf(pclk - freq);
+            if(error < bestError) {
+                c->n1 = n;
+                c->m1 = m;
+                c->p = pl;
+                bestError = error;
+            }
+        }
+    }
+
+    return c->m1 != 0;
+}
+
+/*
+ * Fails if the old solver found coefficients for clock and the new search,
+ * given lim or nothing if the caller gives up before searching, doesn't
+ * get at least as close.
+ */
+static int
+checkLegacy(const char *what, const NVPllLimits *lim, int clock,
+            int oldFound, const NVPllCoeffs *old)
+{
+    NVPllCoeffs c;
+    PllError eOld, eNew;
+
+    if(!oldFound)
+        return 0;
+
+    if(!lim || !NVPllSolve(lim, clock, &c)) {
+        fprintf(stderr, "%s: %d kHz: nothing found, the old code had N1 %d "
+                "M1 %d N2 %d M2 %d P %d\n", what, clock, old->n1, old->m1,
+                old->n2, old->m2, old->p);
+        return 1;
+    }
+
+    eOld = errorOf(lim, clock, old->n1, old->m1, old->n2, old->m2, old->p);
+    eNew = errorOf(lim, clock, c.n1, c.m1, c.n2, c.m2, c.p);
+    if(closer(eOld, eNew)) {
+        fprintf(stderr, "%s: %d kHz: error %llu/%llu, the old code had "
+                "%llu/%llu\n", what, clock, (unsigned long long)eNew.num,
+                (unsigned long long)eNew.den, (unsigned long long)eOld.num,
+                (unsigned long long)eOld.den);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* MaxVClockFreqKHz, the only value riva_hw.c sets */
+#define RIVA_MAX_VCLOCK 256000
+
+/* the limits as CalcVClock in nv_hw.c and CalcVClock in riva_hw.c set them */
+static int
+testNV(int xtal, int riva)
+{
+    const char *what = riva ? "Riva" : "NV";
+    NVPllLimits lim;
+    NVPllCoeffs old;
+    int i, found, oldFound;
+
+    memset(&lim, 0, sizeof(lim));
+    lim.refclk = xtal;
+    lim.minM1 = (xtal == 13500) ? 7 : 8;
+    lim.maxM1 = lim.minM1 + (riva ? 5 : 6);
+    lim.minN1 = 1;
+    lim.maxN1 = 255;
+    lim.log2P = 1;
+
+    for(i = 0; i < NUM_CLOCKS; i++) {
+        found = NVPllPostRange(clocks[i], 128000,
+                               riva ? RIVA_MAX_VCLOCK : 350000, 0,
+                               riva ? 3 : 4, &lim.lowP, &lim.highP);
+        if(riva)
+            oldFound = legacyRiva(xtal, RIVA_MAX_VCLOCK, clocks[i], &old);
+        else
+            oldFound = legacyNV(xtal, clocks[i], &old);
+        if(checkLegacy(what, found ? &lim : NULL, clocks[i], oldFound, &old))
+            return 1;
+        if(!found)
+            continue;
+        if(checkClock(what, &lim, clocks[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* as CalcVClock2Stage in nv_hw.c */
+static int
+testNV2Stage(int xtal)
+{
+    NVPllLimits lim;
+    NVPllCoeffs old;
+    int i, found, oldFound;
+
+    memset(&lim, 0, sizeof(lim));
+    lim.refclk = xtal << 2;
+    lim.minM1 = 1;
+    lim.maxM1 = 13;
+    lim.minN1 = 5;
+    lim.maxN1 = 255;
+    lim.log2P = 1;
+
+    for(i = 0; i < NUM_CLOCKS; i++) {
+        found = NVPllPostRange(clocks[i], 400000, 1000000, 0, 6,
+                               &lim.lowP, &lim.highP);
+        oldFound = legacyNV2Stage(xtal, clocks[i], &old);
+        if(checkLegacy("NV two stage", found ? &lim : NULL, clocks[i],
+                       oldFound, &old))
+            return 1;
+        if(!found)
+            continue;
+        if(checkClock("NV two stage", &lim, clocks[i]))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* as G80CalcPLL in g80_display.c */
+static void
+limitsG80(NVPllLimits *lim)
+{
+    memset(lim, 0, sizeof(*lim));
+    lim->refclk = 27000;
+    lim->minM1 = 1;
+    lim->maxM1 = 255;
+    lim->minN1 = 1;
+    lim->maxN1 = 255;
+    lim->minU1 = 2000;
+    lim->maxU1 = 400000;
+    lim->minVco1 = 100000;
+    lim->maxVco1 = 400000;
+    lim->minM2 = 1;
+    lim->maxM2 = 31;
+    lim->minN2 = 1;
+    lim->maxN2 = 31;
+    lim->minU2 = 50000;
+    lim->maxU2 = 200000;
+    lim->log2P = 1;
+}
+
+static int
+testG80(void)
+{
+    static const struct {
+        int clock, p;
+    } outside[] = {
+        { 5000, 6 }, { 10000, 6 }, { 10882, 6 }, { 1407001, 0 },
+        { 1600000, 0 }
+    };
+    static const int low[] = { 1000, 5000, 9000, 9374, 9375 };
+    NVPllLimits lim;
+    NVPllCoeffs c, old;
+    int i;
+
+    limitsG80(&lim);
+
+    for(i = 0; i < NUM_CLOCKS; i++) {
+        NVPllPostRange(clocks[i], 696501, 1407000, 0, 6, &lim.lowP,
+                       &lim.highP);
+        if(checkLegacy("G80CalcPLL", &lim, clocks[i],
+                       legacyG80(clocks[i], &old), &old) ||
+           checkClock("G80CalcPLL", &lim, clocks[i]))
+            return 1;
+    }
+
+    /* G80CalcPLL raises these to 600 MHz / 64, as the old code did */
+    for(i = 0; i < (int)(sizeof(low) / sizeof(low[0])); i++) {
+        const int clock = 600000 >> 6;
+
+        NVPllPostRange(clock, 696501, 1407000, 0, 6, &lim.lowP, &lim.highP);
+        if(checkLegacy("G80CalcPLL", &lim, clock, legacyG80(low[i], &old),
+                       &old))
+            return 1;
+    }
+
+    for(i = 0; i < (int)(sizeof(outside) / sizeof(outside[0])); i++) {
+        if(NVPllPostRange(outside[i].clock, 696501, 1407000, 0, 6,
+                          &lim.lowP, &lim.highP) ||
+           (lim.lowP != outside[i].p) || (lim.highP != outside[i].p))
+        {
+            fprintf(stderr, "G80CalcPLL: %d kHz: post divider %d to %d, "
+                    "expected only %d\n", outside[i].clock, lim.lowP,
+                    lim.highP, outside[i].p);
+            return 1;
+        }
+        if(checkClock("G80CalcPLL", &lim, outside[i].clock))
+            return 1;
+        if(NVPllSolve(&lim, outside[i].clock, &c) && (c.p != outside[i].p)) {
+            fprintf(stderr, "G80CalcPLL: %d kHz: post divider %d\n",
+                    outside[i].clock, c.p);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* as G80CalcPLL2, with its linear post divider */
+static int
+testG80Linear(void)
+{
+    NVPllLimits lim;
+    NVPllCoeffs old;
+    int i;
+
+    memset(&lim, 0, sizeof(lim));
+    lim.refclk = 27000;
+    lim.minM1 = 1;
+    lim.maxM1 = 255;
+    lim.minN1 = 8;
+    lim.maxN1 = 255;
+    lim.minU1 = 25000;
+    lim.maxU1 = 50000;
+
+    for(i = 0; i < NUM_CLOCKS; i++) {
+        const int pclk = clocks[i];
+        float vco = pclk + pclk / 50.0f;
+        int maxVco = 1000000;
+
+        if(maxVco < vco) maxVco = vco;
+
+        lim.highP = (maxVco + vco - 1) / pclk;
+        if(lim.highP > 63) lim.highP = 63;
+        if(lim.highP < 1) lim.highP = 1;
+        lim.lowP = 500000 / vco;
+        if(lim.lowP > 63) lim.lowP = 63;
+        if(lim.lowP < 1) lim.lowP = 1;
+
+        if(checkLegacy("G80CalcPLL2", &lim, pclk,
+                       legacyG80Linear(pclk, &old), &old) ||
+           checkClock("G80CalcPLL2", &lim, pclk))
+            return 1;
+    }
+
+    return 0;
+}
+
+int
+main(void)
+{
+    static const int xtals[] = { 13500, 14318, 27000 };
+    int i;
+
+    for(i = 0; i < 3; i++) {
+        if(testNV(xtals[i], 0) || testNV(xtals[i], 1) ||
+           testNV2Stage(xtals[i]))
+            return 1;
+    }
+
+    return testG80() || testG80Linear();
+}
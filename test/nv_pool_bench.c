@@ -0,0 +1,142 @@
+/*
+ * Times a rotated 32 bpp shadow refresh of a whole frame on host memory,
+ * cut into bands of rows the way NVShadowPoolRun does and run through
+ * NVPoolRun with different numbers of worker threads.
+ *
+ *   nv_pool_bench [max threads [frames]]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nv_copy.h"
+#include "nv_pool.h"
+
+#define WIDTH  1920
+#define HEIGHT 1200
+
+static uint32_t *shadow, *fb;
+
+typedef struct {
+    int y1, y2;                 /* shadow rows, NV_COPY_TILE aligned */
+} Band;
+
+static Band bands[WIDTH / NV_COPY_TILE + 1];
+
+/*
+ * Rotate == 1 as in NVRefreshArea32 for the box (0, y1) - (HEIGHT, y2) of
+ * the shadow, which is HEIGHT pixels wide and WIDTH tall.
+ */
+static void
+rotateBand(void *data, int i)
+{
+    const int srcPitch = -HEIGHT;
+    const Band *band = &bands[i];
+
+    (void)data;
+    NVCopyRotate(4, fb + WIDTH - band->y2, WIDTH,
+                 shadow + ((1 - band->y2) * srcPitch), srcPitch, 1,
+                 HEIGHT, band->y2 - band->y1);
+}
+
+static int
+cutBands(int threads)
+{
+    int step = (WIDTH + threads) / (threads + 1);
+    int n = 0, y, next;
+
+    step = (step + NV_COPY_TILE - 1) & ~(NV_COPY_TILE - 1);
+    for(y = 0; y < WIDTH; y = next) {
+        next = (y + step) & ~(NV_COPY_TILE - 1);
+        if(next > WIDTH)
+            next = WIDTH;
+        bands[n].y1 = y;
+        bands[n].y2 = next;
+        n++;
+    }
+
+    return n;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main(int argc, char **argv)
+{
+    int maxThreads = 4, frames = 50;
+    uint32_t *ref;
+    int threads, i;
+
+    if(argc >= 2)
+        maxThreads = atoi(argv[1]);
+    if(argc >= 3)
+        frames = atoi(argv[2]);
+    if((maxThreads < 0) || (frames < 1)) {
+        fprintf(stderr, "usage: %s [max threads [frames]]\n", argv[0]);
+        return 2;
+    }
+
+    shadow = malloc(WIDTH * HEIGHT * 4);
+    fb = malloc(WIDTH * HEIGHT * 4);
+    ref = malloc(WIDTH * HEIGHT * 4);
+    if(!shadow || !fb || !ref)
+        return 2;
+    for(i = 0; i < WIDTH * HEIGHT; i++)
+        shadow[i] = i * 2654435761u;
+
+    NVCopyInit(1);
+
+    /* reference: one band covering everything, in this thread */
+    bands[0].y1 = 0;
+    bands[0].y2 = WIDTH;
+    rotateBand(NULL, 0);
+    memcpy(ref, fb, WIDTH * HEIGHT * 4);
+
+    printf("%dx%d, 32 bpp, %d frames\n", WIDTH, HEIGHT, frames);
+    for(threads = 0; threads <= maxThreads; threads++) {
+        NVPoolPtr pool = threads ? NVPoolCreate(threads) : NULL;
+        int n = cutBands(NVPoolThreads(pool));
+        double start, elapsed;
+
+        if(threads && !pool) {
+            printf("%d workers: no threads\n", threads);
+            break;
+        }
+
+        memset(fb, 0, WIDTH * HEIGHT * 4);
+        NVPoolRun(pool, rotateBand, NULL, n);
+        if(memcmp(fb, ref, WIDTH * HEIGHT * 4)) {
+            fprintf(stderr, "%d workers: result differs\n", threads);
+            return 1;
+        }
+
+        start = now();
+        for(i = 0; i < frames; i++)
+            NVPoolRun(pool, rotateBand, NULL, n);
+        elapsed = now() - start;
+
+        printf("%d workers, %2d bands  %7.3f ms/frame\n", threads, n,
+               elapsed * 1e3 / frames);
+        NVPoolDestroy(pool);
+    }
+
+    free(shadow);
+    free(fb);
+    free(ref);
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Runs NVPoolRun in nv_pool.c many times with varying job counts and
+ * pool sizes, and checks that every job of a run is called exactly once,
+ * that none is called for a run that has already returned, and that job
+ * numbers stay within the run.  Built with -fsanitize=thread it also
+ * catches the pool state being touched without the lock.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nv_pool.h"
+
+#define MAX_JOBS 256
+#define RUNS     2000
+
+typedef struct {
+    int run;                    /* set while NVPoolRun is running */
+    int calls[MAX_JOBS];
+    int jobs;
+    int bad;
+    unsigned spin[MAX_JOBS];
+} Run;
+
+static void
+job(void *data, int i)
+{
+    Run *run = data;
+    volatile unsigned x = 0;
+    unsigned k;
+
+    if(!__atomic_load_n(&run->run, __ATOMIC_SEQ_CST) ||
+       (i < 0) || (i >= run->jobs))
+    {
+        __atomic_fetch_add(&run->bad, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    /* uneven amounts of work so the workers race each other */
+    for(k = 0; k < run->spin[i]; k++)
+        x += k;
+
+    __atomic_fetch_add(&run->calls[i], 1, __ATOMIC_SEQ_CST);
+}
+
+static int
+check(NVPoolPtr pool, int threads)
+{
+    Run run;
+    int r, i, failed = 0;
+
+    for(r = 0; r < RUNS; r++) {
+        run.jobs = rand() % (MAX_JOBS + 1);
+        run.bad = 0;
+        for(i = 0; i < MAX_JOBS; i++) {
+            run.calls[i] = 0;
+            run.spin[i] = (rand() % 4) ? (rand() % 64) : (rand() % 20000);
+        }
+
+        __atomic_store_n(&run.run, 1, __ATOMIC_SEQ_CST);
+        NVPoolRun(pool, job, &run, run.jobs);
+        __atomic_store_n(&run.run, 0, __ATOMIC_SEQ_CST);
+
+        for(i = 0; i < MAX_JOBS; i++) {
+            if(run.calls[i] != (i < run.jobs)) {
+                fprintf(stderr, "%d threads, run %d: job %d of %d called "
+                        "%d times\n", threads, r, i, run.jobs, run.calls[i]);
+                failed = 1;
+                break;
+            }
+        }
+        if(run.bad) {
+            fprintf(stderr, "%d threads, run %d: %d calls outside the run\n",
+                    threads, r, run.bad);
+            failed = 1;
+        }
+        if(failed)
+            break;
+    }
+
+    return failed;
+}
+
+int
+main(void)
+{
+    int threads, failed = 0;
+
+    srand(1);
+
+    /* without a pool the jobs run inline */
+    failed += check(NULL, 0);
+
+    for(threads = 1; threads <= 8; threads *= 2) {
+        NVPoolPtr pool = NVPoolCreate(threads);
+
+        if(!pool) {
+#ifdef HAVE_PTHREAD
+            fprintf(stderr, "couldn't start %d threads\n", threads);
+            failed++;
+#endif
+            continue;
+        }
+        if(NVPoolThreads(pool) != threads) {
+            fprintf(stderr, "asked for %d threads, got %d\n", threads,
+                    NVPoolThreads(pool));
+            failed++;
+        }
+        failed += check(pool, threads);
+        NVPoolDestroy(pool);
+    }
+
+    return failed ? 1 : 0;
+}
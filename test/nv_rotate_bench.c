@@ -0,0 +1,159 @@
+/*
+ * Times the rotated shadow refresh kernels in nv_copy.c on host memory:
+ * the column walk the driver used before NVCopyRotate, and NVCopyRotate
+ * with the plain C and, where the CPU has it, SSE2 tiles.  Every result
+ * is checked against the column walk first.
+ *
+ *   nv_rotate_bench [width height [frames]]
+ *
+ * The size is that of the framebuffer, the shadow is its transpose.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nv_copy.h"
+
+static int width = 1920, height = 1200, frames = 50;
+static uint8_t *shadow, *fb, *ref;
+
+typedef void (*RotateFunc)(int Bpp, void *dst, int dstPitch, const void *src,
+                           int srcPitch, int step, int rows, int count);
+
+/* what the refresh did before, one output row per shadow column */
+static void
+columnWalk(int Bpp, void *dst, int dstPitch, const void *src, int srcPitch,
+           int step, int rows, int count)
+{
+    int r, j;
+
+    for(r = 0; r < rows; r++) {
+        const uint8_t *s = (const uint8_t*)src + r * step * Bpp;
+        uint8_t *d = (uint8_t*)dst + r * dstPitch * Bpp;
+
+        for(j = 0; j < count; j++) {
+            memcpy(d, s, Bpp);
+            d += Bpp;
+            s += srcPitch * Bpp;
+        }
+    }
+}
+
+/*
+ * Same pointer setup as NVRefreshArea32 for the box (x1, y1) - (x2, y2) of
+ * the shadow.  y1 and y2 have to be multiples of 4, as NVRefreshArea8
+ * rounds them, so the 8 and 16 bit kernels get whole dwords.
+ */
+static void
+refresh(RotateFunc func, int Bpp, int rotate, int x1, int y1, int x2, int y2)
+{
+    const int shadowPitch = height;
+    const int srcPitch = -rotate * shadowPitch;
+    uint8_t *dst;
+    const uint8_t *src;
+
+    if(rotate == 1) {
+        dst = fb + ((x1 * width) + width - y2) * Bpp;
+        src = shadow + (((1 - y2) * srcPitch) + x1) * Bpp;
+    } else {
+        dst = fb + (((height - x2) * width) + y1) * Bpp;
+        src = shadow + ((y1 * srcPitch) + x2 - 1) * Bpp;
+    }
+
+    (*func)(Bpp, dst, width, src, srcPitch, rotate, x2 - x1, y2 - y1);
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+run(const char *name, RotateFunc func, int Bpp, int rotate)
+{
+    const size_t size = (size_t)width * height * Bpp;
+    double start, elapsed;
+    int i;
+
+    /* a small box with partial tiles on every side, then a full frame */
+    for(i = 0; i < 2; i++) {
+        const int x1 = i ? 0 : 37, y1 = i ? 0 : 12;
+        const int x2 = i ? height : 139, y2 = i ? width : 52;
+
+        memset(fb, 0, size);
+        refresh(columnWalk, Bpp, rotate, x1, y1, x2, y2);
+        memcpy(ref, fb, size);
+        memset(fb, 0, size);
+        refresh(func, Bpp, rotate, x1, y1, x2, y2);
+        if(memcmp(fb, ref, size)) {
+            fprintf(stderr, "%s: %d bpp, rotate %d differs from the "
+                    "column walk\n", name, Bpp * 8, rotate);
+            return 1;
+        }
+    }
+
+    start = now();
+    for(i = 0; i < frames; i++)
+        refresh(func, Bpp, rotate, 0, 0, height, width);
+    elapsed = now() - start;
+
+    printf("%-12s %2d bpp  rotate %2d  %7.3f ms/frame  %7.1f Mpixels/s\n",
+           name, Bpp * 8, rotate, elapsed * 1e3 / frames,
+           (double)width * height * frames / elapsed / 1e6);
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    const int bpp[] = { 1, 2, 4 };
+    int i, rotate, failed = 0;
+
+    if(argc >= 3) {
+        width = atoi(argv[1]) & ~15;
+        height = atoi(argv[2]) & ~15;
+    }
+    if(argc >= 4)
+        frames = atoi(argv[3]);
+    if((width < 256) || (height < 256) || (frames < 1)) {
+        fprintf(stderr, "usage: %s [width height [frames]]\n", argv[0]);
+        return 2;
+    }
+
+    shadow = malloc((size_t)width * height * 4);
+    fb = malloc((size_t)width * height * 4);
+    ref = malloc((size_t)width * height * 4);
+    if(!shadow || !fb || !ref)
+        return 2;
+    srand(1);
+    for(i = 0; i < width * height * 4; i++)
+        shadow[i] = rand();
+
+    printf("%dx%d framebuffer, %d frames\n", width, height, frames);
+    for(i = 0; i < 3; i++) {
+        for(rotate = -1; rotate <= 1; rotate += 2) {
+            failed += run("column walk", columnWalk, bpp[i], rotate);
+            NVCopyInit(0);
+            failed += run("C tiles", NVCopyRotate, bpp[i], rotate);
+            NVCopyInit(1);
+            failed += run("best tiles", NVCopyRotate, bpp[i], rotate);
+        }
+    }
+
+    free(shadow);
+    free(fb);
+    free(ref);
+
+    return failed ? 1 : 0;
+}
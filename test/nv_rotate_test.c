@@ -0,0 +1,96 @@
+/*
+ * Checks that NVCopyRotate gives bit for bit the same framebuffer with the
+ * SSE2 tiles as with the plain C ones, for 8, 16 and 32 bpp and both
+ * rotation directions.  Neither side of the frame is a multiple of the
+ * tile size, and besides full refreshes a set of boxes with partial tiles
+ * on every side is tried.  Both runs start from the same fill pattern, so
+ * stray writes outside the box show up as well.
+ *
+ * Without SSE2 both runs use the C tiles and this passes trivially.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nv_copy.h"
+
+#define WIDTH  (13 * NV_COPY_TILE + 4)
+#define HEIGHT (9 * NV_COPY_TILE + 5)
+
+static uint8_t shadow[WIDTH * HEIGHT * 4];
+static uint8_t fbC[WIDTH * HEIGHT * 4], fbSIMD[WIDTH * HEIGHT * 4];
+
+/*
+ * Same pointer setup as NVRefreshArea32 for the box (x1, y1) - (x2, y2) of
+ * the shadow, which is HEIGHT wide and WIDTH tall.
+ */
+static void
+refresh(uint8_t *fb, int Bpp, int rotate, int x1, int y1, int x2, int y2)
+{
+    const int srcPitch = -rotate * HEIGHT;
+    uint8_t *dst;
+    const uint8_t *src;
+
+    memset(fb, 0xa5, sizeof(fbC));
+    if(rotate == 1) {
+        dst = fb + ((x1 * WIDTH) + WIDTH - y2) * Bpp;
+        src = shadow + (((1 - y2) * srcPitch) + x1) * Bpp;
+    } else {
+        dst = fb + (((HEIGHT - x2) * WIDTH) + y1) * Bpp;
+        src = shadow + ((y1 * srcPitch) + x2 - 1) * Bpp;
+    }
+
+    NVCopyRotate(Bpp, dst, WIDTH, src, srcPitch, rotate, x2 - x1, y2 - y1);
+}
+
+/* y1 and y2 are multiples of 4, as NVRefreshArea8 rounds them */
+static int
+check(int Bpp, int rotate, int x1, int y1, int x2, int y2)
+{
+    NVCopyInit(0);
+    refresh(fbC, Bpp, rotate, x1, y1, x2, y2);
+    NVCopyInit(1);
+    refresh(fbSIMD, Bpp, rotate, x1, y1, x2, y2);
+
+    if(memcmp(fbC, fbSIMD, sizeof(fbC))) {
+        fprintf(stderr, "%d bpp, rotate %d, box %d,%d - %d,%d: SSE2 "
+                "tiles differ from C\n", Bpp * 8, rotate, x1, y1, x2, y2);
+        return 1;
+    }
+    return 0;
+}
+
+int
+main(void)
+{
+    const int bpp[] = { 1, 2, 4 };
+    int i, n, rotate, failed = 0;
+
+    srand(1);
+    for(i = 0; i < (int)sizeof(shadow); i++)
+        shadow[i] = rand();
+
+    for(i = 0; i < 3; i++) {
+        for(rotate = -1; rotate <= 1; rotate += 2) {
+            failed += check(bpp[i], rotate, 0, 0, HEIGHT, WIDTH);
+            failed += check(bpp[i], rotate, 3, 4, HEIGHT - 1, (WIDTH - 1) & ~3);
+            for(n = 0; n < 200; n++) {
+                const int x1 = rand() % HEIGHT, y1 = (rand() % WIDTH) & ~3;
+                const int x2 = x1 + 1 + rand() % (HEIGHT - x1);
+                const int y2 = y1 + 4 + ((rand() % (WIDTH - y1)) & ~3);
+
+                if(y2 > WIDTH)
+                    continue;
+                failed += check(bpp[i], rotate, x1, y1, x2, y2);
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Replays random sequences of mode states through NVStateLoad in
+ * nv_state.c against host memory standing in for the registers, which
+ * records every write.  After each load the registers must match those
+ * of a full load, and reloading the same state may only write the
+ * registers that are always reloaded.  The hardware's PLL registers are
+ * scribbled on now and then, as the other head would, to check they are
+ * put back.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nv_state.h"
+
+#define APERTURE_SIZE 0x1000
+#define MAX_WRITES    128
+#define CR_APERTURE   3   /* in the trace only */
+
+typedef struct {
+    uint32_t regs[3][APERTURE_SIZE / 4];
+    uint8_t cr[256];
+    struct {
+        int aperture, offset;
+        uint32_t value;
+    } trace[MAX_WRITES];
+    int writes;
+} StandIn;
+
+static uint32_t
+standInRead(void *priv, int aperture, int offset)
+{
+    StandIn *s = priv;
+
+    return s->regs[aperture][offset / 4];
+}
+
+static void
+record(StandIn *s, int aperture, int offset, uint32_t value)
+{
+    if(s->writes < MAX_WRITES) {
+        s->trace[s->writes].aperture = aperture;
+        s->trace[s->writes].offset = offset;
+        s->trace[s->writes].value = value;
+    }
+    s->writes++;
+}
+
+static void
+standInWrite(void *priv, int aperture, int offset, uint32_t value)
+{
+    StandIn *s = priv;
+
+    s->regs[aperture][offset / 4] = value;
+    record(s, aperture, offset, value);
+}
+
+static void
+standInWriteCR(void *priv, int index, uint8_t value)
+{
+    StandIn *s = priv;
+
+    s->cr[index] = value;
+    record(s, CR_APERTURE, index, value);
+}
+
+/* the registers every load writes, whatever changed */
+static int
+alwaysWritten(const NVStateHW *hw, int aperture, int offset)
+{
+    if(aperture == CR_APERTURE)
+        return (offset == 0x30) || (offset == 0x31) || (offset == 0x2F) ||
+               ((offset == 0x21) && hw->flatPanel &&
+                (hw->architecture >= NV_ARCH_10));
+    return hw->flatPanel && (aperture == NV_STATE_PRAMDAC) &&
+           (offset == 0x0848);
+}
+
+static uint32_t
+random32(void)
+{
+    return ((uint32_t)(rand() & 0xffff) << 16) | (rand() & 0xffff);
+}
+
+/* change a few fields of state, picking values from a small set */
+static void
+mutate(RIVA_HW_STATE *state)
+{
+    uint32_t *field = (uint32_t *)state;
+    const int fields = sizeof(*state) / sizeof(uint32_t);
+    int n = rand() % 4;
+
+    while(n--)
+        field[rand() % fields] = rand() % 3 ? rand() % 4 : random32();
+}
+
+static int
+check(const char *what, const NVStateHW *hw, const StandIn *got,
+      const StandIn *ref)
+{
+    if(memcmp(got->regs, ref->regs, sizeof(got->regs)) ||
+       memcmp(got->cr, ref->cr, sizeof(got->cr)))
+    {
+        fprintf(stderr, "%s: arch %02x chipset %04x flat panel %d two heads "
+                "%d two stage %d: registers differ from a full load\n",
+                what, hw->architecture, hw->chipset, hw->flatPanel,
+                hw->twoHeads, hw->twoStagePLL);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int
+testConfig(NVStateHW *hw)
+{
+    static StandIn got, ref;
+    RIVA_HW_STATE state, old;
+    int step, i;
+
+    memset(&got, 0, sizeof(got));
+    memset(&ref, 0, sizeof(ref));
+    memset(&state, 0, sizeof(state));
+    for(i = 0; i < (int)(sizeof(state) / sizeof(uint32_t)); i++)
+        ((uint32_t *)&state)[i] = random32();
+
+    hw->priv = &got;
+    NVStateLoad(hw, &state, NULL);
+    hw->priv = &ref;
+    NVStateLoad(hw, &state, NULL);
+
+    for(step = 0; step < 2000; step++) {
+        old = state;
+        mutate(&state);
+
+        if(rand() % 8 == 0) {
+            static const int plls[] = { 0x0508, 0x050C, 0x0520, 0x0578,
+                                        0x057C, 0x0580 };
+            const int off = plls[rand() % 6];
+
+            got.regs[NV_STATE_PRAMDAC0][off / 4] = random32();
+            ref.regs[NV_STATE_PRAMDAC0][off / 4] =
+                got.regs[NV_STATE_PRAMDAC0][off / 4];
+        }
+
+        got.writes = 0;
+        hw->priv = &got;
+        NVStateLoad(hw, &state, &old);
+        hw->priv = &ref;
+        NVStateLoad(hw, &state, NULL);
+        if(check("changed state", hw, &got, &ref))
+            return 1;
+
+        /* the same state again only writes what is always written */
+        got.writes = 0;
+        hw->priv = &got;
+        NVStateLoad(hw, &state, &state);
+        if(check("same state", hw, &got, &ref))
+            return 1;
+        for(i = 0; i < got.writes; i++) {
+            if(!alwaysWritten(hw, got.trace[i].aperture, got.trace[i].offset))
+            {
+                fprintf(stderr, "same state: arch %02x flat panel %d: "
+                        "wrote %08x to %x in aperture %d\n",
+                        hw->architecture, hw->flatPanel, got.trace[i].value,
+                        got.trace[i].offset, got.trace[i].aperture);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int
+main(void)
+{
+    static const int archs[] = { NV_ARCH_04, NV_ARCH_10, NV_ARCH_20,
+                                 NV_ARCH_30, NV_ARCH_40 };
+    static const int chipsets[] = { 0x0110, 0x0170 };
+    NVStateHW hw;
+    int a, c, flags;
+
+    srand(1);
+    hw.read = standInRead;
+    hw.write = standInWrite;
+    hw.writeCR = standInWriteCR;
+
+    for(a = 0; a < 5; a++) {
+        for(c = 0; c < 2; c++) {
+            for(flags = 0; flags < 8; flags++) {
+                hw.architecture = archs[a];
+                hw.chipset = chipsets[c];
+                hw.flatPanel = flags & 1;
+                hw.twoHeads = !!(flags & 2);
+                hw.twoStagePLL = !!(flags & 4);
+                if(testConfig(&hw))
+                    return 1;
+            }
+        }
+    }
+
+    return 0;
+}
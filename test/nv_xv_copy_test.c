@@ -0,0 +1,158 @@
+/*
+ * Checks the Xv upload copies in nv_copy.c, plain C and SSE2 alike,
+ * against a byte by byte reference on host memory.  Widths, source
+ * offsets and destination alignments are varied so the SSE2 loops go
+ * through every mix of unaligned head, vector body and tail, and the
+ * bytes around each destination line must come back untouched.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nv_copy.h"
+
+#define MAX_W     768
+#define MAX_H     5
+#define SRC_PITCH (MAX_W * 4 + 64)
+#define DST_PITCH (MAX_W * 4 + 96)
+#define GUARD     0xc3
+
+static unsigned char src[SRC_PITCH * (MAX_H + 1)];
+static unsigned char chroma[2][SRC_PITCH * (MAX_H + 1)];
+static unsigned char *dst, *ref;
+
+enum { YV12, YUY2, RGB };
+static const char *names[] = { "NVCopyData420", "NVCopyData422",
+                               "NVCopyDataRGB" };
+
+static void
+reference(int format, unsigned char *d, const unsigned char *s,
+          const unsigned char *u, const unsigned char *v, int h, int w)
+{
+    int i, j;
+
+    for(j = 0; j < h; j++) {
+        unsigned char *line = d + j * DST_PITCH;
+        const unsigned char *y = s + j * SRC_PITCH;
+        const unsigned char *cu = u + (j >> 1) * (SRC_PITCH / 2);
+        const unsigned char *cv = v + (j >> 1) * (SRC_PITCH / 2);
+
+        switch(format) {
+        case YV12:
+            /* Y0 V Y1 U in memory, whatever the byte order */
+            for(i = 0; i < w / 2; i++) {
+                line[4 * i + 0] = y[2 * i];
+                line[4 * i + 1] = cv[i];
+                line[4 * i + 2] = y[2 * i + 1];
+                line[4 * i + 3] = cu[i];
+            }
+            break;
+        case YUY2:
+            memcpy(line, y, (w / 2) * 4);
+            break;
+        case RGB:
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+            for(i = 0; i < w * 4; i++)
+                line[i] = y[(i & ~3) + 3 - (i & 3)];
+#else
+            memcpy(line, y, w * 4);
+#endif
+            break;
+        }
+    }
+}
+
+static int
+check(const char *variant, int format, int w, int h, int srcOff, int dstOff)
+{
+    unsigned char *s = src + srcOff;
+    unsigned char *u = chroma[0] + srcOff;
+    unsigned char *v = chroma[1] + srcOff;
+    const size_t size = DST_PITCH * (MAX_H + 1);
+
+    memset(dst, GUARD, size);
+    memset(ref, GUARD, size);
+    reference(format, ref + dstOff, s, u, v, h, w);
+
+    switch(format) {
+    case YV12:
+        NVCopyData420(s, u, v, dst + dstOff, SRC_PITCH, SRC_PITCH / 2,
+                      DST_PITCH, h, w);
+        break;
+    case YUY2:
+        NVCopyData422(s, dst + dstOff, SRC_PITCH, DST_PITCH, h, w);
+        break;
+    case RGB:
+        NVCopyDataRGB(s, dst + dstOff, SRC_PITCH, DST_PITCH, h, w);
+        break;
+    }
+
+    if(memcmp(dst, ref, size)) {
+        fprintf(stderr, "%s %s: %dx%d, source offset %d, destination "
+                "offset %d differs\n", variant, names[format], w, h, srcOff,
+                dstOff);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+checkAll(const char *variant)
+{
+    int format, w, h, srcOff, dstOff, failed = 0;
+
+    for(format = YV12; format <= RGB; format++) {
+        for(w = 2; w <= MAX_W; w += (w < 160) ? 2 : 94) {
+            for(h = 1; h <= MAX_H; h += 2) {
+                /* packed sources are dword aligned, planes needn't be */
+                for(srcOff = 0; srcOff < 16;
+                    srcOff += (format == YV12) ? 1 : 4)
+                {
+                    /* the destination is always dword aligned */
+                    for(dstOff = 0; dstOff < 16; dstOff += 4) {
+                        failed += check(variant, format, w, h, srcOff,
+                                        dstOff);
+                        if(failed > 10)
+                            return failed;
+                    }
+                }
+            }
+        }
+    }
+
+    return failed;
+}
+
+int
+main(void)
+{
+    int i, failed = 0;
+
+    /* the destination stands in for the aperture, which is well aligned */
+    if(posix_memalign((void**)&dst, 64, DST_PITCH * (MAX_H + 1)) ||
+       posix_memalign((void**)&ref, 64, DST_PITCH * (MAX_H + 1)))
+        return 1;
+
+    srand(1);
+    for(i = 0; i < (int)sizeof(src); i++) {
+        src[i] = rand();
+        chroma[0][i] = rand();
+        chroma[1][i] = rand();
+    }
+
+    NVCopyInit(0);
+    failed += checkAll("C");
+    NVCopyInit(1);
+    failed += checkAll("best");
+
+    free(dst);
+    free(ref);
+
+    return failed ? 1 : 0;
+}